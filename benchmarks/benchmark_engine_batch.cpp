@@ -0,0 +1,131 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "engine/constants.hpp"
+#include "engine/engine.hpp"
+#include "engine/logger.hpp"
+#include "engine/orderbook.hpp"
+#include "engine/types.hpp"
+#include "my_config.hpp"
+#include "network/market_data.hpp"
+#include "telemetry/clock.hpp"
+
+// The engine thread end to end at different batch sizes: a producer feeds
+// the event queue, keeping at most IN_FLIGHT events unfinished, and a probe
+// reads the output ring. Throughput is events per second through the engine;
+// latency is from an event being queued to the probe seeing it published, so
+// it includes the wait for the rest of the batch. Arg: the engine's batch
+// size.
+
+std::atomic<bool> keep_running(true);
+extern std::atomic<bool> start_exchange;
+
+static constexpr size_t EVENTS = 200000;
+static constexpr size_t EVENT_QUEUE_SIZE = 1 << 16;
+static constexpr size_t IN_FLIGHT = 256;
+static constexpr const char *FEED_PATH = "/dev/shm/tachyon_bench_market_data";
+
+// Limit orders around the middle of the book, every fourth a cancel of an
+// order placed a little earlier.
+static auto make_event(uint64_t i) -> ClientRequest {
+  ClientRequest request{};
+  request.client_id = static_cast<ClientId>(1 + (i & 3));
+  if (i % 4 == 3) {
+    request.type = RequestType::Cancel;
+    request.order_id_to_cancel = i - 2;
+    return request;
+  }
+  request.type = RequestType::New;
+  Side side = (i & 1) != 0 ? Side::BID : Side::ASK;
+  Price offset = i % 50;
+  request.new_order = {i,
+                       side == Side::BID ? CLIENT_BASE_PRICE - offset
+                                         : CLIENT_BASE_PRICE + offset - 10,
+                       10,
+                       side,
+                       OrderType::LIMIT,
+                       TimeInForce::GTC};
+  return request;
+}
+
+static void BM_Engine_BatchSize(benchmark::State &state) {
+  const auto max_batch = static_cast<size_t>(state.range(0));
+  std::vector<uint64_t> latencies;
+  latencies.reserve(EVENTS);
+  double seconds = 0;
+  tsc::calibrate();
+
+  for (auto _ : state) {
+    my_config::EventQueue events{EVENT_QUEUE_SIZE};
+    my_config::OutputRing output;
+    size_t probe = output.add_consumer();
+    OrderBook<my_config> orderbook;
+    LoggerClass<my_config> logger(events, output, probe, probe);
+    md::Publisher market_data(FEED_PATH);
+    Engine<my_config> engine(events, orderbook, logger, market_data,
+                             max_batch);
+
+    keep_running.store(true);
+    start_exchange.store(true);
+    std::atomic<size_t> seen{0};
+    std::thread engine_thread(&Engine<my_config>::handleEvents, &engine);
+    std::thread probe_thread([&] {
+      while (seen.load(std::memory_order_relaxed) < EVENTS) {
+        uint64_t from = output.position(probe), to = output.available(probe);
+        TimeStamp now = tsc::now();
+        for (uint64_t seq = from; seq < to; seq++) {
+          if (output[seq].type == OutputType::EVENT) {
+            latencies.push_back(now - output[seq].event.time_stamp);
+            seen.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        output.release(probe, to);
+        if (from == to) {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < EVENTS; i++) {
+      ClientRequest *slot;
+      while (i - seen.load(std::memory_order_relaxed) >= IN_FLIGHT ||
+             (slot = events.claim()) == nullptr) {
+        std::this_thread::yield();
+      }
+      *slot = make_event(i);
+      slot->time_stamp = tsc::now();
+      events.publish();
+    }
+    probe_thread.join();
+    seconds += std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    keep_running.store(false);
+    engine_thread.join();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  state.counters["events_per_sec"] =
+      static_cast<double>(EVENTS * state.iterations()) / seconds;
+  state.counters["p50_ns"] =
+      static_cast<double>(latencies[latencies.size() / 2]);
+  state.counters["p99_ns"] =
+      static_cast<double>(latencies[latencies.size() * 99 / 100]);
+}
+BENCHMARK(BM_Engine_BatchSize)
+    ->Arg(1)
+    ->Arg(8)
+    ->Arg(32)
+    ->Arg(128)
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
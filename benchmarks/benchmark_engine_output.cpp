@@ -0,0 +1,131 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+#include "containers/sequenced_ring.hpp"
+#include "engine/types.hpp"
+
+// What the engine thread spends writing its output per event: the event
+// itself plus, for each fill, either the two execution reports and the trade
+// built right there (inline) or one compact Fill left for the dispatcher to
+// expand (offloaded). Nothing consumes the ring, so it never fills up and
+// only the producer's work is timed.
+// Arg: fills per event.
+
+static constexpr size_t RING_SIZE = 1024 * 1024; // same as the exchange's.
+
+static auto make_request(uint64_t i) -> ClientRequest {
+  ClientRequest request{};
+  request.type = RequestType::New;
+  request.client_id = static_cast<ClientId>(i & 15);
+  request.time_stamp = i;
+  request.new_order = {i, 10000 + (i & 255), 100, Side::BID, OrderType::LIMIT,
+                       TimeInForce::GTC};
+  return request;
+}
+
+static void emit_event(sequenced_ring<EngineOutput> &ring,
+                       const ClientRequest &request) {
+  EngineOutput *out = ring.claim();
+  out->type = OutputType::EVENT;
+  out->event = record_of(request);
+  ring.publish();
+}
+
+static void emit_report(sequenced_ring<EngineOutput> &ring,
+                        const ExecutionReport &report) {
+  EngineOutput *out = ring.claim();
+  out->type = OutputType::REPORT;
+  out->report = report;
+  ring.publish();
+}
+
+static auto make_fill(const ClientRequest &incoming, uint64_t k) -> Fill {
+  return {k,
+          incoming.new_order.order_id,
+          static_cast<ClientId>(k & 15),
+          incoming.client_id,
+          incoming.time_stamp,
+          incoming.new_order.price,
+          10,
+          static_cast<Quantity>(k & 7),
+          static_cast<Quantity>(incoming.new_order.quantity - 10 * (k + 1)),
+          incoming.new_order.side};
+}
+
+static void emit_fill(sequenced_ring<EngineOutput> &ring, const Fill &fill) {
+  EngineOutput *out = ring.claim();
+  out->type = OutputType::FILL;
+  out->fill = fill;
+  ring.publish();
+}
+
+static void BM_EngineOutput_Inline(benchmark::State &state) {
+  sequenced_ring<EngineOutput> ring{RING_SIZE};
+  const auto fills = static_cast<uint64_t>(state.range(0));
+  uint64_t i = 0;
+  for (auto _ : state) {
+    ClientRequest request = make_request(i++);
+    emit_event(ring, request);
+    if (fills == 0) {
+      ExecutionReport ack{};
+      ack.client_id = request.client_id;
+      ack.order_id = request.new_order.order_id;
+      ack.price = request.new_order.price;
+      ack.remaining_quantity = request.new_order.quantity;
+      ack.type = ExecType::NEW;
+      ack.side = request.new_order.side;
+      emit_report(ring, ack);
+    }
+    for (uint64_t k = 0; k < fills; k++) {
+      Fill fill = make_fill(request, k);
+      emit_fill(ring, fill); // stands in for the trade record.
+      emit_report(ring, taker_report(fill));
+      emit_report(ring, maker_report(fill));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_EngineOutput_Inline)->Arg(0)->Arg(1)->Arg(4);
+
+static void BM_EngineOutput_Offloaded(benchmark::State &state) {
+  sequenced_ring<EngineOutput> ring{RING_SIZE};
+  const auto fills = static_cast<uint64_t>(state.range(0));
+  uint64_t i = 0;
+  for (auto _ : state) {
+    ClientRequest request = make_request(i++);
+    emit_event(ring, request);
+    if (fills == 0) {
+      ExecutionReport ack{};
+      ack.client_id = request.client_id;
+      ack.order_id = request.new_order.order_id;
+      ack.price = request.new_order.price;
+      ack.remaining_quantity = request.new_order.quantity;
+      ack.type = ExecType::NEW;
+      ack.side = request.new_order.side;
+      emit_report(ring, ack);
+    }
+    for (uint64_t k = 0; k < fills; k++) {
+      emit_fill(ring, make_fill(request, k));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_EngineOutput_Offloaded)->Arg(0)->Arg(1)->Arg(4);
+
+// The other half of offloading: the dispatcher building both reports.
+static void BM_FillExpansion(benchmark::State &state) {
+  ClientRequest request = make_request(1);
+  Fill fill = make_fill(request, 0);
+  ExecutionReport batch[2];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fill);
+    batch[0] = taker_report(fill);
+    batch[1] = maker_report(fill);
+    benchmark::DoNotOptimize(batch);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_FillExpansion);
+
+BENCHMARK_MAIN();
@@ -7,6 +7,8 @@
 #include <vector>
 
 #include "containers/flat_hashmap.hpp"
+#include "perf_scope.hpp"
+#include "telemetry/alloc_tracker.hpp"
 
 // ============================================================
 // Types
@@ -47,6 +49,7 @@ static void BM_Flat_Insert_Ideal(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     flat_hashmap<Key, Value48> map(N * 2);
     for (size_t i = 0; i < N; ++i) {
@@ -63,6 +66,7 @@ static void BM_Unordered_Insert_Ideal(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     std::unordered_map<Key, Value48> map;
     map.reserve(N);
@@ -80,6 +84,7 @@ static void BM_Map_Insert_Ideal(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     std::map<Key, Value48> map;
     for (size_t i = 0; i < N; ++i) {
@@ -104,7 +109,9 @@ static void BM_Flat_Lookup_Ideal(benchmark::State &state) {
   for (size_t i = 0; i < N; ++i)
     map.insert({keys[i], vals[i]});
 
+  PerfScope perf(state);
   for (auto _ : state) {
+    alloc::NoAllocation no_alloc("BM_Flat_Lookup_Ideal");
     for (size_t i = 0; i < N; ++i) {
       benchmark::DoNotOptimize(map.at(keys[i]));
     }
@@ -121,6 +128,7 @@ static void BM_Unordered_Lookup_Ideal(benchmark::State &state) {
   for (size_t i = 0; i < N; ++i)
     map.insert({keys[i], vals[i]});
 
+  PerfScope perf(state);
   for (auto _ : state) {
     for (size_t i = 0; i < N; ++i) {
       benchmark::DoNotOptimize(map.at(keys[i]));
@@ -139,6 +147,7 @@ static void BM_Map_Lookup_Ideal(benchmark::State &state) {
   for (size_t i = 0; i < N; ++i)
     map.insert({keys[i], vals[i]});
 
+  PerfScope perf(state);
   for (auto _ : state) {
     for (size_t i = 0; i < N; ++i) {
       benchmark::DoNotOptimize(map.at(keys[i]));
@@ -156,6 +165,7 @@ static void BM_Flat_erase(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     flat_hashmap<Key, Value48> map(N * 2);
     for (size_t i = 0; i < N; ++i)
@@ -174,6 +184,7 @@ static void BM_Unordered_erase(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     std::unordered_map<Key, Value48> map(N * 2);
     for (size_t i = 0; i < N; ++i) {
@@ -194,6 +205,7 @@ static void BM_Map_erase(benchmark::State &state) {
   auto keys = make_keys(N);
   auto vals = make_values(N);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     std::map<Key, Value48> map;
     for (size_t i = 0; i < N; ++i)
@@ -217,6 +229,7 @@ static void BM_Flat_Insert_After_Delete(benchmark::State &state) {
   auto keys = make_keys(N * 2);
   auto vals = make_values(N * 2);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     flat_hashmap<Key, Value48> map(N * 2);
 
@@ -257,6 +270,7 @@ static void BM_Flat_Mixed(benchmark::State &state) {
   size_t next_insert = N;
   std::mt19937_64 rng(123456);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     uint64_t r = rng() % 100;
 
@@ -300,6 +314,7 @@ static void BM_Unordered_Mixed(benchmark::State &state) {
   size_t next_insert = N;
   std::mt19937_64 rng(123456);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     uint64_t r = rng() % 100;
 
@@ -343,6 +358,7 @@ static void BM_Map_Mixed(benchmark::State &state) {
   size_t next_insert = N;
   std::mt19937_64 rng(123456);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     uint64_t r = rng() % 100;
 
@@ -0,0 +1,188 @@
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "containers/memory_usage.hpp"
+#include "engine/constants.hpp"
+#include "engine/exchange.hpp"
+#include "engine/orderbook.hpp"
+#include "engine/settings.hpp"
+#include "engine/types.hpp"
+#include "my_config.hpp"
+#include "network/tcpserver.hpp"
+
+// What the exchange's components cost in memory, for capacity planning.
+// Nothing here is timed; everything is reported as counters:
+//   - BM_Footprint_Fixed: what is allocated up front whatever the load,
+//     the queues, the book's arena and indexes and the connection table,
+//     sized by tachyon.conf if there is one in the working directory.
+//   - BM_Footprint_RestingOrders/N: a book holding N resting orders, the
+//     resident memory each one adds and what the book reserves and uses.
+//   - BM_Footprint_Session/burst: one client connection after it has been
+//     sent burst reports its socket couldn't take yet.
+// Reserved bytes are what the containers allocated; resident bytes are the
+// pages actually touched, read from /proc/self/statm.
+
+std::atomic<bool> keep_running(true);
+
+using Connection = ClientConnection<my_config::RxBufferType,
+                                    my_config::TxBufferType>;
+
+static auto resident_bytes() -> size_t {
+  FILE *statm = std::fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+  unsigned long size = 0, resident = 0;
+  int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+  std::fclose(statm);
+  return read == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))
+                   : 0;
+}
+
+// The bytes of the slots holding something, for containers of like slots.
+static auto used_bytes(const MemoryUsage &usage) -> double {
+  return usage.capacity ? static_cast<double>(usage.bytes) *
+                              static_cast<double>(usage.live) /
+                              static_cast<double>(usage.capacity)
+                        : 0;
+}
+
+// Bids below and asks above the middle of the price band, none crossing.
+static auto resting_order(OrderId oid) -> ClientRequest {
+  ClientRequest req;
+  req.type = RequestType::New;
+  req.client_id = 1;
+  req.time_stamp = 1000 + oid;
+  req.new_order.order_id = oid;
+  req.new_order.side = oid % 2 ? Side::BID : Side::ASK;
+  Price offset = 1 + static_cast<Price>(oid % 200);
+  req.new_order.price = oid % 2 ? CLIENT_BASE_PRICE - offset
+                                : CLIENT_BASE_PRICE + offset;
+  req.new_order.quantity = 100;
+  req.new_order.order_type = OrderType::LIMIT;
+  req.new_order.tif = TimeInForce::GTC;
+  return req;
+}
+
+static void BM_Footprint_Fixed(benchmark::State &state) {
+  settings::Settings s = settings::load_or_defaults();
+  for (auto _ : state) {
+    my_config::EventQueue event_queue(s.event_queue_capacity);
+    my_config::OutputRing engine_output(s.output_ring_capacity);
+    OrderBook<my_config> book(s);
+    TcpServer<my_config> server(event_queue, engine_output,
+                                engine_output.add_consumer(), s);
+    auto book_memory = book.memory();
+    MemoryUsage total = event_queue.memory();
+    total += engine_output.memory();
+    total += book_memory.total();
+    total += server.tableMemory();
+
+    state.counters["event_queue_bytes"] =
+        static_cast<double>(event_queue.memory().bytes);
+    state.counters["output_ring_bytes"] =
+        static_cast<double>(engine_output.memory().bytes);
+    state.counters["arena_bytes"] =
+        static_cast<double>(book_memory.arena.bytes);
+    state.counters["index_bytes"] = static_cast<double>(
+        book_memory.arena_idx.bytes + book_memory.list_idx.bytes);
+    state.counters["levels_bytes"] =
+        static_cast<double>(book_memory.levels.bytes);
+    state.counters["connection_table_bytes"] =
+        static_cast<double>(server.tableMemory().bytes);
+    state.counters["total_bytes"] = static_cast<double>(total.bytes);
+    // The estimate the memory budget is checked against, connections too.
+    state.counters["footprint_bytes"] =
+        static_cast<double>(Exchange<my_config>::footprint(s));
+  }
+}
+BENCHMARK(BM_Footprint_Fixed)->Iterations(1);
+
+static void BM_Footprint_RestingOrders(benchmark::State &state) {
+  const auto N = static_cast<size_t>(state.range(0));
+  std::vector<ClientRequest> orders;
+  orders.reserve(N);
+  for (size_t i = 0; i < N; i++) {
+    orders.push_back(resting_order(i + 1));
+  }
+
+  for (auto _ : state) {
+    size_t before = resident_bytes();
+    OrderBook<my_config> book;
+    size_t empty = resident_bytes();
+    for (ClientRequest &order : orders) {
+      book.add(order);
+    }
+    size_t filled = resident_bytes();
+
+    auto memory = book.memory();
+    MemoryUsage total = memory.total();
+    double used = used_bytes(memory.arena) + used_bytes(memory.arena_idx) +
+                  used_bytes(memory.list_idx) + used_bytes(memory.levels);
+    double orders_held = static_cast<double>(book.size());
+    state.counters["empty_book_rss_bytes"] =
+        static_cast<double>(empty - before);
+    state.counters["rss_bytes/order"] =
+        static_cast<double>(filled - empty) / orders_held;
+    state.counters["reserved_bytes"] = static_cast<double>(total.bytes);
+    state.counters["used_bytes/order"] = used / orders_held;
+    state.counters["index_tombstones"] =
+        static_cast<double>(memory.arena_idx.tombstones +
+                            memory.list_idx.tombstones);
+  }
+}
+// Once per size: a second book reuses the pages the first one freed.
+BENCHMARK(BM_Footprint_RestingOrders)
+    ->RangeMultiplier(8)
+    ->Range(1 << 10, 1 << 17)
+    ->Iterations(1);
+
+// The receive thread recvs up to this much at a time into rx_buffer, like
+// TcpServer's MAX_RECV_SIZE, and the dispatcher appends reports to
+// tx_buffer until the socket takes them.
+static constexpr size_t RECV_SIZE = 4096;
+// Wire sizes of a v1 order and execution report, see network/serialise.hpp
+// (its functions aren't inline, core_engine already defines them).
+static constexpr size_t ORDER_BYTES = 24;
+static constexpr size_t REPORT_BYTES = 32;
+
+static void BM_Footprint_Session(benchmark::State &state) {
+  const auto burst = static_cast<size_t>(state.range(0));
+  std::vector<uint8_t> inbound(burst * ORDER_BYTES, 0);
+
+  for (auto _ : state) {
+    Connection conn(-1);
+    // burst orders in, parsed after every recv, a partial one left over.
+    for (size_t at = 0; at < inbound.size(); at += RECV_SIZE) {
+      size_t got = std::min(RECV_SIZE, inbound.size() - at);
+      uint8_t *into = conn.rx_buffer.prepare(RECV_SIZE);
+      std::copy_n(inbound.data() + at, got, into);
+      conn.rx_buffer.commit(got);
+      size_t parsed = conn.rx_buffer.size() / ORDER_BYTES * ORDER_BYTES;
+      conn.rx_buffer.erase(parsed);
+    }
+    // burst reports out, none sent yet.
+    for (size_t i = 0; i < burst; i++) {
+      conn.tx_buffer.prepare(REPORT_BYTES);
+      conn.tx_buffer.commit(REPORT_BYTES);
+    }
+
+    size_t rx = conn.rx_buffer.memory().bytes;
+    size_t tx = conn.tx_buffer.memory().bytes;
+    state.counters["connection_bytes"] = sizeof(Connection);
+    state.counters["rx_buffer_bytes"] = static_cast<double>(rx);
+    state.counters["tx_buffer_bytes"] = static_cast<double>(tx);
+    state.counters["session_bytes"] =
+        static_cast<double>(sizeof(Connection) + rx + tx);
+  }
+}
+BENCHMARK(BM_Footprint_Session)->RangeMultiplier(10)->Range(1, 100000);
+
+BENCHMARK_MAIN();
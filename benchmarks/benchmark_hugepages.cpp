@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "containers/arena.hpp"
+#include "containers/flat_hashmap.hpp"
+#include "containers/huge_page_allocator.hpp"
+#include "engine/types.hpp"
+#include "perf_scope.hpp"
+
+// The cancel path of a book with a lot resting, on ordinary pages and on
+// huge pages: each operation cancels a resting order picked at random (the
+// order id index looked up and erased, its arena slot read and freed) and
+// rests a new one in its place, so the book stays the same size. Every
+// step lands on a random line of a table far bigger than the TLB covers
+// with 4 KB pages; dtlb_misses/op is the number to compare (the machine
+// needs a PMU for it, see perf_scope.hpp). The huge page runs report how
+// their tables were backed: on a box with no pages reserved and THP off
+// they are on ordinary pages too and the two runs match.
+
+template <typename Allocator> struct Book {
+  using Index =
+      flat_hashmap<OrderId, uint32_t,
+                   typename std::allocator_traits<Allocator>::template
+                   rebind_alloc<Entry<OrderId, uint32_t>>>;
+
+  basic_arena<Allocator> arena;
+  Index index;
+
+  explicit Book(size_t orders) : arena(orders), index(orders * 2) {}
+
+  void rest(OrderId oid) {
+    ClientRequest req;
+    req.new_order.order_id = oid;
+    req.new_order.quantity = 100;
+    index.insert({oid, arena.allocateSlot(req)});
+  }
+  auto cancel(OrderId oid) -> Quantity {
+    uint32_t slot = index.at(oid);
+    Quantity quantity = arena[slot].clr.new_order.quantity;
+    index.erase(oid);
+    arena.freeSlot(slot);
+    return quantity;
+  }
+};
+
+template <typename Allocator>
+static void BM_CancelHeavy(benchmark::State &state) {
+  const auto N = static_cast<size_t>(state.range(0));
+  size_t transparent_before = huge::transparent_resident();
+  size_t mapped_before = 0;
+  for (auto &bytes : huge::mapped) {
+    mapped_before += bytes.load();
+  }
+
+  Book<Allocator> book(N);
+  // Live ids, and the next one to hand out.
+  std::vector<OrderId> live(N);
+  for (size_t i = 0; i < N; i++) {
+    live[i] = i + 1;
+    book.rest(live[i]);
+  }
+  OrderId next = N + 1;
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<size_t> pick(0, N - 1);
+
+  {
+    PerfScope perf(state);
+    for (auto _ : state) {
+      size_t i = pick(rng);
+      benchmark::DoNotOptimize(book.cancel(live[i]));
+      live[i] = next++;
+      book.rest(live[i]);
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  size_t mapped = 0;
+  for (auto &bytes : huge::mapped) {
+    mapped += bytes.load();
+  }
+  state.counters["huge_mapped_bytes"] =
+      static_cast<double>(mapped - mapped_before);
+  state.counters["thp_resident_bytes"] =
+      static_cast<double>(huge::transparent_resident()) -
+      static_cast<double>(transparent_before);
+}
+
+BENCHMARK(BM_CancelHeavy<std::allocator<char>>)
+    ->Name("BM_CancelHeavy/small_pages")
+    ->RangeMultiplier(4)
+    ->Range(1 << 16, 1 << 22);
+BENCHMARK(BM_CancelHeavy<huge_page_allocator<char>>)
+    ->Name("BM_CancelHeavy/huge_pages")
+    ->RangeMultiplier(4)
+    ->Range(1 << 16, 1 << 22);
+
+BENCHMARK_MAIN();
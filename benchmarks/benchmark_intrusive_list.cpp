@@ -12,6 +12,7 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
 #include "containers/intrusive_list.hpp"
+#include "perf_scope.hpp"
 #pragma GCC diagnostic pop
 
 // -----------------------------------------------------------------------------
@@ -61,6 +62,7 @@ class ContainerBench : public benchmark::Fixture {
 
 BENCHMARK_DEFINE_F(ContainerBench,
                    Intrusive_PushBack)(benchmark::State& state) {
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     state.PauseTiming();
     intrusive_list<BenchData> list;
@@ -75,6 +77,7 @@ BENCHMARK_DEFINE_F(ContainerBench,
 }
 
 BENCHMARK_DEFINE_F(ContainerBench, StdList_PushBack)(benchmark::State& state) {
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     state.PauseTiming();
     std::list<BenchData> list;
@@ -88,6 +91,7 @@ BENCHMARK_DEFINE_F(ContainerBench, StdList_PushBack)(benchmark::State& state) {
 }
 
 BENCHMARK_DEFINE_F(ContainerBench, StdDeque_PushBack)(benchmark::State& state) {
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     state.PauseTiming();
     std::deque<BenchData> list;
@@ -109,6 +113,7 @@ BENCHMARK_DEFINE_F(ContainerBench,
   intrusive_list<BenchData> list;
   for (auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     if (list.size() == 0) continue;
 
@@ -133,6 +138,7 @@ BENCHMARK_DEFINE_F(ContainerBench, StdList_Traverse)(benchmark::State& state) {
   std::list<BenchData> list;
   for (const auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     for (const auto& item : list) {
       benchmark::DoNotOptimize(item.id);
@@ -144,6 +150,7 @@ BENCHMARK_DEFINE_F(ContainerBench, StdDeque_Traverse)(benchmark::State& state) {
   std::deque<BenchData> list;
   for (const auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     for (const auto& item : list) {
       benchmark::DoNotOptimize(item.id);
@@ -159,6 +166,7 @@ BENCHMARK_DEFINE_F(ContainerBench, Intrusive_Cycle)(benchmark::State& state) {
   intrusive_list<BenchData> list;
   for (auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     if (list.size() > 0) {
       // Intrusive unlink/relink is purely pointer math
@@ -174,6 +182,7 @@ BENCHMARK_DEFINE_F(ContainerBench, StdList_Cycle)(benchmark::State& state) {
   std::list<BenchData> list;
   for (const auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     if (!list.empty()) {
       // Expensive: Deallocate front node, Allocate new back node
@@ -189,6 +198,7 @@ BENCHMARK_DEFINE_F(ContainerBench, StdDeque_Cycle)(benchmark::State& state) {
   std::deque<BenchData> list;
   for (const auto& item : object_pool) list.push_back(item);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     if (!list.empty()) {
       auto val = list.front();
@@ -235,6 +245,7 @@ BENCHMARK_DEFINE_F(FragmentedBench, NoPrefetch_Walk)(benchmark::State& state) {
   intrusive_list<BenchData> list;
   for (auto* item : pointer_pool) list.push_back(*item);
 
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     if (list.size() == 0) continue;
 
@@ -259,6 +270,7 @@ BENCHMARK_DEFINE_F(FragmentedBench, Prefetch_Walk)(benchmark::State& state) {
   intrusive_list<BenchData> list;
   for (auto* item : pointer_pool) list.push_back(*item);
 
+  PerfScope perf(state, state.range(0));
   for (auto _ : state) {
     // Use the internal for_each which contains __builtin_prefetch
     list.for_each(
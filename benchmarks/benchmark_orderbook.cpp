@@ -17,6 +17,8 @@
 #include "engine/types.hpp"
 #include "my_config.hpp"
 #include "network/tcpserver.hpp"
+#include "perf_scope.hpp"
+#include "telemetry/alloc_tracker.hpp"
 // ============================================================================
 // 1. Data Generation Helpers
 // ============================================================================
@@ -73,6 +75,7 @@ static void BM_OrderBook_Add(benchmark::State &state) {
     orders.push_back(makeReq(i, s, p, 100));
   }
 
+  PerfScope perf(state);
   for (auto _ : state) {
     state.PauseTiming();
     {
@@ -113,6 +116,7 @@ static void BM_OrderBook_Cancel(benchmark::State &state) {
   std::mt19937 rng(12345);
   std::shuffle(cancels.begin(), cancels.end(), rng);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     state.PauseTiming();
     {
@@ -154,6 +158,7 @@ static void BM_OrderBook_Match_Sweep(benchmark::State &state) {
   std::vector<std::pair<Trade, ClientRequest>> trades;
   trades.reserve(RESTING_COUNT);
 
+  PerfScope perf(state);
   for (auto _ : state) {
     state.PauseTiming();
     {
@@ -175,4 +180,43 @@ static void BM_OrderBook_Match_Sweep(benchmark::State &state) {
 }
 BENCHMARK(BM_OrderBook_Match_Sweep);
 
+// Same sweep reporting each fill through a sink, nothing is collected.
+static void BM_OrderBook_Match_Sweep_Sink(benchmark::State &state) {
+  const int RESTING_COUNT = 1000;
+  std::vector<ClientRequest> resting_orders;
+  resting_orders.reserve(RESTING_COUNT);
+
+  for (int i = 0; i < RESTING_COUNT; ++i) {
+    resting_orders.push_back(makeReq(i, Side::ASK, 100, 10));
+  }
+  const ClientRequest aggressor = makeReq(99999, Side::BID, 100, 10000);
+
+  PerfScope perf(state);
+  for (auto _ : state) {
+    state.PauseTiming();
+    {
+      OrderBook<my_config> book;
+      for (auto &o : resting_orders)
+        book.add(o);
+      ClientRequest incoming = aggressor;
+      Quantity filled = 0;
+
+      state.ResumeTiming(); // START TIMER
+
+      {
+        alloc::NoAllocation no_alloc("BM_OrderBook_Match_Sweep_Sink");
+        book.match(incoming, [&](Trade &trade, const ClientRequest &) {
+          filled += trade.quantity;
+        });
+      }
+
+      state.PauseTiming(); // STOP TIMER
+      benchmark::DoNotOptimize(filled);
+    }
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * RESTING_COUNT);
+}
+BENCHMARK(BM_OrderBook_Match_Sweep_Sink);
+
 BENCHMARK_MAIN();
@@ -11,6 +11,7 @@
 #include "containers/sharded_queue.hpp"
 #include "engine/orderbook.hpp"
 #include "engine/types.hpp"
+#include "perf_scope.hpp"
 // ----------------------------------------------------------------------------
 // BENCHMARK: Single Thread Throughput (Baseline)
 // ----------------------------------------------------------------------------
@@ -18,6 +19,7 @@ static void BM_LockSTLQueue_Throughput(benchmark::State &state) {
   threadsafe::stl_queue<int> q;
   const int BATCH = 1000;
 
+  PerfScope perf(state);
   for (auto _ : state) {
     for (int i = 0; i < BATCH; ++i) {
       q.push(i);
@@ -35,6 +37,7 @@ BENCHMARK(BM_LockSTLQueue_Throughput);
   threadsafe::sharded_queue<int> q;
   const int BATCH = 1000;
 
+  PerfScope perf(state);
   for (auto _ : state) {
     for (int i = 0; i < BATCH; ++i) {
       q.push(i);
@@ -85,6 +88,7 @@ static void BM_LockSTLQueue_Contention(benchmark::State &state) {
   });
 
   // 4. Producer Loop (Main Benchmark)
+  PerfScope perf(state);
   for (auto _ : state) {
     state.PauseTiming();
 
@@ -135,6 +139,7 @@ static void BM_LockQueue_Throughput(benchmark::State &state) {
   threadsafe::lock_queue<int> q;
   const int BATCH = 1000;
 
+  PerfScope perf(state);
   for (auto _ : state) {
     for (int i = 0; i < BATCH; ++i) {
       q.push(i);
@@ -186,6 +191,7 @@ static void BM_LockQueue_Contention(benchmark::State &state) {
   });
 
   // 4. Producer Loop (Main Benchmark)
+  PerfScope perf(state);
   for (auto _ : state) {
     state.PauseTiming();
 
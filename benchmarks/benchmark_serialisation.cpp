@@ -0,0 +1,219 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/types.hpp"
+#include "network/serialise.hpp"
+#include "network/serialise_batch.hpp"
+
+// ============================================================
+// Utilities
+// ============================================================
+
+static constexpr size_t ORDER_LEN = 1 + sizeof(Order);
+
+static std::vector<Order> make_orders(size_t n) {
+  std::vector<Order> orders(n);
+  for (size_t i = 0; i < n; ++i) {
+    orders[i].order_id = i * 11400714819323198485ULL;
+    orders[i].price = 10000 + (i % 500);
+    orders[i].quantity = 50000 + (i % 1000);
+    orders[i].side = static_cast<Side>(i % 2);
+    orders[i].order_type = OrderType::LIMIT;
+    orders[i].tif = TimeInForce::GTC;
+  }
+  return orders;
+}
+
+static std::vector<ExecutionReport> make_reports(size_t n) {
+  std::vector<ExecutionReport> reports(n);
+  for (size_t i = 0; i < n; ++i) {
+    reports[i].client_id = static_cast<ClientId>(i % 4);
+    reports[i].order_id = i * 11400714819323198485ULL;
+    reports[i].price = 10000 + (i % 500);
+    reports[i].last_quantity = static_cast<Quantity>(i % 100);
+    reports[i].remaining_quantity = 50000;
+    reports[i].type = ExecType::TRADE;
+    reports[i].reason = RejectReason::NONE;
+    reports[i].side = static_cast<Side>(i % 2);
+  }
+  return reports;
+}
+
+// Paths this CPU can't run are skipped rather than silently timed as scalar.
+static bool skip_unsupported(benchmark::State &state, CodecPath path) {
+  if (path > codec_path()) {
+    state.SkipWithError("codec path not supported on this CPU");
+    return true;
+  }
+  return false;
+}
+
+// ============================================================
+// ORDERS (gateway side: decode, client side: encode)
+// ============================================================
+
+static void BM_Order_Encode_PerMessage(benchmark::State &state) {
+  const size_t N = state.range(0);
+  auto orders = make_orders(N);
+  std::vector<uint8_t> wire(N * ORDER_LEN);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < N; ++i) {
+      serialise_order(orders[i], &wire[i * ORDER_LEN]);
+    }
+    benchmark::DoNotOptimize(wire.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Order_Encode_Batch(benchmark::State &state) {
+  const size_t N = state.range(0);
+  const auto path = static_cast<CodecPath>(state.range(1));
+  if (skip_unsupported(state, path)) {
+    return;
+  }
+  auto orders = make_orders(N);
+  std::vector<uint8_t> wire(N * ORDER_LEN);
+
+  for (auto _ : state) {
+    serialise_orders(orders.data(), N, wire.data(), path);
+    benchmark::DoNotOptimize(wire.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Order_Decode_PerMessage(benchmark::State &state) {
+  const size_t N = state.range(0);
+  auto orders = make_orders(N);
+  std::vector<uint8_t> wire(N * ORDER_LEN);
+  serialise_orders(orders.data(), N, wire.data(), CodecPath::SCALAR);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < N; ++i) {
+      deserialise_order(&wire[i * ORDER_LEN], orders[i]);
+    }
+    benchmark::DoNotOptimize(orders.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Order_Decode_Batch(benchmark::State &state) {
+  const size_t N = state.range(0);
+  const auto path = static_cast<CodecPath>(state.range(1));
+  if (skip_unsupported(state, path)) {
+    return;
+  }
+  auto orders = make_orders(N);
+  std::vector<uint8_t> wire(N * ORDER_LEN);
+  serialise_orders(orders.data(), N, wire.data(), CodecPath::SCALAR);
+
+  for (auto _ : state) {
+    deserialise_orders(wire.data(), N, orders.data(), path);
+    benchmark::DoNotOptimize(orders.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+// ============================================================
+// EXECUTION REPORTS (dispatcher side: encode, client side: decode)
+// ============================================================
+
+static void BM_Report_Encode_PerMessage(benchmark::State &state) {
+  const size_t N = state.range(0);
+  auto reports = make_reports(N);
+  std::vector<uint8_t> wire(N * EXEC_REPORT_LEN);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < N; ++i) {
+      serialise_execution_report(reports[i], &wire[i * EXEC_REPORT_LEN]);
+    }
+    benchmark::DoNotOptimize(wire.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Report_Encode_Batch(benchmark::State &state) {
+  const size_t N = state.range(0);
+  const auto path = static_cast<CodecPath>(state.range(1));
+  if (skip_unsupported(state, path)) {
+    return;
+  }
+  auto reports = make_reports(N);
+  std::vector<uint8_t> wire(N * EXEC_REPORT_LEN);
+
+  for (auto _ : state) {
+    serialise_execution_reports(reports.data(), N, wire.data(), path);
+    benchmark::DoNotOptimize(wire.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Report_Decode_PerMessage(benchmark::State &state) {
+  const size_t N = state.range(0);
+  auto reports = make_reports(N);
+  std::vector<uint8_t> wire(N * EXEC_REPORT_LEN);
+  serialise_execution_reports(reports.data(), N, wire.data(),
+                              CodecPath::SCALAR);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < N; ++i) {
+      deserialise_execution_report(&wire[i * EXEC_REPORT_LEN], reports[i]);
+    }
+    benchmark::DoNotOptimize(reports.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Report_Decode_Batch(benchmark::State &state) {
+  const size_t N = state.range(0);
+  const auto path = static_cast<CodecPath>(state.range(1));
+  if (skip_unsupported(state, path)) {
+    return;
+  }
+  auto reports = make_reports(N);
+  std::vector<uint8_t> wire(N * EXEC_REPORT_LEN);
+  serialise_execution_reports(reports.data(), N, wire.data(),
+                              CodecPath::SCALAR);
+
+  for (auto _ : state) {
+    deserialise_execution_reports(wire.data(), N, reports.data(), path);
+    benchmark::DoNotOptimize(reports.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+// ============================================================
+// Register
+// ============================================================
+
+// 100 is what the dispatcher and client drain per pass.
+static void batch_args(benchmark::internal::Benchmark *b) {
+  for (int64_t n : {16, 100, 4096}) {
+    for (auto path : {CodecPath::SCALAR, CodecPath::SSSE3, CodecPath::AVX2}) {
+      b->Args({n, static_cast<int64_t>(path)});
+    }
+  }
+  b->ArgNames({"n", "path"});
+}
+
+BENCHMARK(BM_Order_Encode_PerMessage)->Arg(16)->Arg(100)->Arg(4096);
+BENCHMARK(BM_Order_Encode_Batch)->Apply(batch_args);
+BENCHMARK(BM_Order_Decode_PerMessage)->Arg(16)->Arg(100)->Arg(4096);
+BENCHMARK(BM_Order_Decode_Batch)->Apply(batch_args);
+BENCHMARK(BM_Report_Encode_PerMessage)->Arg(16)->Arg(100)->Arg(4096);
+BENCHMARK(BM_Report_Encode_Batch)->Apply(batch_args);
+BENCHMARK(BM_Report_Decode_PerMessage)->Arg(16)->Arg(100)->Arg(4096);
+BENCHMARK(BM_Report_Decode_Batch)->Apply(batch_args);
+
+BENCHMARK_MAIN();
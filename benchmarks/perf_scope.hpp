@@ -0,0 +1,55 @@
+#pragma once
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/perf_counters.hpp"
+
+// Hardware counters for one benchmark run. Declare it right before the
+// timed loop:
+//   PerfScope perf(state);
+//   for (auto _ : state) { ... }
+// and every event this machine can count is reported next to the time, per
+// operation: per item if the benchmark sets items processed, else per
+// ops_per_iteration (per iteration by default). Machines without a PMU
+// only get the software events. Built with TACHYON_TRACK_ALLOCS, heap
+// allocations made by the benchmark's thread are reported too.
+class PerfScope {
+private:
+  benchmark::State &state;
+  double ops_per_iteration;
+  perf::Counters counters;
+  uint64_t allocations;
+
+public:
+  explicit PerfScope(benchmark::State &run, double ops = 1)
+      : state(run), ops_per_iteration(ops), allocations(alloc::this_thread()) {
+    counters.start();
+  }
+  ~PerfScope() {
+    counters.stop();
+    perf::Sample sample = counters.read();
+    allocations = alloc::this_thread() - allocations;
+    double ops = state.items_processed() > 0
+                     ? static_cast<double>(state.items_processed())
+                     : static_cast<double>(state.iterations()) *
+                           ops_per_iteration;
+    if (ops <= 0) {
+      return;
+    }
+    for (size_t i = 0; i < perf::EVENTS; i++) {
+      if (sample.valid[i]) {
+        state.counters[std::string(perf::EVENT_NAMES[i]) + "/op"] =
+            static_cast<double>(sample.values[i]) / ops;
+      }
+    }
+    if constexpr (alloc::TRACKING) {
+      state.counters["allocations/op"] =
+          static_cast<double>(allocations) / ops;
+    }
+  }
+  PerfScope(const PerfScope &) = delete;
+  auto operator=(const PerfScope &) -> PerfScope & = delete;
+};
@@ -1,19 +1,33 @@
 #pragma once
 #include <cstdint>
 #include <engine/types.hpp>
+#include <memory>
+#include <vector>
 
-class ArenaClass {
+#include "containers/memory_usage.hpp"
+
+template <typename Allocator = std::allocator<char>> class basic_arena {
 private:
   struct OrderSlot { // NOTE: make sure ABA problem doesn't occur.
 
     ClientRequest clr;
     bool is_active = false;
   };
+  template <typename U>
+  using rebind =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
 
-  std::vector<OrderSlot> arena;
-  std::vector<uint32_t> free_list; // Acts as stack.
+  std::vector<OrderSlot, rebind<OrderSlot>> arena;
+  std::vector<uint32_t, rebind<uint32_t>> free_list; // Acts as stack.
 public:
-  ArenaClass() { arena.reserve(10'000'000); }
+  static constexpr size_t DEFAULT_CAPACITY = 10'000'000;
+
+  // free_list never holds more than the arena, so after this neither grows
+  // (and allocates) on the engine's path until the arena is full.
+  explicit basic_arena(size_t capacity = DEFAULT_CAPACITY) {
+    arena.reserve(capacity);
+    free_list.reserve(arena.capacity());
+  }
   uint32_t allocateSlot(const ClientRequest &incoming) {
     uint32_t idx = 0;
     if (!free_list.empty()) {
@@ -35,4 +49,25 @@ public:
     free_list.push_back(idx);
   }
   OrderSlot &operator[](uint32_t idx) { return arena[idx]; }
+
+  // Slots ever handed out are live or, freed and waiting to be recycled,
+  // tombstones.
+  auto memory() const -> MemoryUsage {
+    return {arena.capacity(), arena.size() - free_list.size(),
+            free_list.size(),
+            arena.capacity() * sizeof(OrderSlot) +
+                free_list.capacity() * sizeof(uint32_t)};
+  }
+  // memory().bytes of an arena constructed with capacity.
+  static auto bytes_for(size_t capacity) -> size_t {
+    return capacity * (sizeof(OrderSlot) + sizeof(uint32_t));
+  }
+  // Calls visit(address, bytes) for each block it holds, to place them.
+  // The whole reserve, touched or not.
+  template <typename Visit> void regions(Visit &&visit) const {
+    visit(arena.data(), arena.capacity() * sizeof(OrderSlot));
+    visit(free_list.data(), free_list.capacity() * sizeof(uint32_t));
+  }
 };
+
+using ArenaClass = basic_arena<>;
@@ -9,10 +9,11 @@
 #include <string>
 #include <utility>
 
-#define INIT_SIZE 100000
-
 template <typename T> class circular_buffer {
 private:
+  // Not a macro, lock_queue.hpp has its own INIT_SIZE.
+  static constexpr size_t INIT_SIZE = 100000;
+
   T *data;
   size_t N{};
   size_t head{};
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// Epoch based reclamation.
+// Reader threads register a participant slot and wrap every pass that touches
+// shared objects in enter()/exit(). A thread that unlinks an object tags it
+// with epoch() and may free it once safe(tag) is true: by then every reader
+// that could still hold a pointer to it has left its critical section.
+// Readers never block, they only publish the epoch they saw.
+
+namespace threadsafe {
+class epoch_manager {
+private:
+  static constexpr size_t CACHE_LINE = 64;
+  static constexpr uint64_t QUIESCENT = std::numeric_limits<uint64_t>::max();
+
+  struct alignas(CACHE_LINE) Participant {
+    std::atomic<uint64_t> local{QUIESCENT};
+  };
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> global{0};
+  size_t n_participants;
+  std::unique_ptr<Participant[]> participants;
+
+public:
+  explicit epoch_manager(size_t n = 1)
+      : n_participants(n), participants(new Participant[n]) {}
+
+  // Reader side.
+  void enter(size_t participant) {
+    participants[participant].local.store(
+        global.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // The announcement must be visible before we load any shared pointer.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+  void exit(size_t participant) {
+    participants[participant].local.store(QUIESCENT,
+                                          std::memory_order_release);
+  }
+
+  // Reclaimer side.
+  auto epoch() const -> uint64_t {
+    return global.load(std::memory_order_acquire);
+  }
+
+  // Moves the global epoch on if every reader inside a critical section has
+  // seen the current one. Returns the (possibly new) global epoch.
+  auto try_advance() -> uint64_t {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t current = global.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n_participants; i++) {
+      uint64_t local = participants[i].local.load(std::memory_order_acquire);
+      if (local != QUIESCENT && local != current) {
+        return current; // someone still lives in an older epoch.
+      }
+    }
+    global.compare_exchange_strong(current, current + 1,
+                                   std::memory_order_acq_rel);
+    return global.load(std::memory_order_acquire);
+  }
+
+  // An object unlinked in retired_epoch is unreachable two epochs later.
+  auto safe(uint64_t retired_epoch) const -> bool {
+    return epoch() >= retired_epoch + 2;
+  }
+};
+
+// RAII critical section.
+class epoch_guard {
+private:
+  epoch_manager &manager;
+  size_t participant;
+
+public:
+  epoch_guard(epoch_manager &mgr, size_t id) : manager(mgr), participant(id) {
+    manager.enter(participant);
+  }
+  ~epoch_guard() { manager.exit(participant); }
+  epoch_guard(const epoch_guard &) = delete;
+  auto operator=(const epoch_guard &) -> epoch_guard & = delete;
+};
+}; // namespace threadsafe
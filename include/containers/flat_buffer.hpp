@@ -6,6 +6,8 @@
 #include <ctime>
 #include <limits>
 #include <stdexcept>
+
+#include "containers/memory_usage.hpp"
 template <typename T> class flat_buffer {
 private:
   static constexpr uint32_t MAX_CAPACITY = std::numeric_limits<uint32_t>::max();
@@ -15,8 +17,9 @@ private:
   size_t capacity; // current capacity.
   T *data;
 
-  void grow() {
-    size_t new_capacitity = capacity * 2;
+  void grow() { reallocate(capacity * 2); }
+
+  void reallocate(size_t new_capacitity) {
     if (new_capacitity > MAX_CAPACITY) {
       throw std::runtime_error("Cannot grow buffer beyond max capacity.");
     }
@@ -37,22 +40,47 @@ public:
 
   ~flat_buffer() { delete[] data; }
   size_t size() { return (tail - head); }
+  // Live is what's buffered; consumed space before it, not yet reclaimed by
+  // a reset, counts as tombstones.
+  auto memory() const -> MemoryUsage {
+    return {capacity, tail - head, head, capacity * sizeof(T)};
+  }
+
   T *begin() { return &data[head]; }
   T *end() { return &data[tail]; }
 
   // Insert the data stored at start at the end.
   void insert(T *start, size_t count) {
+    std::memcpy(prepare(count), start, count);
+    commit(count);
+  }
+
+  // Make room for count elements at the end and return where they go, so
+  // callers can serialise (or recv) straight into the buffer. Nothing is
+  // part of the buffer until commit() is called.
+  T *prepare(size_t count) {
     if (head >= capacity - 1 - size()) { // Buffer is "saturated",
       reset();
+    } else if (head != 0 && tail + count >= capacity) {
+      // Consumed space at the front may be room enough; moving the live
+      // bytes down is cheaper than a buffer that only ever grows.
+      reset();
     }
     while ((tail >= capacity - 1) ||
            (tail + count >= capacity)) { // ideally it should be  ==
       grow();
     }
-
-    std::memcpy(&data[tail], start, count);
-    tail = tail + count;
+    return &data[tail];
+  }
+  // Room for count elements in all, allocated now rather than by a later
+  // prepare().
+  void reserve(size_t count) {
+    if (count > capacity) {
+      reallocate(count);
+    }
   }
+  // Append count elements previously written at prepare().
+  void commit(size_t count) { tail += count; }
 
   // Delete data stored at beginning.
   void erase(size_t count) { head += count; }
@@ -7,8 +7,11 @@
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <type_traits>
+
+#include "containers/memory_usage.hpp"
 // CRITICAL NOTE: In Debug mode this is resulting in heap buffer overflow erorr
 // in testflatmap, by address sanitiser. However, no seg faults.
 static constexpr size_t DEFAULT_SIZE = 32768;
@@ -24,13 +27,30 @@ template <typename K, typename V> struct Entry {
   Entry() { state = State::FREE; }
 };
 
-template <typename K, typename V> class flat_hashmap {
+template <typename K, typename V,
+          typename Allocator = std::allocator<Entry<K, V>>>
+class flat_hashmap {
 private:
+  using EntryAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Entry<K, V>>;
+  using Traits = std::allocator_traits<EntryAllocator>;
+
   size_t capacity_{}; // size of array data.
   size_t size_{};
   size_t tombstones_{};
   size_t mask_;
   Entry<K, V> *data;
+  [[no_unique_address]] EntryAllocator allocator;
+
+  auto allocateEntries(size_t n) -> Entry<K, V> * {
+    Entry<K, V> *arr = Traits::allocate(allocator, n);
+    std::uninitialized_default_construct_n(arr, n);
+    return arr;
+  }
+  void freeEntries(Entry<K, V> *arr, size_t n) {
+    std::destroy_n(arr, n);
+    Traits::deallocate(allocator, arr, n);
+  }
 
   auto hashValue(K key) -> size_t {
     if constexpr (std::is_integral_v<K>) {
@@ -82,7 +102,7 @@ private:
     }
     size_ = 0;
     tombstones_ = 0;
-    auto *tmp = new Entry<K, V>[capacity_];
+    auto *tmp = allocateEntries(capacity_);
     for (size_t i = 0; i < old_N; i++) {
       if (data[i].state == State::USED) { // inlined the grow logic.
         size_t index = findFreeIndex(data[i].key, tmp);
@@ -92,19 +112,57 @@ private:
         size_++;
       }
     }
-    delete[] data;
+    freeEntries(data, old_N);
     data = tmp;
     // size remains same.
   }
+  // Clears the tombstones in place, no allocation: they become free slots
+  // and every entry is put back at the first free slot from its hash.
+  // Entries are visited in probe order starting past a slot that was free
+  // before any tombstone was cleared, which no probe chain runs through, so
+  // each only ever moves back along its own probe path, never behind a
+  // gap. A table with no such slot grows instead.
+  void purgeTombstones() {
+    size_t start = NO_SIZE;
+    for (size_t i = 0; i < capacity_; i++) {
+      if (data[i].state == State::FREE) {
+        start = i;
+        break;
+      }
+    }
+    if (start == NO_SIZE) {
+      grow();
+      return;
+    }
+    for (size_t i = 0; i < capacity_; i++) {
+      if (data[i].state == State::TOMBSTONE) {
+        data[i].state = State::FREE;
+      }
+    }
+    tombstones_ = 0;
+    for (size_t i = 1; i <= capacity_; i++) {
+      size_t index = (start + i) & mask_;
+      if (data[index].state != State::USED) {
+        continue;
+      }
+      data[index].state = State::FREE;
+      size_t home = findFreeIndex(data[index].key, data);
+      if (home != index) {
+        data[home].key = data[index].key;
+        data[home].value = data[index].value;
+      }
+      data[home].state = State::USED;
+    }
+  }
   void insert(const K &key, const V &value, Entry<K, V> *arr) {
     if (size_ > 0.8 * capacity_) {
       // std::cout << "Growing due to size_ = " << size_ << "\n";
       grow();
       arr = data;
     } else if (tombstones_ > 0.4 * capacity_) {
-      // std::cout << "Growing due to tombstones_ = " << tombstones_ << "\n";
-      grow();
-      arr = data;
+      // Churn, not growth: the same table without the tombstones will do.
+      purgeTombstones();
+      arr = data; // it grows if there was no free slot to start from.
     }
     size_t index = findFreeIndex(key, arr);
     // NOTE: we always store a copy of the data.
@@ -167,10 +225,10 @@ private:
 public:
   flat_hashmap(size_t n = DEFAULT_SIZE) {
     capacity_ = next_power_of_two(n);
-    this->data = new Entry<K, V>[capacity_];
+    this->data = allocateEntries(capacity_);
     mask_ = capacity_ - 1;
   }
-  ~flat_hashmap() { delete[] this->data; }
+  ~flat_hashmap() { freeEntries(this->data, capacity_); }
 
   void insert(std::pair<const K &, const V &> pair) {
     insert(pair.first, pair.second, data);
@@ -185,6 +243,24 @@ public:
 
   void erase(const K &key) { remove(key, data); }
 
+  // Pulls the key's home slot into cache ahead of a lookup.
+  void prefetch(const K &key) {
+    __builtin_prefetch(&data[hashValue(key) & mask_]);
+  }
+
+  auto memory() const -> MemoryUsage {
+    return {capacity_, size_, tombstones_, capacity_ * sizeof(Entry<K, V>)};
+  }
+  // memory().bytes of a map constructed with n.
+  static auto bytes_for(size_t n) -> size_t {
+    return next_power_of_two(n) * sizeof(Entry<K, V>);
+  }
+  // Calls visit(address, bytes) for each block it holds, to place them. A
+  // grow() moves it all to a new block.
+  template <typename Visit> void regions(Visit &&visit) const {
+    visit(data, capacity_ * sizeof(Entry<K, V>));
+  }
+
   auto contains(const K &key) -> bool {
     size_t hash = hashValue(key);
 
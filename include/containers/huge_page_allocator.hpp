@@ -0,0 +1,195 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+
+// Backs large allocations with huge pages, so the engine's big tables (the
+// queues, the arena, the order id indexes) take a few hundred TLB entries
+// instead of hundreds of thousands, and random lookups stop missing the TLB
+// on nearly every probe.
+//
+// Allocations of at least THRESHOLD bytes are mapped on their own, as
+// whole pages of the size they get, trying in turn:
+//   1. explicit 1 GB pages (MAP_HUGETLB | MAP_HUGE_1GB), for 1 GB or more;
+//   2. explicit 2 MB pages (MAP_HUGETLB | MAP_HUGE_2MB);
+//   3. ordinary pages, 2 MB aligned and madvise(MADV_HUGEPAGE), which the
+//      kernel backs with transparent huge pages when it can.
+// Explicit pages come from the pool reserved in vm.nr_hugepages (or
+// nr_overcommit_hugepages), which is empty unless the box was set up for
+// it; transparent ones need /sys/kernel/mm/transparent_hugepage/enabled at
+// madvise or always. Smaller allocations come from the heap as usual.
+//
+// Either way a huge page is faulted in, and zeroed, whole on first touch:
+// touch big tables at startup rather than on the hot path.
+
+namespace huge {
+static constexpr size_t PAGE_2MB = size_t{2} << 20;
+static constexpr size_t PAGE_1GB = size_t{1} << 30;
+static constexpr size_t THRESHOLD = PAGE_2MB;
+
+// MAP_HUGE_2MB and MAP_HUGE_1GB: log2 of the page size, at bit 26.
+static constexpr int MAP_HUGE_2MB_FLAG = 21 << 26;
+static constexpr int MAP_HUGE_1GB_FLAG = 30 << 26;
+
+enum class Backing : uint8_t { HUGETLB_1GB, HUGETLB_2MB, TRANSPARENT, COUNT };
+
+static constexpr size_t BACKINGS = static_cast<size_t>(Backing::COUNT);
+
+static constexpr std::array<const char *, BACKINGS> BACKING_NAMES = {
+    "1gb_pages", "2mb_pages", "transparent"};
+
+// Bytes ever mapped each way, for the startup report and the benchmarks.
+inline std::atomic<size_t> mapped[BACKINGS]{};
+
+// How much is mapped for bytes on backing: whole pages of its size. A
+// transparent mapping is kept to 2 MB ones too.
+inline auto mapping_size(size_t bytes, Backing backing) -> size_t {
+  size_t page = backing == Backing::HUGETLB_1GB ? PAGE_1GB : PAGE_2MB;
+  return (bytes + page - 1) / page * page;
+}
+
+// Where the live 1 GB page mappings start. They are the only ones not
+// rounded to 2 MB, so unmap() looks here to tell how long a mapping is.
+// There are only ever a few: each takes at least a GB of the pool.
+static constexpr size_t MAX_1GB_MAPPINGS = 64;
+inline std::atomic<void *> mappings_1gb[MAX_1GB_MAPPINGS]{};
+
+inline auto remember_1gb(void *addr) -> bool {
+  for (auto &slot : mappings_1gb) {
+    void *empty = nullptr;
+    if (slot.compare_exchange_strong(empty, addr)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline auto forget_1gb(void *addr) -> bool {
+  for (auto &slot : mappings_1gb) {
+    void *expected = addr;
+    if (slot.compare_exchange_strong(expected, nullptr)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline auto try_hugetlb(size_t length, int size_flag) -> void * {
+  void *addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1,
+                    0);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+
+// Ordinary pages on a 2 MB boundary, so every 2 MB of it can be one
+// transparent huge page.
+inline auto map_transparent(size_t length) -> void * {
+  void *addr = mmap(nullptr, length + PAGE_2MB, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t aligned = (start + PAGE_2MB - 1) & ~(PAGE_2MB - 1);
+  if (aligned != start) {
+    munmap(addr, aligned - start);
+  }
+  size_t tail = start + length + PAGE_2MB - (aligned + length);
+  if (tail != 0) {
+    munmap(reinterpret_cast<void *>(aligned + length), tail);
+  }
+  madvise(reinterpret_cast<void *>(aligned), length, MADV_HUGEPAGE);
+  return reinterpret_cast<void *>(aligned);
+}
+
+// bytes >= THRESHOLD. Throws std::bad_alloc if nothing could be mapped.
+inline auto map(size_t bytes) -> void * {
+  void *addr = nullptr;
+  Backing backing = Backing::HUGETLB_1GB;
+  if (bytes >= PAGE_1GB) {
+    addr = try_hugetlb(mapping_size(bytes, backing), MAP_HUGE_1GB_FLAG);
+    if (addr != nullptr && !remember_1gb(addr)) {
+      // unmap() couldn't tell its length, settle for 2 MB pages.
+      munmap(addr, mapping_size(bytes, backing));
+      addr = nullptr;
+    }
+  }
+  if (addr == nullptr) {
+    backing = Backing::HUGETLB_2MB;
+    addr = try_hugetlb(mapping_size(bytes, backing), MAP_HUGE_2MB_FLAG);
+  }
+  if (addr == nullptr) {
+    backing = Backing::TRANSPARENT;
+    addr = map_transparent(mapping_size(bytes, backing));
+  }
+  if (addr == nullptr) {
+    throw std::bad_alloc();
+  }
+  mapped[static_cast<size_t>(backing)].fetch_add(mapping_size(bytes, backing),
+                                                 std::memory_order_relaxed);
+  return addr;
+}
+
+// addr and bytes as map() got and returned them.
+inline void unmap(void *addr, size_t bytes) {
+  Backing backing = bytes >= PAGE_1GB && forget_1gb(addr)
+                        ? Backing::HUGETLB_1GB
+                        : Backing::HUGETLB_2MB;
+  munmap(addr, mapping_size(bytes, backing));
+}
+
+// Bytes of the process the kernel has actually put on transparent huge
+// pages so far, AnonHugePages in /proc/self/smaps_rollup; 0 if unreadable.
+// Asking for them is only a hint.
+inline auto transparent_resident() -> size_t {
+  FILE *rollup = std::fopen("/proc/self/smaps_rollup", "r");
+  if (rollup == nullptr) {
+    return 0;
+  }
+  char line[128];
+  unsigned long kb = 0;
+  while (std::fgets(line, sizeof(line), rollup) != nullptr) {
+    if (std::sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+      break;
+    }
+  }
+  std::fclose(rollup);
+  return kb << 10;
+}
+}; // namespace huge
+
+// Allocator policy for the containers that take one: huge pages for big
+// allocations, see above, the heap for the rest. Stateless, so any two
+// compare equal.
+template <typename T> struct huge_page_allocator {
+  using value_type = T;
+
+  huge_page_allocator() = default;
+  template <typename U>
+  huge_page_allocator(const huge_page_allocator<U> &) noexcept {}
+
+  auto allocate(size_t n) -> T * {
+    if (n * sizeof(T) < huge::THRESHOLD) {
+      return std::allocator<T>{}.allocate(n);
+    }
+    return static_cast<T *>(huge::map(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) noexcept {
+    if (n * sizeof(T) < huge::THRESHOLD) {
+      std::allocator<T>{}.deallocate(p, n);
+    } else {
+      huge::unmap(p, n * sizeof(T));
+    }
+  }
+
+  template <typename U>
+  auto operator==(const huge_page_allocator<U> &) const -> bool {
+    return true;
+  }
+};
@@ -75,7 +75,7 @@ public:
     this->list_size = other.list_size;
     other.list_size = 0;
   }
-  auto size() -> size_t { return list_size; }
+  auto size() const -> size_t { return list_size; }
 
   // Add node between next and previous.
   void addNode(IntrusiveListNode *new_node, IntrusiveListNode *prev,
@@ -8,6 +8,8 @@
 #include <deque>
 #include <mutex>
 #include <vector>
+
+#include "containers/memory_usage.hpp"
 extern uint64_t batch_size;
 namespace threadsafe {
 template <typename T>
@@ -68,6 +70,11 @@ class lock_queue {
     return (N + tail - head) % N;
   }
 
+  MemoryUsage memory() {
+    std::lock_guard<std::mutex> lg(mut);
+    return {N, (N + tail - head) % N, 0, N * sizeof(T)};
+  }
+
   void push(T x) {
     // grow if full
     // NOTE: Only one thread can call this at a time. This implies that grow()
@@ -135,6 +142,15 @@ class stl_queue {
       data_queue.pop_front();
     }
   }
+  size_t pop_batch(T* items, size_t max) {
+    std::lock_guard<std::mutex> lk(mut);
+    size_t count = std::min(max, data_queue.size());
+    for (size_t i = 0; i < count; i++) {
+      items[i] = data_queue.front();
+      data_queue.pop_front();
+    }
+    return count;
+  }
   bool empty() {
     std::lock_guard<std::mutex> lk(mut);
     return data_queue.empty();
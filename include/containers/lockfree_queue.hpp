@@ -1,25 +1,41 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <memory>
 #include <optional>
 #include <vector>
 
-template <typename T> class LockFreeSPSCQueue {
+#include "containers/memory_usage.hpp"
+
+template <typename T, typename Allocator = std::allocator<T>>
+class LockFreeSPSCQueue {
 private:
   struct Element {
     T value;
   };
+  using ElementAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Element>;
 
   // Cache line size to prevent false sharing
   static constexpr size_t CACHE_LINE = 64;
 
   // Data alignment
-  alignas(CACHE_LINE) std::vector<Element> buffer;
+  alignas(CACHE_LINE) std::vector<Element, ElementAllocator> buffer;
   size_t mask;
 
   // Head and Tail on separate cache lines
   alignas(CACHE_LINE) std::atomic<size_t> head{0};
+  std::atomic<size_t> high_water{0}; // reader's, most items seen waiting.
   alignas(CACHE_LINE) std::atomic<size_t> tail{0};
 
+  // Reader only, the backlog it just saw.
+  void noteBacklog(size_t waiting) {
+    if (waiting > high_water.load(std::memory_order_relaxed)) {
+      high_water.store(waiting, std::memory_order_relaxed);
+    }
+  }
+
 public:
   explicit LockFreeSPSCQueue(size_t capacity = 1024 * 1024) {
     // Enforce power of 2 for fast modulo
@@ -44,6 +60,25 @@ public:
     return true;
   }
 
+  // Writer Thread Only. Hands out the next free slot so the item can be
+  // built in place, or nullptr if full. The reader can't see it until
+  // publish() is called.
+  T *claim() {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    const size_t h = head.load(std::memory_order_acquire);
+
+    if (((t + 1) & mask) == (h & mask)) {
+      return nullptr; // Full
+    }
+    return &buffer[t & mask].value;
+  }
+
+  // Writer Thread Only. Makes the last claimed slot visible.
+  void publish() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+
   // Reader Thread Only
   bool try_pop(T &item) {
     const size_t h = head.load(std::memory_order_relaxed);
@@ -52,12 +87,43 @@ public:
     if (h == t) {
       return false; // Empty
     }
+    noteBacklog(t - h);
 
     item = buffer[h & mask].value;
     head.store(h + 1, std::memory_order_release);
     return true;
   }
 
+  // Reader Thread Only. Pops up to max items into items, returns how many.
+  size_t pop_batch(T *items, size_t max) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t t = tail.load(std::memory_order_acquire);
+    size_t count = std::min(max, t - h);
+    noteBacklog(t - h);
+    for (size_t i = 0; i < count; i++) {
+      items[i] = buffer[(h + i) & mask].value;
+    }
+    head.store(h + count, std::memory_order_release);
+    return count;
+  }
+
+  // Any thread. Most items the reader has found waiting at once.
+  size_t high_water_mark() const {
+    return high_water.load(std::memory_order_relaxed);
+  }
+  size_t capacity() const { return buffer.size(); }
+  MemoryUsage memory() {
+    return {buffer.size(), size(), 0, buffer.capacity() * sizeof(Element)};
+  }
+  // memory().bytes of a queue constructed with capacity.
+  static auto bytes_for(size_t capacity) -> size_t {
+    return std::bit_ceil(capacity) * sizeof(Element);
+  }
+  // Calls visit(address, bytes) for each block it holds, to place them.
+  template <typename Visit> void regions(Visit &&visit) const {
+    visit(buffer.data(), buffer.capacity() * sizeof(Element));
+  }
+
   // NOTE: function used only by one thread and only for logging
   size_t size() { return (tail.load() - head.load()) % buffer.capacity(); }
 };
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+
+// What a container holds and what holding it costs, for capacity planning.
+// A slot is whatever the container stores (an element, a hash map entry, a
+// byte of a buffer). bytes is the storage it has allocated, whether or not
+// the pages behind it have been touched yet; an untouched reservation costs
+// address space, not memory, until it fills.
+struct MemoryUsage {
+  size_t capacity = 0;   // slots allocated.
+  size_t live = 0;       // slots holding something.
+  size_t tombstones = 0; // slots holding nothing that aren't free either.
+  size_t bytes = 0;
+
+  // Sums, for a component made of several containers. Only bytes and the
+  // counts of like slots make sense added up.
+  auto operator+=(const MemoryUsage &other) -> MemoryUsage & {
+    capacity += other.capacity;
+    live += other.live;
+    tombstones += other.tombstones;
+    bytes += other.bytes;
+    return *this;
+  }
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "containers/memory_usage.hpp"
+
+// Pool of long lived objects with stable addresses.
+// Objects are allocated in chunks and never destroyed until the pool is, so
+// whatever they own (buffers and so on) is kept and reused by the next user.
+// Not thread safe: one owner thread acquires and releases.
+
+template <typename T> class object_pool {
+private:
+  static constexpr size_t DEFAULT_CHUNK = 64;
+
+  size_t chunk_size;
+  std::vector<std::unique_ptr<T[]>> chunks;
+  std::vector<T *> free_list; // Acts as stack, hottest object on top.
+
+  void grow() {
+    chunks.emplace_back(new T[chunk_size]);
+    T *chunk = chunks.back().get();
+    for (size_t i = chunk_size; i > 0; i--) {
+      free_list.push_back(&chunk[i - 1]);
+    }
+  }
+
+public:
+  explicit object_pool(size_t chunk = DEFAULT_CHUNK) : chunk_size(chunk) {
+    free_list.reserve(chunk_size);
+    grow();
+  }
+
+  // Returns a previously used (or default constructed) object. The caller
+  // resets whatever state it cares about.
+  auto acquire() -> T * {
+    if (free_list.empty()) {
+      grow();
+    }
+    T *obj = free_list.back();
+    free_list.pop_back();
+    return obj;
+  }
+
+  void release(T *obj) { free_list.push_back(obj); }
+
+  auto capacity() const -> size_t { return chunks.size() * chunk_size; }
+  auto available() const -> size_t { return free_list.size(); }
+
+  // The objects themselves; what they own (buffers) they account for.
+  auto memory() const -> MemoryUsage {
+    return {capacity(), capacity() - available(), 0,
+            capacity() * sizeof(T) + chunks.capacity() * sizeof(chunks[0]) +
+                free_list.capacity() * sizeof(T *)};
+  }
+};
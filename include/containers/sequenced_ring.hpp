@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "containers/memory_usage.hpp"
+
+// Single producer, multi consumer sequenced ring, disruptor style.
+// Every item is written once into its slot and read there by every consumer;
+// nothing is copied out. Items are numbered 0, 1, 2, ... and each consumer
+// keeps the number of the first item it hasn't finished with. A consumer may
+// be registered to run after others: it never gets ahead of them, so e.g.
+// the dispatcher can be made to only see what the journal has written. The
+// producer reuses a slot only once every consumer is done with it.
+//
+// Consumers are registered before any thread starts; each is then driven by
+// one thread:
+//   uint64_t from = ring.position(id), to = ring.available(id);
+//   for (uint64_t seq = from; seq < to; seq++) { use(ring[seq]); }
+//   ring.release(id, to);
+// The producer may commit() several items and flush() them together.
+template <typename T, typename Allocator = std::allocator<T>>
+class sequenced_ring {
+public:
+  using consumer_id = size_t;
+  static constexpr size_t MAX_CONSUMERS = 8;
+
+private:
+  static constexpr size_t CACHE_LINE = 64;
+
+  struct alignas(CACHE_LINE) Sequence {
+    std::atomic<uint64_t> value{0};
+    std::atomic<uint64_t> high_water{0}; // most items it found ready at once.
+  };
+
+  std::vector<T, Allocator> slots;
+  size_t mask;
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> cursor{0}; // items published.
+  Sequence consumed[MAX_CONSUMERS]; // per consumer, items done with.
+  uint32_t depends_on[MAX_CONSUMERS]{}; // bitmask of consumers it trails.
+  uint32_t gating = 0; // consumers nobody trails, the producer waits on these.
+  size_t consumer_count = 0;
+
+  // Producer's own.
+  alignas(CACHE_LINE) uint64_t next = 0;
+  uint64_t gate = 0; // slowest gating consumer when last looked.
+
+  auto slowest(uint32_t set, uint64_t upto) const -> uint64_t {
+    for (size_t i = 0; i < consumer_count; i++) {
+      if (set & (1u << i)) {
+        uint64_t seq = consumed[i].value.load(std::memory_order_acquire);
+        upto = seq < upto ? seq : upto;
+      }
+    }
+    return upto;
+  }
+
+public:
+  explicit sequenced_ring(size_t capacity = 1024 * 1024) {
+    // Enforce power of 2 for fast modulo
+    size_t cap = 1;
+    while (cap < capacity)
+      cap *= 2;
+    slots.resize(cap);
+    mask = cap - 1;
+  }
+
+  // Setup only. The new consumer never reads past any of `after`.
+  auto add_consumer(std::initializer_list<consumer_id> after = {})
+      -> consumer_id {
+    if (consumer_count == MAX_CONSUMERS) {
+      throw std::length_error("sequenced_ring: too many consumers");
+    }
+    consumer_id id = consumer_count++;
+    for (consumer_id dep : after) {
+      if (dep >= id) {
+        throw std::invalid_argument("sequenced_ring: unknown consumer");
+      }
+      depends_on[id] |= 1u << dep;
+      gating &= ~(1u << dep); // trailing it already holds the producer back.
+    }
+    gating |= 1u << id;
+    consumed[id].value.store(cursor.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+    return id;
+  }
+
+  // Producer only. Next free slot to build the item in, or nullptr if the
+  // slowest consumer is a whole ring behind. Consumers can't see it until
+  // publish() is called.
+  auto claim() -> T * {
+    if (next - gate >= slots.size()) {
+      gate = slowest(gating, next);
+      if (next - gate >= slots.size()) {
+        return nullptr; // Full
+      }
+    }
+    return &slots[next & mask];
+  }
+
+  // Producer only. Makes the last claimed slot visible to every consumer.
+  void publish() {
+    commit();
+    flush();
+  }
+
+  // Producer only. Finishes the last claimed slot but holds it back, so a
+  // run of items can be made visible with a single flush().
+  void commit() { next++; }
+  void flush() { cursor.store(next, std::memory_order_release); }
+
+  // Producer only. Items committed but held back are [flushed(), committed()),
+  // free to change until the next flush().
+  auto flushed() const -> uint64_t {
+    return cursor.load(std::memory_order_relaxed);
+  }
+  auto committed() const -> uint64_t { return next; }
+
+  // Consumer only. First item this consumer hasn't released.
+  auto position(consumer_id id) const -> uint64_t {
+    return consumed[id].value.load(std::memory_order_relaxed);
+  }
+
+  // Consumer only. Items before this one are published and done with by
+  // everything the consumer trails.
+  auto available(consumer_id id) -> uint64_t {
+    uint64_t upto =
+        slowest(depends_on[id], cursor.load(std::memory_order_acquire));
+    uint64_t ready = upto - consumed[id].value.load(std::memory_order_relaxed);
+    if (ready > consumed[id].high_water.load(std::memory_order_relaxed)) {
+      consumed[id].high_water.store(ready, std::memory_order_relaxed);
+    }
+    return upto;
+  }
+
+  // Consumer only, for seq in [position(id), available(id)). Or the
+  // producer, for the items it holds back.
+  auto operator[](uint64_t seq) -> T & { return slots[seq & mask]; }
+  auto operator[](uint64_t seq) const -> const T & { return slots[seq & mask]; }
+
+  // Consumer only. Done with every item before upto.
+  void release(consumer_id id, uint64_t upto) {
+    consumed[id].value.store(upto, std::memory_order_release);
+  }
+
+  // Any thread. Published items some consumer hasn't released yet.
+  auto backlog() const -> uint64_t {
+    uint64_t published = cursor.load(std::memory_order_acquire);
+    return published - slowest((1u << consumer_count) - 1, published);
+  }
+
+  // Any thread. Items the consumer has been behind by, at most. Read when
+  // it looked, so the high water mark of its backlog.
+  auto high_water_mark(consumer_id id) const -> uint64_t {
+    return consumed[id].high_water.load(std::memory_order_relaxed);
+  }
+
+  // Any thread. Published items this consumer hasn't released yet.
+  auto backlog(consumer_id id) const -> uint64_t {
+    uint64_t done = consumed[id].value.load(std::memory_order_acquire);
+    return cursor.load(std::memory_order_acquire) - done;
+  }
+
+  auto capacity() const -> size_t { return slots.size(); }
+
+  // Any thread. Live is what some consumer still has to read.
+  auto memory() const -> MemoryUsage {
+    return {slots.size(), backlog(), 0, slots.capacity() * sizeof(T)};
+  }
+  // memory().bytes of a ring constructed with capacity.
+  static auto bytes_for(size_t capacity) -> size_t {
+    return std::bit_ceil(capacity) * sizeof(T);
+  }
+  // Calls visit(address, bytes) for each block it holds, to place them.
+  template <typename Visit> void regions(Visit &&visit) const {
+    visit(slots.data(), slots.capacity() * sizeof(T));
+  }
+};
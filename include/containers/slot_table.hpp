@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "containers/memory_usage.hpp"
+
+// Lock free table for small, dense keys handed out sequentially (client ids).
+// The key indexes the slot directly, so a lookup is a single acquire load.
+//
+// Each slot is one 64 bit word: the low 48 bits hold the pointer and the top
+// 16 bits a generation tag taken from the key bits above the index. Keys that
+// land in the same slot (key and key + capacity) carry different tags, so a
+// stale key never sees the value that took its slot later.
+//
+// Single writer (the thread accepting and closing connections), any number of
+// readers, and readers never block. erase() only unpublishes the value, the
+// owner decides when the pointee may actually be reclaimed.
+
+namespace threadsafe {
+template <typename Key, typename Value> class slot_table {
+private:
+  static_assert(std::is_pointer_v<Value>, "slot_table stores pointers only");
+  static_assert(std::is_unsigned_v<Key>);
+
+  // x86-64 and aarch64 user space pointers fit in 48 bits.
+  static constexpr unsigned PTR_BITS = 48;
+  static constexpr uint64_t PTR_MASK = (uint64_t{1} << PTR_BITS) - 1;
+  static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+  size_t mask_;
+  unsigned shift_; // log2(capacity), key bits above it form the tag.
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+
+  auto slot(Key key) const -> std::atomic<uint64_t> & {
+    return slots[key & mask_];
+  }
+  auto tag(Key key) const -> uint64_t {
+    return (static_cast<uint64_t>(key) >> shift_) << PTR_BITS;
+  }
+  static auto ptr(uint64_t word) -> uint64_t { return word & PTR_MASK; }
+
+public:
+  using mapped_type = Value;
+
+  explicit slot_table(size_t n = DEFAULT_CAPACITY) : mask_(1), shift_(0) {
+    size_t cap = 1;
+    while (cap < n) {
+      cap *= 2;
+      shift_++;
+    }
+    mask_ = cap - 1;
+    slots.reset(new std::atomic<uint64_t>[cap]);
+    for (size_t i = 0; i < cap; i++) {
+      slots[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns nullptr if key is not present.
+  auto find(Key key) const -> Value {
+    uint64_t word = slot(key).load(std::memory_order_acquire);
+    if ((word & ~PTR_MASK) != tag(key)) {
+      return nullptr;
+    }
+    return reinterpret_cast<Value>(ptr(word));
+  }
+
+  auto contains(Key key) const -> bool { return find(key) != nullptr; }
+
+  // False if the slot is still held by another (older) key.
+  auto can_insert(Key key) const -> bool {
+    uint64_t word = slot(key).load(std::memory_order_relaxed);
+    return ptr(word) == 0 || (word & ~PTR_MASK) == tag(key);
+  }
+
+  // Writer only. Publishes value with a release store, so everything written
+  // to the pointee before the insert is visible to readers that find it.
+  auto insert(std::pair<Key, Value> pair) -> bool {
+    auto raw = reinterpret_cast<uint64_t>(pair.second);
+    assert((raw & ~PTR_MASK) == 0);
+    if (!can_insert(pair.first)) {
+      return false;
+    }
+    slot(pair.first).store(tag(pair.first) | raw, std::memory_order_release);
+    return true;
+  }
+
+  // Writer only. No-op if key is not present.
+  void erase(Key key) {
+    if (contains(key)) {
+      slot(key).store(0, std::memory_order_release);
+    }
+  }
+
+  auto capacity() const -> size_t { return mask_ + 1; }
+
+  // Scans every slot.
+  auto memory() const -> MemoryUsage {
+    MemoryUsage usage{capacity(), 0, 0,
+                      capacity() * sizeof(std::atomic<uint64_t>)};
+    for (size_t i = 0; i < capacity(); i++) {
+      usage.live += ptr(slots[i].load(std::memory_order_relaxed)) != 0;
+    }
+    return usage;
+  }
+  // memory().bytes of a table constructed with n.
+  static auto bytes_for(size_t n) -> size_t {
+    return std::bit_ceil(n) * sizeof(std::atomic<uint64_t>);
+  }
+};
+}; // namespace threadsafe
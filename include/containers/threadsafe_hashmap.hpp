@@ -1,6 +1,7 @@
 #pragma once
 #include <algorithm>
 #include <containers/flat_hashmap.hpp>
+#include <containers/memory_usage.hpp>
 #include <cstddef>
 #include <list>
 #include <mutex>
@@ -62,6 +63,13 @@ private:
       std::shared_lock<std::shared_mutex> lock(mutex);
       return (find_entry_for(key) != data.end());
     }
+    size_t size() const {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      return data.size();
+    }
+    // A list node: the entry and its two links.
+    static constexpr size_t NODE_BYTES =
+        sizeof(bucket_value) + 2 * sizeof(void *);
   };
 
   std::vector<std::unique_ptr<bucket_type>> buckets;
@@ -83,5 +91,18 @@ public:
   }
   bool contains(const Key &key) { return get_bucket(key).contains(key); }
   void erase(const Key &key) { return get_bucket(key).erase(key); }
+
+  // A slot per bucket, a heap node per entry. Locks each bucket in turn.
+  auto memory() const -> MemoryUsage {
+    MemoryUsage usage{
+        buckets.size(), 0, 0,
+        buckets.capacity() * sizeof(std::unique_ptr<bucket_type>) +
+            buckets.size() * sizeof(bucket_type)};
+    for (const auto &bucket : buckets) {
+      usage.live += bucket->size();
+    }
+    usage.bytes += usage.live * bucket_type::NODE_BYTES;
+    return usage;
+  }
 };
 }; // namespace threadsafe
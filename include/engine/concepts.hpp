@@ -28,6 +28,35 @@ concept ThreadSafeQueue = requires(Q &queue, T &item) {
   { queue.try_pop(item) } -> std::convertible_to<bool>;
 };
 
+// Consumer side that can take many items for one synchronisation.
+template <typename Q, typename T>
+concept BatchQueue = requires(Q &queue, T *items, size_t max) {
+  { queue.pop_batch(items, max) } -> std::convertible_to<size_t>;
+};
+
+// Producer side of a queue whose slots can be filled in place.
+template <typename Q, typename T>
+concept InPlaceQueue = requires(Q &queue) {
+  { queue.claim() } -> std::same_as<T *>;
+  { queue.publish() };
+};
+
+// Written once by one producer, read in place by each registered consumer.
+template <typename R, typename T>
+concept SequencedRing =
+    requires(R &ring, typename R::consumer_id id, uint64_t seq) {
+      { ring.claim() } -> std::same_as<T *>;
+      { ring.publish() };
+      { ring.commit() };
+      { ring.flush() };
+      { ring.flushed() } -> std::convertible_to<uint64_t>;
+      { ring.committed() } -> std::convertible_to<uint64_t>;
+      { ring.position(id) } -> std::convertible_to<uint64_t>;
+      { ring.available(id) } -> std::convertible_to<uint64_t>;
+      { ring[seq] } -> std::same_as<T &>;
+      { ring.release(id, seq) };
+    };
+
 template <typename M, typename K, typename V>
 concept Map = requires(M &map, K &key, V &value) {
   { map.insert({key, value}) };
@@ -36,6 +65,15 @@ concept Map = requires(M &map, K &key, V &value) {
   { map.erase(key) };
 };
 
+// Lookups return the value (or a null one) in one call, so a concurrent erase
+// can't slip in between a contains() and an at().
+template <typename M, typename K, typename V>
+concept ConnectionMap = requires(M &map, K &key, V &value) {
+  { map.insert({key, value}) } -> std::convertible_to<bool>;
+  { map.find(key) } -> std::convertible_to<V>;
+  { map.erase(key) };
+};
+
 template <typename A>
 concept Arena = requires(A arena, const ClientRequest &incoming, uint32_t idx) {
   { arena.allocateSlot(incoming) } -> std::convertible_to<uint32_t>;
@@ -49,6 +87,9 @@ concept RxTxBuffer =
       { rxtxbuffer.size() } -> std::convertible_to<size_t>;
       { rxtxbuffer.erase(count) };
       { rxtxbuffer.begin() } -> std::same_as<typename B::value_type *>;
+      { rxtxbuffer.prepare(count) } -> std::same_as<typename B::value_type *>;
+      { rxtxbuffer.commit(count) };
+      { rxtxbuffer.clear() };
     };
 
 template <typename C>
@@ -61,9 +102,11 @@ concept TachyonConfig = requires {
   // NOTE: these queues must be threadsafe.
   typename C::EventQueue;
   requires ThreadSafeQueue<typename C::EventQueue, ClientRequest>;
+  requires InPlaceQueue<typename C::EventQueue, ClientRequest>;
+  requires BatchQueue<typename C::EventQueue, ClientRequest>;
 
-  typename C::TradesQueue;
-  requires ThreadSafeQueue<typename C::TradesQueue, Trade>;
+  typename C::OutputRing;
+  requires SequencedRing<typename C::OutputRing, EngineOutput>;
 
   typename C::ExecReportQueue;
   requires ThreadSafeQueue<typename C::ExecReportQueue, ExecutionReport>;
@@ -89,8 +132,8 @@ concept TachyonConfig = requires {
 
   // NOTE: this must be threadsafe.
   typename C::ClientMap;
-  requires Map<typename C::ClientMap, ClientId,
-               typename C::ClientMap::mapped_type>;
+  requires ConnectionMap<typename C::ClientMap, ClientId,
+                         typename C::ClientMap::mapped_type>;
 };
 
 // Now we initialise our policies.
@@ -2,11 +2,19 @@
 #define CONSTANTS_HPP
 
 #include <cstddef>
+#include <cstdint>
 // NOTE: These constants are for simulation and testing purposes only.
 static constexpr size_t MAX_PROCESSED_EVENTS_SIZE = 100000;
 static constexpr size_t MAX_TRADE_BUFFER_SIZE = 1000;
 static constexpr size_t MAX_TRADES_QUEUE_SIZE = 100000;
 static constexpr size_t MAX_EXECUTION_REPORTS_SIZE = 100000;
+static constexpr size_t ENGINE_BATCH_SIZE = 32; // events per engine pass.
+// Every this many batches the engine reads its hardware counters around one,
+// 0 never does. A sample costs a few microseconds of syscalls.
+static constexpr size_t ENGINE_PERF_SAMPLE_INTERVAL = 0;
+// Slots in each of the order book's order id indexes, sized up front so they
+// don't grow (and allocate) while the engine runs. Good for ~200k resting.
+static constexpr size_t ORDERBOOK_INDEX_CAPACITY = 1 << 18;
 
 static constexpr size_t NUM_DEFAULT_CLIENTS = 4;
 
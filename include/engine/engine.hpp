@@ -10,6 +10,7 @@
 #include "types.hpp"
 #include <engine/concepts.hpp>
 #include <engine/logger.hpp>
+#include <network/market_data.hpp>
 
 template <TachyonConfig config> class Engine {
 private:
@@ -18,16 +19,14 @@ private:
   // static const uint16_t MAX_TRADE_BUFFER_SIZE = 100;
 
   config::EventQueue &event_queue;
-  // NOTE: we should clear the following queues later.
-
-  // config::TradesQueue &trades_queue;
-  // config::ExecReportQueue &execution_reports;
-  LoggerClass<config> &logger;
-  config::EventQueue &processed_events;
-  std::vector<std::pair<Trade, ClientRequest>> trades_buffer;
+  LoggerClass<config> &logger; // writes everything we output.
+  md::Publisher &market_data; // book and trade updates, this thread writes.
 
   OrderBook<config> &orderbook;
+  std::vector<ClientRequest> batch; // popped together, size is the maximum.
+  size_t perf_sample_interval;      // batches, 0: hardware counters off.
   // Helper functions for logging.
+  void matchAndReport(ClientRequest &incoming, TimeStamp now);
 
   //  Helper functions to handle proper routing to matching function.
   void handle_GTC_LIMIT(ClientRequest &incoming, TimeStamp now);
@@ -37,12 +36,20 @@ private:
   void handle_IOC_LIMIT(ClientRequest &incoming, TimeStamp now);
   void handle_IOC_MARKET(ClientRequest &incoming, TimeStamp now);
 
+  void handleEvent(ClientRequest &incoming, TimeStamp now);
+
   // Helper function for writing logs to disk.
   void writeLogs();
 
 public:
-  Engine(config::EventQueue &ev_q, config::EventQueue &prcs_events,
-         OrderBook<config> &orderbook, LoggerClass<config> &lgr);
+  // Events are taken off the queue up to max_batch at a time, stamped with
+  // one clock read, and their output published together. Every
+  // perf_sample_interval batches, one is measured with the hardware
+  // counters and the counts added to the metrics.
+  Engine(config::EventQueue &ev_q, OrderBook<config> &orderbook,
+         LoggerClass<config> &lgr, md::Publisher &market_data,
+         size_t max_batch = ENGINE_BATCH_SIZE,
+         size_t perf_sample_interval = ENGINE_PERF_SAMPLE_INTERVAL);
   void handleEvents(); // runs on seperate thread.
   void writeLogsContinuous();
   ~Engine();
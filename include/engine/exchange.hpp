@@ -2,6 +2,7 @@
 #define EXCHANGE_HPP
 
 #include <chrono>
+#include <network/market_data.hpp>
 #include <network/tcpserver.hpp>
 #include <thread>
 
@@ -10,21 +11,37 @@
 #include "engine/concepts.hpp"
 #include "engine/engine.hpp"
 #include "engine/logger.hpp"
+#include "engine/numa.hpp"
 #include "engine/orderbook.hpp"
+#include "engine/settings.hpp"
 #include "engine/types.hpp"
+#include "telemetry/metrics.hpp"
+#include "telemetry/watchdog.hpp"
 
 template <TachyonConfig config> class Exchange {
 private:
+  // First, so it is checked before anything below is allocated to it.
+  const settings::Settings settings;
+  static auto checked(const settings::Settings &s) -> settings::Settings;
+  const numa::Topology topology = numa::Topology::read();
   // Various queues necessary.
   config::EventQueue event_queue;
-  config::EventQueue processed_events;
-  config::TradesQueue trades_queue;
-  config::ExecReportQueue execution_report;
+  // Everything the engine outputs, written once and read in place by each
+  // stage below. The dispatcher trails the journal, so a client never hears
+  // about an event the journal hasn't written.
+  config::OutputRing engine_output;
+  using consumer_id = typename config::OutputRing::consumer_id;
+  consumer_id journal = engine_output.add_consumer();
+  consumer_id trade_log = engine_output.add_consumer();
+  consumer_id dispatch = engine_output.add_consumer({journal});
   // Key components.
   OrderBook<config> orderbook;
   LoggerClass<config> logger;
+  md::Publisher market_data; // local consumers read it from shared memory.
   Engine<config> engine;
   TcpServer<config> tcpserver;
+  metrics::Exporter metrics_exporter;
+  watchdog::Watchdog watchdog;
 
   // Threads.
   std::thread engine_event_handler;
@@ -36,8 +53,21 @@ private:
   // Start time of Exchange.
   std::chrono::steady_clock::time_point start;
 
+  // Nodes for settings' NUMA placement, NO_NODE where it is left alone.
+  auto engineNode() const -> int { return settings.engine_node; }
+  auto gatewayNode() const -> int {
+    return settings.gateway_node != settings::NO_NODE ? settings.gateway_node
+                                                      : settings.engine_node;
+  }
+  // Moves the tables to their nodes and says where everything went.
+  void place();
+
 public:
-  Exchange();
+  // Throws std::runtime_error if the settings don't fit their memory budget
+  // or name a NUMA node this machine doesn't have.
+  explicit Exchange(const settings::Settings &s = {});
+  // Bytes allocated up front for s, the queues, book and connections.
+  static auto footprint(const settings::Settings &s) -> size_t;
   ~Exchange();
   void init();
   void stop();
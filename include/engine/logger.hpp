@@ -1,29 +1,49 @@
 #pragma once
 #include <engine/concepts.hpp>
 #include <engine/types.hpp>
+#include <fstream>
 
+// Producer side of the engine's output ring, it runs on the engine thread.
+// Also the two log writing stages reading that ring, each on its own thread:
+// the journal (processed events) and the trade log.
 template <TachyonConfig config> class LoggerClass {
 private:
+  using consumer_id = typename config::OutputRing::consumer_id;
+
   config::EventQueue &event_queue;
-  config::ExecReportQueue &execution_reports;
-  config::TradesQueue &trades;
-  config::EventQueue &processed_events;
+  config::OutputRing &output;
+  consumer_id journal;
+  consumer_id trade_log;
+  std::ofstream events_file;
+  std::ofstream trades_file;
+  EngineOutput *last_output = nullptr; // claimed last, not yet published.
+
+  auto claimOutput() -> EngineOutput *;
+  void publishHeld(TimeStamp done); // stamps the events held back, flushes.
+  auto claimReport() -> ExecutionReport *; // zeroed, publish when filled.
 
 public:
-  LoggerClass(config::EventQueue &ev_queue, config::ExecReportQueue &exec_queue,
-              config::TradesQueue &tr_queue, config::EventQueue &prcs_events);
+  LoggerClass(config::EventQueue &ev_queue, config::OutputRing &engine_output,
+              consumer_id journal_consumer, consumer_id trade_log_consumer);
   ~LoggerClass();
+  // Output is held back until flush(), the engine calls it once per batch
+  // with the time it was done with the batch.
+  void flush(TimeStamp done);
+  void logEvent(ClientRequest &incoming); // Request processed by the engine.
+  void finishEvent(); // Everything for the last event is logged.
   void logNotFound(ClientRequest &incoming);
   void logSelfTrade(ClientRequest &incoming); // User tried self trade
   void logInvalidOrder(ClientRequest &incoming);
   void logNewOrder(ClientRequest &incoming);    // New order logged
   void logCancelOrder(ClientRequest &incoming); // Cancellation successful.
   void
-  logTrade(Trade &trade, ClientRequest &resting, ClientRequest &incoming,
+  logTrade(const Trade &trade, const ClientRequest &resting,
+           const ClientRequest &incoming,
            Quantity trade_quantity); // Trade has happened, send report to both.
 
-  void writeProcessedEventsLogs();
+  // Write whatever has reached the stage, false if there was nothing.
+  auto writeProcessedEventsLogs() -> bool;
   void writeProcessedEventsLogsContinuous();
-  void writeTradeLogs();
+  auto writeTradeLogs() -> bool;
   void writeTradeLogsContinuous();
 };
@@ -0,0 +1,222 @@
+#pragma once
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Puts threads and the memory they work on on the same NUMA node. On a
+// multi socket box a thread reading memory attached to the other socket
+// pays the interconnect on every cache miss, and the kernel's first touch
+// placement only gets it right if the thread that touched a table first is
+// the one that uses it, which at startup it rarely is.
+//
+// Straight syscalls (mbind, set_mempolicy, sched_setaffinity) so there is
+// no libnuma to depend on. Memory is placed preferred, not bound: if the
+// node runs out, pages come from another one rather than the OOM killer.
+// Pages already touched are migrated; the rest land on the node when first
+// touched. A table that later reallocates (a hash map growing) loses its
+// placement, so size them up front, see engine/settings.hpp.
+
+namespace numa {
+static constexpr int NO_NODE = -1;
+static constexpr size_t MAX_NODES = 1024;
+static constexpr const char *SYSFS_NODES = "/sys/devices/system/node";
+
+struct Node {
+  int id;
+  std::vector<int> cpus;
+  size_t memory_bytes = 0;
+};
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11, the format of sysfs cpu and node lists.
+inline auto parse_list(const std::string &text) -> std::vector<int> {
+  std::vector<int> ids;
+  size_t at = 0;
+  while (at < text.size()) {
+    size_t end = text.find(',', at);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    std::string range = text.substr(at, end - at);
+    int first = 0, last = 0;
+    int fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (fields >= 1) {
+      for (int id = first; id <= (fields == 2 ? last : first); id++) {
+        ids.push_back(id);
+      }
+    }
+    at = end + 1;
+  }
+  return ids;
+}
+
+inline auto read_line(const std::string &path) -> std::string {
+  FILE *file = std::fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return {};
+  }
+  char line[4096];
+  std::string text = std::fgets(line, sizeof(line), file) ? line : "";
+  std::fclose(file);
+  while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+    text.pop_back();
+  }
+  return text;
+}
+
+struct Topology {
+  std::vector<Node> nodes;
+
+  // From sysfs. A kernel built without NUMA has no node directory: that is
+  // one node 0 with every cpu.
+  static auto read(const std::string &root = SYSFS_NODES) -> Topology {
+    Topology topology;
+    for (int id : parse_list(read_line(root + "/online"))) {
+      std::string dir = root + "/node" + std::to_string(id);
+      Node node{id, parse_list(read_line(dir + "/cpulist"))};
+      unsigned long kb = 0;
+      std::string meminfo = read_line(dir + "/meminfo");
+      if (std::sscanf(meminfo.c_str(), "Node %*d MemTotal: %lu kB", &kb) ==
+          1) {
+        node.memory_bytes = size_t{kb} << 10;
+      }
+      topology.nodes.push_back(std::move(node));
+    }
+    if (topology.nodes.empty()) {
+      Node node{0, {}};
+      for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN); cpu++) {
+        node.cpus.push_back(static_cast<int>(cpu));
+      }
+      topology.nodes.push_back(std::move(node));
+    }
+    return topology;
+  }
+
+  auto find(int id) const -> const Node * {
+    for (const Node &node : nodes) {
+      if (node.id == id) {
+        return &node;
+      }
+    }
+    return nullptr;
+  }
+
+  // "node 0: cpus 0-3 memory 6003 MiB", one line a node.
+  auto describe() const -> std::string {
+    std::string text;
+    for (const Node &node : nodes) {
+      text += "node " + std::to_string(node.id) + ": cpus";
+      for (size_t i = 0; i < node.cpus.size(); i++) {
+        size_t run = i;
+        while (run + 1 < node.cpus.size() &&
+               node.cpus[run + 1] == node.cpus[run] + 1) {
+          run++;
+        }
+        text += (i == 0 ? " " : ",") + std::to_string(node.cpus[i]);
+        if (run != i) {
+          text += "-" + std::to_string(node.cpus[run]);
+        }
+        i = run;
+      }
+      text += " memory " + std::to_string(node.memory_bytes >> 20) + " MiB\n";
+    }
+    return text;
+  }
+};
+
+// The node the calling thread is running on right now.
+inline auto current_node() -> int {
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return NO_NODE;
+  }
+  return static_cast<int>(node);
+}
+
+struct NodeMask {
+  unsigned long bits[MAX_NODES / (8 * sizeof(unsigned long))]{};
+
+  explicit NodeMask(int node) {
+    bits[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+  }
+};
+
+// Prefers node for the pages of [addr, addr + bytes) and moves those
+// already there. Only whole pages inside the range are placed: a small
+// table sharing its pages with others is left where it is. False if the
+// kernel refused.
+inline auto place(const void *addr, size_t bytes, int node) -> bool {
+  if (node == NO_NODE || node < 0 || static_cast<size_t>(node) >= MAX_NODES) {
+    return node == NO_NODE;
+  }
+  auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t first = (start + page - 1) & ~(page - 1);
+  uintptr_t last = (start + bytes) & ~(page - 1);
+  if (last <= first) {
+    return true;
+  }
+  NodeMask mask(node);
+  return syscall(SYS_mbind, first, last - first, MPOL_PREFERRED, mask.bits,
+                 MAX_NODES + 1, MPOL_MF_MOVE) == 0;
+}
+
+// Every block a container holds, if it says what they are (regions()).
+template <typename Container>
+auto place(const Container &container, int node) -> bool {
+  bool placed = true;
+  if constexpr (requires {
+                  container.regions([](const void *, size_t) {});
+                }) {
+    container.regions([&](const void *addr, size_t bytes) {
+      placed = place(addr, bytes, node) && placed;
+    });
+  }
+  return placed;
+}
+
+// Keeps the calling thread on node's cpus and has its own allocations
+// prefer node's memory. False if the kernel refused either.
+inline auto run_on(const Topology &topology, int node) -> bool {
+  const Node *target = topology.find(node);
+  if (target == nullptr) {
+    return node == NO_NODE;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : target->cpus) {
+    CPU_SET(cpu, &cpus);
+  }
+  bool pinned = sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+  NodeMask mask(node);
+  return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.bits,
+                 MAX_NODES + 1) == 0 &&
+         pinned;
+}
+
+// A thread that moves to node before running f(args...), so even its first
+// allocations are local. NO_NODE runs it wherever the scheduler likes.
+template <typename F, typename... Args>
+auto spawn(const Topology &topology, int node, F &&f, Args &&...args)
+    -> std::thread {
+  return std::thread(
+      [node, topology, f = std::forward<F>(f),
+       ... args = std::forward<Args>(args)]() mutable {
+        if (!run_on(topology, node)) {
+          std::fprintf(stderr, "numa: couldn't move a thread to node %d\n",
+                       node);
+        }
+        std::invoke(f, args...);
+      });
+}
+}; // namespace numa
@@ -6,13 +6,17 @@
 #include <cstdint>
 #include <deque>
 #include <ranges>
+#include <utility>
 #include <vector>
 
 #include "containers/flat_hashmap.hpp"
 #include "containers/intrusive_list.hpp"
+#include "containers/memory_usage.hpp"
 #include "engine/concepts.hpp"
 #include "engine/constants.hpp"
+#include "engine/settings.hpp"
 #include "engine/types.hpp"
+#include "telemetry/trace.hpp"
 
 // TODO: Make the arena also an concept
 // Change intrusive list to accept an index and reference to arena.
@@ -48,12 +52,13 @@ private:
   config::ListIdxMap list_idx;
   config::PriceLevelHierarchyType bids; // people buying stuff
   config::PriceLevelHierarchyType asks; // people selling stuff
+  size_t resting = 0;                   // orders in the book.
+  size_t live_levels = 0;               // levels with orders, both sides.
+  Price min_price;                      // of bids[0] and asks[0].
 
-  template <typename BookType, typename CompareFunc>
-  void
-  matchImplementation(ClientRequest &incoming, BookType &book,
-                      CompareFunc priceCrosses,
-                      std::vector<std::pair<Trade, ClientRequest>> &trades) {
+  template <typename BookType, typename CompareFunc, typename Sink>
+  void matchImplementation(ClientRequest &incoming, BookType &book,
+                           CompareFunc priceCrosses, Sink &on_fill) {
     Price book_price = 0;
     if (incoming.new_order.side == Side::BID) {
       while (book_price < book.size() && book[book_price].size() == 0) {
@@ -100,15 +105,17 @@ private:
         new_trade.price = book_it->new_order.price;
         new_trade.maker_order_id = book_it->new_order.order_id;
         new_trade.taker_order_id = incoming.new_order.order_id;
-        trades.push_back({new_trade, *book_it});
-        // TODO: log execution reports too.
+        TRACE_INSTANT(BOOK_FILL, new_trade.maker_order_id);
+        on_fill(new_trade, std::as_const(*book_it));
         if (book_it->new_order.quantity == 0) {
           // old elements from arena.
           // TODO: erasing from arena has linear complexity. Do something.
           arena.freeSlot(arena_idx.at(book_it->new_order.order_id));
           arena_idx.erase(book_it->new_order.order_id);
           list_idx.erase(book_it->new_order.order_id);
+          resting--;
           book_it = book[book_price].erase(book_it); // remove finished orders.
+          live_levels -= book[book_price].size() == 0;
 
         } else {
           book_it++; // Do we really need this?
@@ -130,19 +137,121 @@ private:
   }
 
 public:
-  OrderBook()
-      : bids(std::vector<intrusive_list<ClientRequest>>(
-            uint32_t((CLIENT_PRICE_DISTRIB_MAX) - (CLIENT_PRICE_DISTRIB_MIN)) +
-            1)),
-        asks(std::vector<intrusive_list<ClientRequest>>(
-            uint32_t((CLIENT_PRICE_DISTRIB_MAX) - (CLIENT_PRICE_DISTRIB_MIN)) +
-            1))
+  // A level per price in the settings' band, the arena and indexes sized
+  // for as many resting orders as they say.
+  explicit OrderBook(const settings::Settings &s = {})
+      : arena(s.arena_capacity), arena_idx(s.order_index_capacity),
+        list_idx(s.order_index_capacity),
+        bids(std::vector<intrusive_list<ClientRequest>>(s.max_price -
+                                                        s.min_price + 1)),
+        asks(std::vector<intrusive_list<ClientRequest>>(s.max_price -
+                                                        s.min_price + 1)),
+        min_price(s.min_price) {}
 
-  {}
+  // memory().total().bytes of a book constructed with s.
+  static auto footprint(const settings::Settings &s) -> size_t {
+    using Level = typename config::PriceLevelHierarchyType::value_type;
+    size_t bytes = 2 * (s.max_price - s.min_price + 1) * sizeof(Level);
+    if constexpr (requires { config::ArenaType::bytes_for(0); }) {
+      bytes += config::ArenaType::bytes_for(s.arena_capacity);
+    }
+    if constexpr (requires { config::ArenaIdxMap::bytes_for(0); }) {
+      bytes += config::ArenaIdxMap::bytes_for(s.order_index_capacity);
+    }
+    if constexpr (requires { config::ListIdxMap::bytes_for(0); }) {
+      bytes += config::ListIdxMap::bytes_for(s.order_index_capacity);
+    }
+    return bytes;
+  }
+  auto minPrice() const -> Price { return min_price; }
+  auto maxPrice() const -> Price { return min_price + bids.size() - 1; }
+  auto inBand(Price price) const -> bool {
+    return price >= minPrice() && price <= maxPrice();
+  }
   void add(ClientRequest &incoming);
+  // Calls on_fill(Trade &, const ClientRequest &resting) for each fill, in
+  // order. resting is the order still in the book, quantity already reduced,
+  // so nothing is copied; on_fill must not change the book.
+  template <typename Sink>
+    requires std::invocable<Sink &, Trade &, const ClientRequest &>
+  void match(ClientRequest &incoming, Sink &&on_fill) {
+    TRACE_BEGIN(BOOK_MATCH, incoming.new_order.order_id);
+    if (incoming.new_order.side == Side::BID) {
+      matchImplementation(
+          incoming, asks,
+          [](Price p_sell, Price p_buy) -> bool { return (p_buy >= p_sell); },
+          on_fill);
+    } else {
+      matchImplementation(
+          incoming, bids,
+          [](Price p_buy, Price p_sell) -> bool { return (p_buy >= p_sell); },
+          on_fill);
+    }
+    TRACE_END(BOOK_MATCH, incoming.new_order.order_id);
+  }
+  // Collects copies of the fills instead, handy for tests.
   void match(ClientRequest &incoming,
              std::vector<std::pair<Trade, ClientRequest>> &trades);
   auto cancelOrder(OrderId order_id, ClientRequest &to_cancel) -> bool;
+  // Starts pulling in the index entries cancelOrder(order_id) will read.
+  void prefetchCancel(OrderId order_id) {
+    if constexpr (requires { list_idx.prefetch(order_id); }) {
+      list_idx.prefetch(order_id);
+    }
+    if constexpr (requires { arena_idx.prefetch(order_id); }) {
+      arena_idx.prefetch(order_id);
+    }
+  }
+  // What the book takes, by part. The orders themselves live in the arena;
+  // a price level is just a list head threading through them.
+  struct Memory {
+    MemoryUsage arena;
+    MemoryUsage arena_idx; // order id -> arena slot.
+    MemoryUsage list_idx;  // order id -> place in its price level.
+    MemoryUsage levels;    // live: levels with orders, both sides.
+    auto total() const -> MemoryUsage {
+      MemoryUsage sum = arena;
+      sum += arena_idx;
+      sum += list_idx;
+      sum += levels;
+      return sum;
+    }
+  };
+  auto memory() const -> Memory {
+    Memory usage;
+    if constexpr (requires { arena.memory(); }) {
+      usage.arena = arena.memory();
+    }
+    if constexpr (requires { arena_idx.memory(); }) {
+      usage.arena_idx = arena_idx.memory();
+    }
+    if constexpr (requires { list_idx.memory(); }) {
+      usage.list_idx = list_idx.memory();
+    }
+    for (const auto *side : {&bids, &asks}) {
+      usage.levels.capacity += side->size();
+      usage.levels.bytes += side->capacity() * sizeof((*side)[0]);
+    }
+    usage.levels.live = live_levels;
+    return usage;
+  }
+  // Calls visit(address, bytes) for each block the book holds, of the
+  // parts that say what theirs are.
+  template <typename Visit> void regions(Visit &&visit) const {
+    if constexpr (requires { arena.regions(visit); }) {
+      arena.regions(visit);
+    }
+    if constexpr (requires { arena_idx.regions(visit); }) {
+      arena_idx.regions(visit);
+    }
+    if constexpr (requires { list_idx.regions(visit); }) {
+      list_idx.regions(visit);
+    }
+    for (const auto *side : {&bids, &asks}) {
+      visit(side->data(), side->capacity() * sizeof((*side)[0]));
+    }
+  }
+  auto size() const -> size_t { return resting; } // O(1), unlike these two.
   auto size_asks() -> size_t;
   auto size_bids() -> size_t;
 };
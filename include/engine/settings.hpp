@@ -0,0 +1,250 @@
+#pragma once
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+#include "engine/constants.hpp"
+#include "engine/types.hpp"
+
+// What the exchange is sized for, read once at startup. The policy types
+// (which queue, which map) stay compile time in the config struct; these
+// are the numbers they are built with: every queue, the arena, the order
+// indexes and the connection table are allocated to these capacities up
+// front so the hot path never grows them.
+//
+// The file is "key = value" lines, '#' starts a comment:
+//
+//   port = 12345
+//   event_queue_capacity = 1M   # K, M and G are powers of 1024.
+//   memory_budget = 2G
+//   engine_node = 0
+//   queue_placement = consumer
+//
+// Keys left out keep the defaults below, which are what the exchange was
+// built with before there was a file. A key that isn't known, a value that
+// isn't a number or settings that don't make sense throw, naming the line.
+
+namespace settings {
+static constexpr const char *DEFAULT_PATH = "tachyon.conf";
+
+// Prices the market data snapshot has a level for; the book's band has to
+// fit inside.
+static constexpr Price LOWEST_PRICE =
+    CLIENT_BASE_PRICE + CLIENT_PRICE_DISTRIB_MIN; // distrib min is -ve.
+static constexpr Price HIGHEST_PRICE =
+    CLIENT_BASE_PRICE + CLIENT_PRICE_DISTRIB_MAX;
+
+static constexpr int NO_NODE = -1;
+static constexpr int MAX_NODE = 1023;
+
+// Whose node a queue's buffer goes on.
+enum class QueuePlacement : uint8_t { CONSUMER, PRODUCER };
+
+struct Settings {
+  std::string port = "12345";
+  uint64_t duration_ms = 50000; // how long main runs the exchange.
+
+  size_t event_queue_capacity = 1 << 20; // requests, gateway to engine.
+  size_t output_ring_capacity = 1 << 20; // engine output records.
+  size_t arena_capacity = 10'000'000;    // resting orders.
+  size_t order_index_capacity = ORDERBOOK_INDEX_CAPACITY; // per index.
+  size_t connection_table_size = 4096;   // live sessions by client id.
+  size_t connections = 64; // pooled up front, and added this many at a time.
+  // Each connection's receive and send buffer. The receive thread asks for
+  // 4 KB per recv, so below 8 KB the receive buffer grows on first use.
+  size_t connection_buffer_bytes = 8192;
+  // A disconnected client's session (the reports it can still be replayed)
+  // is kept this long for it to resume, then dropped.
+  uint64_t session_grace_ms = 30000;
+  // Sessions kept at once, connected or waiting out their grace; past it
+  // new clients are refused, those resuming are not. 0 for
+  // connection_table_size, which bounds it.
+  size_t max_sessions = 0;
+
+  Price min_price = LOWEST_PRICE; // the book's band, inclusive.
+  Price max_price = HIGHEST_PRICE;
+
+  // Bytes everything above may allocate, 0 for no limit.
+  size_t memory_budget = 0;
+
+  // NUMA placement, see engine/numa.hpp; NO_NODE leaves it to the kernel.
+  // The engine, the book and the log writers go on engine_node, the
+  // receive and dispatcher threads on gateway_node (the NIC's, ideally),
+  // the engine's if it isn't set. The event queue's consumer is the
+  // engine; the output ring's is taken to be the dispatcher, the one a
+  // client waits on.
+  int engine_node = NO_NODE;
+  int gateway_node = NO_NODE;
+  QueuePlacement queue_placement = QueuePlacement::CONSUMER;
+};
+
+// "1M" -> 1048576. Throws std::invalid_argument on anything else.
+inline auto parse_size(const std::string &text) -> uint64_t {
+  if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+    throw std::invalid_argument("not a number");
+  }
+  size_t used = 0;
+  uint64_t value = std::stoull(text, &used);
+  std::string rest = text.substr(used);
+  if (rest.empty()) {
+    return value;
+  }
+  if (rest.size() == 1) {
+    switch (std::toupper(static_cast<unsigned char>(rest[0]))) {
+    case 'K':
+      return value << 10;
+    case 'M':
+      return value << 20;
+    case 'G':
+      return value << 30;
+    default:
+      break;
+    }
+  }
+  throw std::invalid_argument("not a number");
+}
+
+// Throws std::invalid_argument if the settings can't work together.
+inline void validate(const Settings &s) {
+  auto fail = [](const std::string &why) {
+    throw std::invalid_argument(why);
+  };
+  if (s.port.empty() || s.port.size() > 5 ||
+      s.port.find_first_not_of("0123456789") != std::string::npos ||
+      std::stoul(s.port) > 65535) {
+    fail("port must be a number up to 65535");
+  }
+  if (s.event_queue_capacity < 2 || s.output_ring_capacity < 2) {
+    fail("queue capacities must be at least 2");
+  }
+  if (s.arena_capacity == 0 || s.arena_capacity > UINT32_MAX) {
+    fail("arena_capacity must be between 1 and 2^32 - 1");
+  }
+  if (s.order_index_capacity == 0) {
+    fail("order_index_capacity must be above 0");
+  }
+  if (s.connection_table_size == 0 || s.connections == 0 ||
+      s.connection_buffer_bytes == 0) {
+    fail("connection settings must be above 0");
+  }
+  if (s.max_sessions > s.connection_table_size) {
+    fail("max_sessions can't be above connection_table_size");
+  }
+  if (s.min_price > s.max_price || s.min_price < LOWEST_PRICE ||
+      s.max_price > HIGHEST_PRICE) {
+    fail("price band must be within " + std::to_string(LOWEST_PRICE) + ".." +
+         std::to_string(HIGHEST_PRICE));
+  }
+  if (s.engine_node < NO_NODE || s.engine_node > MAX_NODE ||
+      s.gateway_node < NO_NODE || s.gateway_node > MAX_NODE) {
+    fail("nodes must be at most " + std::to_string(MAX_NODE));
+  }
+}
+
+// Reads settings from text, starting from the defaults. source names it in
+// errors.
+inline auto parse(std::istream &in, const std::string &source) -> Settings {
+  Settings s;
+  std::string line;
+  for (size_t number = 1; std::getline(in, line); number++) {
+    auto fail = [&](const std::string &why) {
+      throw std::runtime_error(source + ":" + std::to_string(number) + ": " +
+                               why);
+    };
+    line = line.substr(0, line.find('#'));
+    auto trim = [](std::string text) {
+      size_t first = text.find_first_not_of(" \t\r");
+      size_t last = text.find_last_not_of(" \t\r");
+      return first == std::string::npos ? std::string()
+                                        : text.substr(first, last - first + 1);
+    };
+    if (trim(line).empty()) {
+      continue;
+    }
+    size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      fail("expected key = value");
+    }
+    std::string key = trim(line.substr(0, equals));
+    std::string value = trim(line.substr(equals + 1));
+    if (key == "port") {
+      s.port = value;
+      continue;
+    }
+    if (key == "queue_placement") {
+      if (value == "consumer") {
+        s.queue_placement = QueuePlacement::CONSUMER;
+      } else if (value == "producer") {
+        s.queue_placement = QueuePlacement::PRODUCER;
+      } else {
+        fail("queue_placement is consumer or producer, not '" + value + "'");
+      }
+      continue;
+    }
+    uint64_t number_value = 0;
+    try {
+      number_value = parse_size(value);
+    } catch (const std::exception &) {
+      fail("'" + value + "' is not a number for " + key);
+    }
+    if (key == "duration_ms") {
+      s.duration_ms = number_value;
+    } else if (key == "event_queue_capacity") {
+      s.event_queue_capacity = number_value;
+    } else if (key == "output_ring_capacity") {
+      s.output_ring_capacity = number_value;
+    } else if (key == "arena_capacity") {
+      s.arena_capacity = number_value;
+    } else if (key == "order_index_capacity") {
+      s.order_index_capacity = number_value;
+    } else if (key == "connection_table_size") {
+      s.connection_table_size = number_value;
+    } else if (key == "connections") {
+      s.connections = number_value;
+    } else if (key == "connection_buffer_bytes") {
+      s.connection_buffer_bytes = number_value;
+    } else if (key == "session_grace_ms") {
+      s.session_grace_ms = number_value;
+    } else if (key == "max_sessions") {
+      s.max_sessions = number_value;
+    } else if (key == "min_price") {
+      s.min_price = number_value;
+    } else if (key == "max_price") {
+      s.max_price = number_value;
+    } else if (key == "memory_budget") {
+      s.memory_budget = number_value;
+    } else if (key == "engine_node" || key == "gateway_node") {
+      int &node = key == "engine_node" ? s.engine_node : s.gateway_node;
+      node = number_value > MAX_NODE ? MAX_NODE + 1
+                                     : static_cast<int>(number_value);
+    } else {
+      fail("unknown setting '" + key + "'");
+    }
+  }
+  try {
+    validate(s);
+  } catch (const std::invalid_argument &e) {
+    throw std::runtime_error(source + ": " + e.what());
+  }
+  return s;
+}
+
+inline auto load(const std::string &path) -> Settings {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error(path + ": can't be read");
+  }
+  return parse(file, path);
+}
+
+// The defaults if there is no file at path.
+inline auto load_or_defaults(const std::string &path = DEFAULT_PATH)
+    -> Settings {
+  std::ifstream file(path);
+  return file ? parse(file, path) : Settings{};
+}
+}; // namespace settings
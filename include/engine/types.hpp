@@ -105,4 +105,89 @@ struct __attribute__((packed)) Trade {
 };
 // Size = 4 + 4 + 8 + 8 + 4 + 1 = 29 bytes.
 // Not too much space wasted.
+
+// A match as the engine records it: one store per fill. Later stages expand
+// it into the Trade and the two ExecutionReports, off the matching thread.
+struct __attribute__((packed)) Fill {
+  OrderId maker_order_id;
+  OrderId taker_order_id;
+  ClientId maker_client_id;
+  ClientId taker_client_id;
+  TimeStamp time_stamp;
+  Price price;               // the resting order's.
+  Quantity quantity;         // traded.
+  Quantity maker_remaining;  // left on each order after this fill.
+  Quantity taker_remaining;
+  Side aggressor_side;       // the taker's side.
+};
+// Size = 8 + 8 + 4 + 4 + 8 + 8 + 4 + 4 + 4 + 1 = 53 bytes.
+
+inline auto trade_of(const Fill &fill) -> Trade {
+  return {fill.maker_order_id, fill.taker_order_id, fill.time_stamp,
+          fill.price,          fill.quantity,       fill.aggressor_side};
+}
+
+inline auto taker_report(const Fill &fill) -> ExecutionReport {
+  return {fill.taker_client_id, fill.taker_order_id, fill.price,
+          fill.quantity,        fill.taker_remaining, ExecType::TRADE,
+          RejectReason::NONE,   fill.aggressor_side};
+}
+
+inline auto maker_report(const Fill &fill) -> ExecutionReport {
+  Side maker = fill.aggressor_side == Side::BID ? Side::ASK : Side::BID;
+  return {fill.maker_client_id, fill.maker_order_id, fill.price,
+          fill.quantity,        fill.maker_remaining, ExecType::TRADE,
+          RejectReason::NONE,   maker};
+}
+
+// Everything the engine produces, in the order it produced it. A single ring
+// of these feeds every stage after the engine (logs, dispatcher), which pick
+// out the kinds they care about.
+enum class OutputType : uint8_t { EVENT, FILL, REPORT };
+
+// A request as the journal keeps it: the ClientRequest without the book's
+// list links, which mean nothing outside the book.
+struct __attribute__((packed)) RequestRecord {
+  RequestType type;
+  ClientId client_id;
+  TimeStamp time_stamp; // when the gateway received it.
+  union {
+    Order new_order;
+    OrderId order_id_to_cancel;
+  };
+};
+// Size = 1 + 4 + 8 + 23 = 36 bytes.
+
+inline auto record_of(const ClientRequest &request) -> RequestRecord {
+  RequestRecord record{};
+  record.type = request.type;
+  record.client_id = request.client_id;
+  record.time_stamp = request.time_stamp;
+  if (request.type == RequestType::New) {
+    record.new_order = request.new_order;
+  } else {
+    record.order_id_to_cancel = request.order_id_to_cancel;
+  }
+  return record;
+}
+
+struct EngineOutput {
+  OutputType type;
+  union {
+    RequestRecord event;    // request as processed.
+    Fill fill;              // a trade, reports for both sides.
+    ExecutionReport report; // any other report.
+  };
+  // Set on the last entry for a request, whatever its type. What is
+  // published doesn't say: with the ring full, the engine publishes a
+  // request's entries before it is done with it.
+  bool ends_request = false;
+  // EVENT only: when the engine was done with the request, or published it
+  // unfinished.
+  TimeStamp completed = 0;
+  EngineOutput() : type(OutputType::EVENT), event{} {}
+};
+// Size = 1 + 53 (packed members) + 1 + 1 padding + 8 = 64 bytes, a cache
+// line.
+static_assert(sizeof(EngineOutput) == 64);
 #endif
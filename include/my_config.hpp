@@ -3,8 +3,11 @@
 #include "containers/arena.hpp"
 #include "containers/flat_buffer.hpp"
 #include "containers/flat_hashmap.hpp"
+#include "containers/huge_page_allocator.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/lock_queue.hpp"
+#include "containers/sequenced_ring.hpp"
+#include "containers/slot_table.hpp"
 #include "containers/threadsafe_hashmap.hpp"
 #include "engine/types.hpp"
 #include "network/tcpserver.hpp"
@@ -12,6 +15,7 @@
 template <typename T> class testbuffer {
 private:
   std::vector<T> buffer;
+  size_t committed = 0; // size before the last prepare().
 
 public:
   using value_type = T;
@@ -21,6 +25,12 @@ public:
   void insert(T *start, size_t count) {
     buffer.insert(buffer.end(), start, start + count);
   }
+  T *prepare(size_t count) {
+    committed = buffer.size();
+    buffer.resize(committed + count);
+    return buffer.data() + committed;
+  }
+  void commit(size_t count) { buffer.resize(committed + count); }
   void erase(size_t count) {
     buffer.erase(buffer.begin(), buffer.begin() + count);
   }
@@ -31,25 +41,32 @@ public:
 
 // Our sample config.
 struct my_config {
+  // The big tables (queues, arena, order id indexes) on huge pages, see
+  // containers/huge_page_allocator.hpp; std::allocator for ordinary pages.
+  template <typename T> using BigAllocator = huge_page_allocator<T>;
+
   using MyPriceLevel = intrusive_list<ClientRequest>;
   using PriceLevelHierarchyType = std::vector<MyPriceLevel>;
-  using EventQueue = LockFreeSPSCQueue<ClientRequest>;
-  using TradesQueue = LockFreeSPSCQueue<Trade>;
+  using EventQueue =
+      LockFreeSPSCQueue<ClientRequest, BigAllocator<ClientRequest>>;
   using ExecReportQueue = LockFreeSPSCQueue<ExecutionReport>;
+  using OutputRing = sequenced_ring<EngineOutput, BigAllocator<EngineOutput>>;
 
   /*  using EventQueue = threadsafe::stl_queue<ClientRequest>;
-   using TradesQueue = threadsafe::stl_queue<Trade>;
    using ExecReportQueue = threadsafe::stl_queue<ExecutionReport>;
    */
 
-  using ArenaIdxMap = flat_hashmap<OrderId, uint32_t>;
-  using ListIdxMap =
-      flat_hashmap<OrderId, std::tuple<Side, Price, MyPriceLevel::iterator>>;
+  using ArenaIdxMap = flat_hashmap<OrderId, uint32_t,
+                                   BigAllocator<Entry<OrderId, uint32_t>>>;
+  using ListIdxMap = flat_hashmap<
+      OrderId, std::tuple<Side, Price, MyPriceLevel::iterator>,
+      BigAllocator<
+          Entry<OrderId, std::tuple<Side, Price, MyPriceLevel::iterator>>>>;
 
-  using ArenaType = ArenaClass;
+  using ArenaType = basic_arena<BigAllocator<char>>;
   using RxBufferType = flat_buffer<uint8_t>;
   using TxBufferType = flat_buffer<uint8_t>;
   using ClientMap =
-      threadsafe::hashmap<ClientId,
-                          ClientConnection<RxBufferType, TxBufferType> *>;
+      threadsafe::slot_table<ClientId,
+                             ClientConnection<RxBufferType, TxBufferType> *>;
 };
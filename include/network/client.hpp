@@ -7,29 +7,49 @@
 #include "engine/concepts.hpp"
 #include "engine/constants.hpp"
 #include "engine/types.hpp"
+#include "network/protocol.hpp"
+#include "network/shm_transport.hpp"
 
 // TODO: eventually make a client config.
 template <TachyonConfig config> class Client {
 private:
   int sockfd;
+  shm::Region *shm_region = nullptr; // set when talking over shared memory.
+  shm::Slot *shm_slot = nullptr;
   ClientId my_id = std::numeric_limits<ClientId>::max();
+  uint64_t session_token = 0; // from SESSION_TOKEN, to resume with.
+  bool resuming = false;      // LOGIN_RESUME sent, no answer yet.
   OrderId local_order_id{};
 
   std::mt19937 generator;
   std::normal_distribution<double> distribution;
 
   static constexpr int MAX_TEMP_BUF_SIZE = 1024;
+  static constexpr size_t MAX_ORDER_BATCH = 100;  // orders encoded per pass.
+  static constexpr size_t MAX_REPORT_BATCH = 32; // reports decoded at once.
 
   config::RxBufferType rx_buffer; // Only accessed by one thread.
   config::TxBufferType tx_buffer;
   config::ExecReportQueue
       reports; // can be used by strategy thread for better strategies.
   size_t tx_offset{};
+  uint8_t tx_protocol = PROTOCOL_V1; // what we send in.
+  uint8_t rx_protocol = PROTOCOL_V1; // switches on the server's echo.
+  uint32_t tx_sequence = 0;          // next outbound v2 sequence number.
+  uint64_t next_report = 0; // session sequence of the next report, what we
+                            // would ask for when resuming.
   threadsafe::stl_queue<Order> orders_to_place; // generateOrders decides.
   threadsafe::stl_queue<OrderId> cancels_to_place;
   // Helper functions.
+  void connectTo(std::string host, std::string port);
   auto flushBuffer() -> bool;
+  void requestToken(); // so the session can be resumed.
+  void selectProtocol(uint8_t protocol);
+  void queueRequests(); // encode pending orders and cancels into tx_buffer.
+  void moveDataShm();
   void drainRx();
+  void drainFrames();
+  void queueFrames(); // v2: batch pending requests into frames.
   void updateEpoll(int epoll_fd, bool listen_for_write);
 
   auto generateOrderHelper() -> Order;
@@ -38,7 +58,16 @@ private:
 public:
   Client();
   ~Client();
-  void init(std::string host, std::string port);
+  // protocol selects the wire version, v1 unless the caller asks for v2.
+  void init(std::string host, std::string port,
+            uint8_t protocol = PROTOCOL_V1);
+  // Same, but through the gateway's shared memory file. Same host only.
+  void initShm(std::string path = shm::GATEWAY_PATH,
+               uint8_t protocol = PROTOCOL_V1);
+  // After moveData() returned on a disconnect: connect again and take the
+  // session back, replaying the reports missed. Call moveData() again
+  // after. If the session is gone, the server closes the connection.
+  void resume(std::string host, std::string port);
   void moveData();       // function which sends and recieves data.
   void generateOrders(); // generates requests using strategies.
   void writeReportsContinuous();
@@ -0,0 +1,238 @@
+#pragma once
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "engine/constants.hpp"
+#include "engine/types.hpp"
+#include "network/shm_transport.hpp"
+
+// Market data broadcast over shared memory.
+// The engine thread publishes every book and trade update once into a ring
+// in /dev/shm; any number of local processes map it read only and follow at
+// their own pace. Readers never write to the file, so the publisher's cost
+// doesn't depend on how many there are, and a stuck reader can't hold it up:
+// the ring just laps it.
+//
+// Each slot is a seqlock. Update n (counted from 1) is in slot n % RING_SLOTS,
+// whose version is 2n - 1 while it is being written and 2n once it is done.
+// A reader waiting for n that sees a higher version has been lapped. It then
+// reloads the book from the snapshot, which the publisher refreshes every
+// SNAPSHOT_INTERVAL updates, and carries on from there.
+//
+// Book updates are L2: the total quantity now resting at a price.
+
+namespace md {
+static constexpr const char *FEED_PATH = "/dev/shm/tachyon_market_data";
+static constexpr size_t RING_SLOTS = 1 << 16;
+static constexpr size_t SNAPSHOT_INTERVAL = 1024; // updates.
+static constexpr uint64_t MAGIC = 0x5441434859304D44; // "TACHY0MD"
+
+// Prices the book can hold, same range as OrderBook.
+static constexpr Price BASE_PRICE =
+    CLIENT_BASE_PRICE + CLIENT_PRICE_DISTRIB_MIN; // distrib min is -ve.
+static constexpr size_t LEVELS =
+    CLIENT_PRICE_DISTRIB_MAX - CLIENT_PRICE_DISTRIB_MIN + 1;
+
+enum class UpdateType : uint8_t {
+  LEVEL, // quantity resting at price on side is now `quantity`.
+  TRADE  // quantity traded at price, side is the aggressor's.
+};
+
+struct MarketUpdate {
+  uint64_t sequence; // from 1, no gaps.
+  TimeStamp time_stamp;
+  Price price;
+  uint64_t quantity;
+  UpdateType type;
+  Side side;
+};
+
+// One cache line per slot, so the writer touches one line per update.
+struct alignas(64) Slot {
+  std::atomic<uint64_t> version{0};
+  MarketUpdate update;
+};
+
+struct Snapshot {
+  std::atomic<uint64_t> version{0}; // odd while being written.
+  uint64_t sequence;                // last update it includes.
+  uint64_t bids[LEVELS];
+  uint64_t asks[LEVELS];
+};
+
+struct Feed {
+  uint64_t magic;
+  std::atomic<uint64_t> published{0}; // last sequence written.
+  Snapshot snapshot;
+  Slot slots[RING_SLOTS];
+};
+
+static_assert(sizeof(Slot) == 64);
+
+// Level quantities by price, bids and asks.
+struct Book {
+  std::vector<uint64_t> bids = std::vector<uint64_t>(LEVELS);
+  std::vector<uint64_t> asks = std::vector<uint64_t>(LEVELS);
+
+  static auto valid(Price price) -> bool {
+    return price >= BASE_PRICE && price - BASE_PRICE < LEVELS;
+  }
+  auto level(Side side, Price price) -> uint64_t & {
+    return (side == Side::BID ? bids : asks)[price - BASE_PRICE];
+  }
+};
+
+// Writer, engine thread only.
+class Publisher {
+private:
+  Feed *feed;
+  uint64_t next_sequence = 1;
+  Book book; // our own copy, the snapshot is written from it.
+
+  void publish(UpdateType type, Side side, Price price, uint64_t quantity,
+               TimeStamp now) {
+    uint64_t seq = next_sequence++;
+    Slot &slot = feed->slots[seq % RING_SLOTS];
+    slot.version.store(2 * seq - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.update = {seq, now, price, quantity, type, side};
+    slot.version.store(2 * seq, std::memory_order_release);
+    feed->published.store(seq, std::memory_order_release);
+    if (seq % SNAPSHOT_INTERVAL == 0) {
+      writeSnapshot();
+    }
+  }
+
+  void writeSnapshot() {
+    Snapshot &snap = feed->snapshot;
+    uint64_t version = snap.version.load(std::memory_order_relaxed);
+    snap.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    snap.sequence = next_sequence - 1;
+    std::memcpy(snap.bids, book.bids.data(), sizeof(snap.bids));
+    std::memcpy(snap.asks, book.asks.data(), sizeof(snap.asks));
+    snap.version.store(version + 2, std::memory_order_release);
+  }
+
+  void changeLevel(Side side, Price price, int64_t delta, TimeStamp now) {
+    if (!Book::valid(price)) {
+      return;
+    }
+    uint64_t &level = book.level(side, price);
+    level += delta;
+    publish(UpdateType::LEVEL, side, price, level, now);
+  }
+
+public:
+  // Starts a fresh feed at path, readers that had the old one must reopen.
+  explicit Publisher(const std::string &path = FEED_PATH)
+      : feed(new (shm::map_file(path, sizeof(Feed), true)) Feed) {
+    feed->magic = MAGIC;
+    writeSnapshot(); // the empty book, at sequence 0.
+  }
+  ~Publisher() { munmap(feed, sizeof(Feed)); }
+  Publisher(const Publisher &) = delete;
+  auto operator=(const Publisher &) -> Publisher & = delete;
+
+  // Resting quantity appeared (order added) or went away (cancelled).
+  void add(Side side, Price price, Quantity quantity, TimeStamp now) {
+    changeLevel(side, price, quantity, now);
+  }
+  void remove(Side side, Price price, Quantity quantity, TimeStamp now) {
+    changeLevel(side, price, -static_cast<int64_t>(quantity), now);
+  }
+  // The trade, then the maker's level it took quantity from.
+  void trade(const Trade &trade) {
+    publish(UpdateType::TRADE, trade.aggressor_side, trade.price,
+            trade.quantity, trade.time_stamp);
+    Side maker = trade.aggressor_side == Side::BID ? Side::ASK : Side::BID;
+    remove(maker, trade.price, trade.quantity, trade.time_stamp);
+  }
+
+  auto published() const -> uint64_t { return next_sequence - 1; }
+};
+
+// Any number of these, in any process. Keeps its own copy of the book.
+class Reader {
+private:
+  const Feed *feed;
+  uint64_t next_sequence = 0; // 0: load the snapshot first.
+  Book book_;
+  uint64_t recoveries_ = 0;
+
+  void loadSnapshot() {
+    const Snapshot &snap = feed->snapshot;
+    while (true) {
+      uint64_t before = snap.version.load(std::memory_order_acquire);
+      if ((before & 1) == 0) {
+        uint64_t sequence = snap.sequence;
+        std::memcpy(book_.bids.data(), snap.bids, sizeof(snap.bids));
+        std::memcpy(book_.asks.data(), snap.asks, sizeof(snap.asks));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (snap.version.load(std::memory_order_relaxed) == before) {
+          next_sequence = sequence + 1;
+          return;
+        }
+      }
+    }
+  }
+
+public:
+  enum class Poll : uint8_t {
+    NONE,     // nothing new.
+    UPDATE,   // update holds the next one, already applied to book().
+    RECOVERED // fell behind, book() was reloaded from the snapshot.
+  };
+
+  explicit Reader(const std::string &path = FEED_PATH)
+      : feed(static_cast<const Feed *>(
+            shm::map_file(path, sizeof(Feed), false, false))) {
+    if (feed->magic != MAGIC) {
+      munmap(const_cast<Feed *>(feed), sizeof(Feed));
+      throw std::runtime_error("Not a market data file " + path);
+    }
+  }
+  ~Reader() { munmap(const_cast<Feed *>(feed), sizeof(Feed)); }
+  Reader(const Reader &) = delete;
+  auto operator=(const Reader &) -> Reader & = delete;
+
+  auto poll(MarketUpdate &update) -> Poll {
+    if (next_sequence == 0) {
+      loadSnapshot();
+      return Poll::RECOVERED;
+    }
+    const Slot &slot = feed->slots[next_sequence % RING_SLOTS];
+    uint64_t version = slot.version.load(std::memory_order_acquire);
+    if (version < 2 * next_sequence) {
+      return Poll::NONE; // not written yet, or being written.
+    }
+    if (version == 2 * next_sequence) {
+      update = slot.update;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) == version) {
+        next_sequence++;
+        if (update.type == UpdateType::LEVEL && Book::valid(update.price)) {
+          book_.level(update.side, update.price) = update.quantity;
+        }
+        return Poll::UPDATE;
+      }
+    }
+    // Lapped, the update we wanted is gone.
+    recoveries_++;
+    loadSnapshot();
+    return Poll::RECOVERED;
+  }
+
+  auto book() -> Book & { return book_; }
+  auto next() const -> uint64_t { return next_sequence; }
+  auto recoveries() const -> uint64_t { return recoveries_; }
+};
+}; // namespace md
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Declarations shared by the codecs and the connection state. Safe to include
+// from anywhere, unlike serialise.hpp which defines the codec functions.
+
+enum class MessageType : uint8_t {
+  ORDER_NEW,
+  ORDER_CANCEL,
+  EXEC_REPORT,
+  TRADE,
+  LOGIN_RESPONSE,
+  PROTOCOL_SELECT, // client asks for a protocol version, server echoes it.
+  LOGIN_RESUME,    // client takes its old session back after a reconnect.
+  RESUME_RESPONSE, // server: where the replay of missed reports starts.
+  SESSION_TOKEN    // client asks for its session token, server answers.
+};
+
+// Execution reports are numbered per session, implicitly: the n-th report a
+// session is sent is number n, across reconnects. A client that wants to be
+// able to resume sends SESSION_TOKEN, zeroed, as its very first message and
+// is answered with its session's token before any report; LOGIN_RESPONSE
+// stays the bare id, so a client that never asks sees what it always did.
+// A client that reconnects sends LOGIN_RESUME with its old id, that token
+// and the number of the first report it has not seen, as its very first
+// message (so still in v1). The server answers with RESUME_RESPONSE and
+// replays from there; if the response's number is higher than asked for,
+// the reports in between are gone. A wrong token gets the connection
+// closed, so nobody can take over a session by guessing its id.
+
+// Protocol versions. Every connection starts out on v1; a client that wants
+// v2 sends PROTOCOL_SELECT and everything it sends after that is v2. The
+// server echoes PROTOCOL_SELECT (still in v1) right before its first v2 frame.
+static constexpr uint8_t PROTOCOL_V1 = 1;
+static constexpr uint8_t PROTOCOL_V2 = 2;
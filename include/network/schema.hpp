@@ -0,0 +1,236 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "network/protocol.hpp"
+
+// Compile time message schema.
+// A message is described once, as the list of its fields in wire order, and
+// everything else is generated from that: encode, decode, the wire size and
+// the length tables the receive loops use to frame the byte stream. Wire
+// offsets are the running sum of field sizes, so they can't drift from the
+// field list.
+//
+// Fields are (type, offset in the host struct). A field is byte swapped only
+// when the wire byte order differs from the host's. If the fields sit in the
+// host struct at exactly their wire offsets and need no swap, the whole body
+// is one memcpy.
+//
+//   using OrderBody = schema::Layout<Order, std::endian::big,
+//                                    SCHEMA_FIELD(Order, order_id), ...>;
+//   using OrderMessage = schema::Message<MessageType::ORDER_NEW, OrderBody>;
+
+namespace schema {
+// One contiguous byte move between host struct and wire, used by codecs
+// that work on raw bytes (see serialise_batch.hpp).
+struct FieldMove {
+  size_t from; // offset in the source.
+  size_t to;   // offset in the destination.
+  size_t size;
+  bool swap; // reverse the bytes (endianness).
+};
+
+template <typename T> constexpr auto byteswap(T value) -> T {
+  if constexpr (sizeof(T) == 1) {
+    return value;
+  } else if constexpr (std::is_enum_v<T>) {
+    return static_cast<T>(std::byteswap(std::to_underlying(value)));
+  } else {
+    return std::byteswap(value);
+  }
+}
+
+template <typename T, size_t Offset> struct Field {
+  static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                "fields are integers or enums");
+  using type = T;
+  static constexpr size_t host_offset = Offset;
+  static constexpr size_t size = sizeof(T);
+  static constexpr bool is_padding = false;
+
+  template <std::endian E>
+  static void encode(const uint8_t *host, uint8_t *wire) {
+    T value;
+    std::memcpy(&value, host + Offset, sizeof(T));
+    if constexpr (E != std::endian::native) {
+      value = byteswap(value);
+    }
+    std::memcpy(wire, &value, sizeof(T));
+  }
+  template <std::endian E>
+  static void decode(const uint8_t *wire, uint8_t *host) {
+    T value;
+    std::memcpy(&value, wire, sizeof(T));
+    if constexpr (E != std::endian::native) {
+      value = byteswap(value);
+    }
+    std::memcpy(host + Offset, &value, sizeof(T));
+  }
+};
+
+// N bytes on the wire with no host counterpart. Sent as zero, ignored on read.
+template <size_t N> struct Pad {
+  static constexpr size_t host_offset = 0;
+  static constexpr size_t size = N;
+  static constexpr bool is_padding = true;
+
+  template <std::endian E> static void encode(const uint8_t *, uint8_t *wire) {
+    std::memset(wire, 0, N);
+  }
+  template <std::endian E> static void decode(const uint8_t *, uint8_t *) {}
+};
+
+// Works on packed structs, where member pointers can't be bound.
+#define SCHEMA_FIELD(Struct, member)                                           \
+  schema::Field<decltype(Struct::member), offsetof(Struct, member)>
+
+// Wire body of a message: Fields back to back in order, in byte order E.
+template <typename Struct, std::endian E, typename... Fields> class Layout {
+private:
+  static constexpr size_t N = sizeof...(Fields);
+  static constexpr std::array<size_t, N> SIZES{Fields::size...};
+  static constexpr std::array<size_t, N> HOST_OFFSETS{Fields::host_offset...};
+  static constexpr std::array<bool, N> PADDING{Fields::is_padding...};
+
+  static constexpr auto make_wire_offsets() -> std::array<size_t, N> {
+    std::array<size_t, N> offsets{};
+    size_t at = 0;
+    for (size_t i = 0; i < N; i++) {
+      offsets[i] = at;
+      at += SIZES[i];
+    }
+    return offsets;
+  }
+
+  // Every byte of the struct sits at the same offset on the wire, in host
+  // order, and anything past the struct is padding.
+  static constexpr auto host_matches_wire() -> bool {
+    size_t covered = 0;
+    for (size_t i = 0; i < N; i++) {
+      if (PADDING[i]) {
+        if (WIRE_OFFSETS[i] < sizeof(Struct)) {
+          return false;
+        }
+        continue;
+      }
+      if (HOST_OFFSETS[i] != WIRE_OFFSETS[i] ||
+          (E != std::endian::native && SIZES[i] > 1)) {
+        return false;
+      }
+      covered += SIZES[i];
+    }
+    return covered == sizeof(Struct);
+  }
+
+  template <size_t... I>
+  static void encode_fields(const uint8_t *host, uint8_t *wire,
+                            std::index_sequence<I...>) {
+    (Fields::template encode<E>(host, wire + WIRE_OFFSETS[I]), ...);
+  }
+  template <size_t... I>
+  static void decode_fields(const uint8_t *wire, uint8_t *host,
+                            std::index_sequence<I...>) {
+    (Fields::template decode<E>(wire + WIRE_OFFSETS[I], host), ...);
+  }
+
+public:
+  using struct_type = Struct;
+  static constexpr std::array<size_t, N> WIRE_OFFSETS = make_wire_offsets();
+  static constexpr size_t size = (Fields::size + ... + 0);
+  static constexpr bool memcpy_path = host_matches_wire();
+  // Every field starts at a multiple of its own size.
+  static constexpr bool naturally_aligned = [] {
+    for (size_t i = 0; i < N; i++) {
+      if (!PADDING[i] && WIRE_OFFSETS[i] % SIZES[i] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }();
+
+  static void encode(const Struct &value, uint8_t *wire) {
+    const auto *host = reinterpret_cast<const uint8_t *>(&value);
+    if constexpr (memcpy_path) {
+      std::memcpy(wire, host, sizeof(Struct));
+      std::memset(wire + sizeof(Struct), 0, size - sizeof(Struct));
+    } else {
+      encode_fields(host, wire, std::index_sequence_for<Fields...>{});
+    }
+  }
+  static void decode(const uint8_t *wire, Struct &value) {
+    auto *host = reinterpret_cast<uint8_t *>(&value);
+    if constexpr (memcpy_path) {
+      std::memcpy(host, wire, sizeof(Struct));
+    } else {
+      decode_fields(wire, host, std::index_sequence_for<Fields...>{});
+    }
+  }
+
+  // Byte moves for host -> wire (encode) or wire -> host, with the wire side
+  // shifted by wire_base. Padding has no host side and is left out.
+  template <bool Encode>
+  static constexpr auto moves(size_t wire_base) -> std::array<FieldMove, N> {
+    std::array<FieldMove, N> out{};
+    for (size_t i = 0; i < N; i++) {
+      size_t host = HOST_OFFSETS[i];
+      size_t wire = wire_base + WIRE_OFFSETS[i];
+      bool swap = E != std::endian::native && SIZES[i] > 1;
+      out[i] = PADDING[i] ? FieldMove{0, 0, 0, false}
+               : Encode   ? FieldMove{host, wire, SIZES[i], swap}
+                          : FieldMove{wire, host, SIZES[i], swap};
+    }
+    return out;
+  }
+};
+
+// Body behind a one byte type tag, as in the v1 protocol.
+template <MessageType Type, typename Body> struct Message {
+  using body = Body;
+  using struct_type = typename Body::struct_type;
+  static constexpr MessageType type = Type;
+  static constexpr size_t wire_size = 1 + Body::size;
+
+  static auto encode(const struct_type &value, uint8_t *buffer) -> size_t {
+    buffer[0] = static_cast<uint8_t>(Type);
+    Body::encode(value, &buffer[1]);
+    return wire_size;
+  }
+  static void decode(const uint8_t *buffer, struct_type &value) {
+    assert(buffer[0] == static_cast<uint8_t>(Type));
+    Body::decode(&buffer[1], value);
+  }
+};
+
+// Body inside a v2 frame. The frame header carries the type, so no tag.
+template <MessageType Type, typename Body> struct Framed {
+  using body = Body;
+  using struct_type = typename Body::struct_type;
+  static constexpr MessageType type = Type;
+  static constexpr size_t wire_size = Body::size;
+
+  static auto encode(const struct_type &value, uint8_t *buffer) -> size_t {
+    Body::encode(value, buffer);
+    return wire_size;
+  }
+  static void decode(const uint8_t *buffer, struct_type &value) {
+    Body::decode(buffer, value);
+  }
+};
+
+// Indexed by type byte: how many bytes that message takes on the wire, 0 if
+// it isn't one of Messages (so the stream is corrupt).
+template <typename... Messages> constexpr auto length_table() {
+  std::array<uint16_t, 256> table{};
+  ((table[static_cast<uint8_t>(Messages::type)] =
+        static_cast<uint16_t>(Messages::wire_size)),
+   ...);
+  return table;
+}
+}; // namespace schema
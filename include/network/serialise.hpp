@@ -1,158 +1,208 @@
 #pragma once
 
-#include <endian.h>
-
+#include <bit>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 
 #include "engine/types.hpp"
+#include "network/protocol.hpp"
+#include "network/schema.hpp"
+
+// v1 protocol: a one byte type followed by the big endian body. Each message
+// is described once below; sizes, codecs and the receive loops' length tables
+// all come from those descriptions (see schema.hpp).
+
+using OrderMessage = schema::Message<
+    MessageType::ORDER_NEW,
+    schema::Layout<Order, std::endian::big, SCHEMA_FIELD(Order, order_id),
+                   SCHEMA_FIELD(Order, price), SCHEMA_FIELD(Order, quantity),
+                   SCHEMA_FIELD(Order, side), SCHEMA_FIELD(Order, order_type),
+                   SCHEMA_FIELD(Order, tif)>>;
+
+using CancelMessage = schema::Message<
+    MessageType::ORDER_CANCEL,
+    schema::Layout<OrderId, std::endian::big, schema::Field<OrderId, 0>>>;
+
+using ExecReportMessage = schema::Message<
+    MessageType::EXEC_REPORT,
+    schema::Layout<ExecutionReport, std::endian::big,
+                   SCHEMA_FIELD(ExecutionReport, client_id),
+                   SCHEMA_FIELD(ExecutionReport, order_id),
+                   SCHEMA_FIELD(ExecutionReport, price),
+                   SCHEMA_FIELD(ExecutionReport, last_quantity),
+                   SCHEMA_FIELD(ExecutionReport, remaining_quantity),
+                   SCHEMA_FIELD(ExecutionReport, type),
+                   SCHEMA_FIELD(ExecutionReport, reason),
+                   SCHEMA_FIELD(ExecutionReport, side)>>;
+
+using TradeMessage = schema::Message<
+    MessageType::TRADE,
+    schema::Layout<Trade, std::endian::big,
+                   SCHEMA_FIELD(Trade, maker_order_id),
+                   SCHEMA_FIELD(Trade, taker_order_id),
+                   SCHEMA_FIELD(Trade, time_stamp), SCHEMA_FIELD(Trade, price),
+                   SCHEMA_FIELD(Trade, quantity),
+                   SCHEMA_FIELD(Trade, aggressor_side)>>;
+
+using LoginMessage = schema::Message<
+    MessageType::LOGIN_RESPONSE,
+    schema::Layout<ClientId, std::endian::big, schema::Field<ClientId, 0>>>;
+
+using ProtocolSelectMessage = schema::Message<
+    MessageType::PROTOCOL_SELECT,
+    schema::Layout<uint8_t, std::endian::big, schema::Field<uint8_t, 0>>>;
+
+// Body of both LOGIN_RESUME and RESUME_RESPONSE.
+struct __attribute__((packed)) SessionResume {
+  ClientId client_id;
+  uint64_t token;         // from SESSION_TOKEN.
+  uint64_t next_sequence; // first report the client hasn't seen.
+};
 
-// Asserts  Only needed during testing just in case I change something and seg
-// fault occurs:
-
-static_assert(sizeof(OrderId) == 8);
-static_assert(sizeof(Price) == 8);
-static_assert(sizeof(Quantity) == 4);
-static_assert(sizeof(Side) == 1);
-static_assert(sizeof(OrderType) == 1);
-static_assert(sizeof(TimeInForce) == 1);
-static_assert(sizeof(ClientId) == 4);
-static_assert(sizeof(Order) == 23);
-static_assert(sizeof(ExecutionReport) == 31);
-
-enum class MessageType : uint8_t {
-  ORDER_NEW,
-  ORDER_CANCEL,
-  EXEC_REPORT,
-  TRADE,
-  LOGIN_RESPONSE
+using ResumeLayout =
+    schema::Layout<SessionResume, std::endian::big,
+                   SCHEMA_FIELD(SessionResume, client_id),
+                   SCHEMA_FIELD(SessionResume, token),
+                   SCHEMA_FIELD(SessionResume, next_sequence)>;
+using LoginResumeMessage =
+    schema::Message<MessageType::LOGIN_RESUME, ResumeLayout>;
+using ResumeResponseMessage =
+    schema::Message<MessageType::RESUME_RESPONSE, ResumeLayout>;
+
+// Body of SESSION_TOKEN: zeroed in the client's request, the session's id
+// and token in the server's answer.
+struct __attribute__((packed)) SessionToken {
+  ClientId client_id;
+  uint64_t token; // shown in LOGIN_RESUME.
 };
+
+using SessionTokenMessage = schema::Message<
+    MessageType::SESSION_TOKEN,
+    schema::Layout<SessionToken, std::endian::big,
+                   SCHEMA_FIELD(SessionToken, client_id),
+                   SCHEMA_FIELD(SessionToken, token)>>;
+
+// The wire format is a contract with clients, pin it.
+static_assert(OrderMessage::wire_size == 24);
+static_assert(CancelMessage::wire_size == 9);
+static_assert(ExecReportMessage::wire_size == 32);
+static_assert(TradeMessage::wire_size == 38);
+static_assert(LoginMessage::wire_size == 5);
+static_assert(ProtocolSelectMessage::wire_size == 2);
+static_assert(LoginResumeMessage::wire_size == 21);
+static_assert(SessionTokenMessage::wire_size == 13);
+
+// Size of each message on the wire, type byte included.
+static constexpr size_t LOGIN_RESPONSE_LEN = LoginMessage::wire_size;
+static constexpr size_t EXEC_REPORT_LEN = ExecReportMessage::wire_size;
+static constexpr size_t PROTOCOL_SELECT_LEN = ProtocolSelectMessage::wire_size;
+static constexpr size_t RESUME_LEN = LoginResumeMessage::wire_size;
+static constexpr size_t SESSION_TOKEN_LEN = SessionTokenMessage::wire_size;
+
+// What each end accepts, indexed by type byte; 0 means the stream is corrupt.
+static constexpr auto GATEWAY_INBOUND_LENGTHS =
+    schema::length_table<OrderMessage, CancelMessage, ProtocolSelectMessage,
+                         LoginResumeMessage, SessionTokenMessage>();
+static constexpr auto CLIENT_INBOUND_LENGTHS =
+    schema::length_table<LoginMessage, ExecReportMessage,
+                         ProtocolSelectMessage, ResumeResponseMessage,
+                         SessionTokenMessage>();
+
 // NOLINTBEGIN
 // Converts Order struct to 24 byte buffer.
 // Returns number of bytes written(ideally always 24)
-// Assuming client server same Endianness.
 auto serialise_order(const Order &order, uint8_t *buffer) -> size_t {
-  // Byte 0 : message type.
-  buffer[0] = static_cast<uint8_t>(MessageType::ORDER_NEW);
-
-  Order network_order;
-  network_order.order_id = htobe64(order.order_id);
-  network_order.price = htobe64(order.price);
-  network_order.quantity = htobe32(order.quantity);
-  network_order.side =
-      order.side; // Since this is a single byte no endiannes change needed.
-  network_order.order_type = order.order_type;
-  network_order.tif = order.tif;
-
-  std::memcpy(&buffer[1], &network_order, sizeof(Order));
-  // 1 byte for type, 4 bytes for client id, rest actual order.
-  return 1 + sizeof(Order);
-}
-
-void deserialise_order(const uint8_t *buffer,
-                       Order &order) { // maybe return client id?
-  // Sould we assert this? I think so.
-  assert(buffer[0] == static_cast<uint8_t>(MessageType::ORDER_NEW));
-  Order network_order{};
-  std::memcpy(&network_order, &buffer[1], sizeof(Order));
-  order.order_id = be64toh(network_order.order_id);
-  order.price = be64toh(network_order.price);
-  order.quantity = be32toh(network_order.quantity);
-  order.side = network_order.side;
-  order.order_type = network_order.order_type;
-  order.tif = network_order.tif;
+  return OrderMessage::encode(order, buffer);
+}
+
+// Decodes field by field from the wire bytes into order, which may be the
+// destination slot itself, so no intermediate copy of the message is made.
+void deserialise_order(const uint8_t *buffer, Order &order) {
+  OrderMessage::decode(buffer, order);
 }
 
 auto serialise_new_login(ClientId new_id, uint8_t *buffer) -> size_t {
-  buffer[0] = static_cast<uint8_t>(MessageType::LOGIN_RESPONSE);
-  new_id = htobe32(new_id);
-  std::memcpy(&buffer[1], &new_id, 4);
-  return 5;
+  return LoginMessage::encode(new_id, buffer);
 }
 
 auto deserialise_new_login(const uint8_t *buffer) -> ClientId {
-  assert(buffer[0] == static_cast<uint8_t>(MessageType::LOGIN_RESPONSE));
   ClientId new_id;
-  std::memcpy(&new_id, &buffer[1], 4);
-  new_id = be32toh(new_id);
+  LoginMessage::decode(buffer, new_id);
   return new_id;
 }
+
 auto serialise_execution_report(const ExecutionReport &report, uint8_t *buffer)
     -> size_t {
-  buffer[0] = static_cast<uint8_t>(MessageType::EXEC_REPORT);
-  ExecutionReport network_exec_report;
-  network_exec_report.order_id = htobe64(report.order_id);
-  network_exec_report.price = htobe64(report.price);
-  network_exec_report.client_id = htobe32(report.client_id);
-  network_exec_report.last_quantity = htobe32(report.last_quantity);
-  network_exec_report.remaining_quantity = htobe32(report.remaining_quantity);
-  network_exec_report.side = report.side;
-  network_exec_report.type = report.type;
-  network_exec_report.reason = report.reason;
-
-  std::memcpy(&buffer[1], &network_exec_report, sizeof(ExecutionReport));
-  return 1 + sizeof(ExecutionReport);
+  return ExecReportMessage::encode(report, buffer);
 }
 
 void deserialise_execution_report(const uint8_t *buffer,
                                   ExecutionReport &exec_report) {
-  assert(buffer[0] == static_cast<uint8_t>(MessageType::EXEC_REPORT));
-  ExecutionReport network_exec_report{};
-  std::memcpy(&network_exec_report, &buffer[1], sizeof(ExecutionReport));
-  exec_report.order_id = be64toh(network_exec_report.order_id);
-  exec_report.price = be64toh(network_exec_report.price);
-  exec_report.client_id = be32toh(network_exec_report.client_id);
-  exec_report.last_quantity = be32toh(network_exec_report.last_quantity);
-  exec_report.remaining_quantity =
-      be32toh(network_exec_report.remaining_quantity);
-  exec_report.side = network_exec_report.side;
-  exec_report.type = network_exec_report.type;
-  exec_report.reason = network_exec_report.reason;
+  ExecReportMessage::decode(buffer, exec_report);
 }
 
 auto serialise_trade(const Trade &trade, uint8_t *buffer) -> size_t {
-  buffer[0] = static_cast<uint8_t>(MessageType::TRADE);
-  Trade network_trade;
-  network_trade.price = htobe64(trade.price);
-  network_trade.quantity = htobe32(trade.quantity);
-  network_trade.time_stamp = htobe64(trade.time_stamp);
-  network_trade.maker_order_id = htobe64(trade.maker_order_id);
-  network_trade.taker_order_id = htobe64(trade.taker_order_id);
-  network_trade.aggressor_side = trade.aggressor_side;
-
-  std::memcpy(&buffer[1], &network_trade, sizeof(Trade));
-  return 1 + sizeof(Trade);
+  return TradeMessage::encode(trade, buffer);
 }
 
 void deserialise_trade(const uint8_t *buffer, Trade &trade) {
-  assert(buffer[0] == static_cast<uint8_t>(MessageType::TRADE));
-  Trade network_trade{};
-  std::memcpy(&network_trade, &buffer[1], sizeof(Trade));
-  trade.maker_order_id = be64toh(network_trade.maker_order_id);
-  trade.price = be64toh(network_trade.price);
-  trade.quantity = be32toh(network_trade.quantity);
-  trade.time_stamp = be64toh(network_trade.time_stamp);
-  trade.taker_order_id = be64toh(network_trade.taker_order_id);
-  trade.aggressor_side = network_trade.aggressor_side;
+  TradeMessage::decode(buffer, trade);
 }
 
 // NOTE: do we really need client id here? Maybe we can do without this.
 auto serialise_order_cancel(OrderId order_id, uint8_t *buffer) -> size_t {
-  buffer[0] = static_cast<uint8_t>(MessageType::ORDER_CANCEL);
-  order_id = htobe64(order_id);
-  std::memcpy(&buffer[1], &order_id, 8);
-
-  return 9;
+  return CancelMessage::encode(order_id, buffer);
 }
 
 auto deserialise_order_cancel(const uint8_t *buffer) -> OrderId {
-  assert(buffer[0] == static_cast<uint8_t>(MessageType::ORDER_CANCEL));
   OrderId order_id;
-
-  std::memcpy(&order_id, &buffer[1], 8);
-  order_id = be64toh(order_id);
+  CancelMessage::decode(buffer, order_id);
   return order_id;
 }
 
+auto serialise_protocol_select(uint8_t version, uint8_t *buffer) -> size_t {
+  return ProtocolSelectMessage::encode(version, buffer);
+}
+
+auto deserialise_protocol_select(const uint8_t *buffer) -> uint8_t {
+  uint8_t version;
+  ProtocolSelectMessage::decode(buffer, version);
+  return version;
+}
+
+auto serialise_login_resume(const SessionResume &resume, uint8_t *buffer)
+    -> size_t {
+  return LoginResumeMessage::encode(resume, buffer);
+}
+
+auto deserialise_login_resume(const uint8_t *buffer) -> SessionResume {
+  SessionResume resume;
+  LoginResumeMessage::decode(buffer, resume);
+  return resume;
+}
+
+auto serialise_resume_response(const SessionResume &resume, uint8_t *buffer)
+    -> size_t {
+  return ResumeResponseMessage::encode(resume, buffer);
+}
+
+auto deserialise_resume_response(const uint8_t *buffer) -> SessionResume {
+  SessionResume resume;
+  ResumeResponseMessage::decode(buffer, resume);
+  return resume;
+}
+
+auto serialise_session_token(const SessionToken &token, uint8_t *buffer)
+    -> size_t {
+  return SessionTokenMessage::encode(token, buffer);
+}
+
+auto deserialise_session_token(const uint8_t *buffer) -> SessionToken {
+  SessionToken token;
+  SessionTokenMessage::decode(buffer, token);
+  return token;
+}
+
 // NOLINTEND
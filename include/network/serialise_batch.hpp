@@ -0,0 +1,262 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "engine/types.hpp"
+#include "network/serialise.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Batch codec for the fixed size v1 messages.
+// Converting a message between its packed struct and its big endian wire form
+// is a pure byte permutation: swap within each integer field, shift by the
+// type byte. Every message and struct here is between 16 and 32 bytes, so it
+// is covered by two overlapping 16 byte windows. Each output window is
+//   pshufb(first input window, mask) | pshufb(last input window, mask)
+// (plus the type byte when encoding) with masks built at compile time from
+// the message schema. Nothing is read or written outside the message, so the
+// last message needs no special case.
+//
+// Path is picked at runtime from the CPU, scalar fallback elsewhere.
+
+enum class CodecPath : uint8_t {
+  SCALAR, // per message functions from serialise.hpp.
+  SSSE3,  // one message per pair of shuffles.
+  AVX2    // two messages per pair of shuffles.
+};
+
+namespace batch_detail {
+static constexpr size_t WINDOW = 16;
+static constexpr uint8_t ZERO = 0x80; // pshufb writes 0 for this index.
+
+using schema::FieldMove;
+
+struct ShuffleMasks {
+  alignas(WINDOW) uint8_t lo_first[WINDOW]; // first out window <- first in.
+  alignas(WINDOW) uint8_t lo_last[WINDOW];  // first out window <- last in.
+  alignas(WINDOW) uint8_t hi_first[WINDOW]; // last out window <- first in.
+  alignas(WINDOW) uint8_t hi_last[WINDOW];  // last out window <- last in.
+  alignas(WINDOW) uint8_t lo_fill[WINDOW];  // constant bytes, the type byte.
+};
+
+// out byte k takes source byte src[k]; bytes no field maps to are zero,
+// except out[0] which is set to lead (the message type when encoding).
+template <size_t IN, size_t OUT, size_t N>
+constexpr auto make_masks(const std::array<FieldMove, N> &fields,
+                          uint8_t lead = 0) -> ShuffleMasks {
+  static_assert(IN >= WINDOW && IN <= 2 * WINDOW);
+  static_assert(OUT >= WINDOW && OUT <= 2 * WINDOW);
+  int src[OUT];
+  for (size_t k = 0; k < OUT; k++) {
+    src[k] = -1;
+  }
+  for (const FieldMove &f : fields) {
+    for (size_t b = 0; b < f.size; b++) {
+      src[f.to + b] = static_cast<int>(f.swap ? f.from + f.size - 1 - b
+                                              : f.from + b);
+    }
+  }
+  ShuffleMasks masks{};
+  auto pick = [&](int s, uint8_t &first, uint8_t &last) {
+    first = ZERO;
+    last = ZERO;
+    if (s < 0) {
+      return;
+    }
+    if (static_cast<size_t>(s) < WINDOW) {
+      first = static_cast<uint8_t>(s);
+    } else {
+      last = static_cast<uint8_t>(s - (IN - WINDOW));
+    }
+  };
+  for (size_t k = 0; k < WINDOW; k++) {
+    pick(src[k], masks.lo_first[k], masks.lo_last[k]);
+    pick(src[OUT - WINDOW + k], masks.hi_first[k], masks.hi_last[k]);
+  }
+  if (src[0] < 0) {
+    masks.lo_fill[0] = lead;
+  }
+  return masks;
+}
+
+static constexpr size_t ORDER_LEN = OrderMessage::wire_size;
+
+// Wire offsets are shifted past the type byte.
+static constexpr ShuffleMasks ORDER_ENCODE =
+    make_masks<sizeof(Order), ORDER_LEN>(
+        OrderMessage::body::moves<true>(1),
+        static_cast<uint8_t>(MessageType::ORDER_NEW));
+static constexpr ShuffleMasks ORDER_DECODE =
+    make_masks<ORDER_LEN, sizeof(Order)>(OrderMessage::body::moves<false>(1));
+static constexpr ShuffleMasks REPORT_ENCODE =
+    make_masks<sizeof(ExecutionReport), EXEC_REPORT_LEN>(
+        ExecReportMessage::body::moves<true>(1),
+        static_cast<uint8_t>(MessageType::EXEC_REPORT));
+static constexpr ShuffleMasks REPORT_DECODE =
+    make_masks<EXEC_REPORT_LEN, sizeof(ExecutionReport)>(
+        ExecReportMessage::body::moves<false>(1));
+
+#if defined(__x86_64__)
+// NOLINTBEGIN
+__attribute__((target("ssse3"))) void
+shuffle_ssse3(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len,
+              size_t count, const ShuffleMasks &m) {
+  const __m128i lo_first = _mm_load_si128((const __m128i *)m.lo_first);
+  const __m128i lo_last = _mm_load_si128((const __m128i *)m.lo_last);
+  const __m128i hi_first = _mm_load_si128((const __m128i *)m.hi_first);
+  const __m128i hi_last = _mm_load_si128((const __m128i *)m.hi_last);
+  const __m128i lo_fill = _mm_load_si128((const __m128i *)m.lo_fill);
+  for (size_t i = 0; i < count; i++, in += in_len, out += out_len) {
+    __m128i first = _mm_loadu_si128((const __m128i *)in);
+    __m128i last = _mm_loadu_si128((const __m128i *)(in + in_len - WINDOW));
+    __m128i lo = _mm_or_si128(_mm_shuffle_epi8(first, lo_first),
+                              _mm_shuffle_epi8(last, lo_last));
+    lo = _mm_or_si128(lo, lo_fill);
+    __m128i hi = _mm_or_si128(_mm_shuffle_epi8(first, hi_first),
+                              _mm_shuffle_epi8(last, hi_last));
+    // Windows overlap in the middle and agree there.
+    _mm_storeu_si128((__m128i *)out, lo);
+    _mm_storeu_si128((__m128i *)(out + out_len - WINDOW), hi);
+  }
+}
+
+__attribute__((target("avx2"))) inline auto load_pair(const uint8_t *a,
+                                                      const uint8_t *b)
+    -> __m256i {
+  return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)a)),
+      _mm_loadu_si128((const __m128i *)b), 1);
+}
+
+// Same permutation, one message in each 128 bit lane.
+__attribute__((target("avx2"))) void
+shuffle_avx2(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len,
+             size_t count, const ShuffleMasks &m) {
+  const __m256i lo_first =
+      _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)m.lo_first));
+  const __m256i lo_last =
+      _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)m.lo_last));
+  const __m256i hi_first =
+      _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)m.hi_first));
+  const __m256i hi_last =
+      _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)m.hi_last));
+  const __m256i lo_fill =
+      _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)m.lo_fill));
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2, in += 2 * in_len, out += 2 * out_len) {
+    __m256i first = load_pair(in, in + in_len);
+    __m256i last = load_pair(in + in_len - WINDOW, in + 2 * in_len - WINDOW);
+    __m256i lo = _mm256_or_si256(_mm256_shuffle_epi8(first, lo_first),
+                                 _mm256_shuffle_epi8(last, lo_last));
+    lo = _mm256_or_si256(lo, lo_fill);
+    __m256i hi = _mm256_or_si256(_mm256_shuffle_epi8(first, hi_first),
+                                 _mm256_shuffle_epi8(last, hi_last));
+    _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(lo));
+    _mm_storeu_si128((__m128i *)(out + out_len - WINDOW),
+                     _mm256_castsi256_si128(hi));
+    _mm_storeu_si128((__m128i *)(out + out_len),
+                     _mm256_extracti128_si256(lo, 1));
+    _mm_storeu_si128((__m128i *)(out + 2 * out_len - WINDOW),
+                     _mm256_extracti128_si256(hi, 1));
+  }
+  if (i < count) {
+    shuffle_ssse3(in, in_len, out, out_len, 1, m);
+  }
+}
+// NOLINTEND
+#endif
+
+// Returns false if the path has no vector implementation on this build.
+auto shuffle(CodecPath path, const uint8_t *in, size_t in_len, uint8_t *out,
+             size_t out_len, size_t count, const ShuffleMasks &m) -> bool {
+#if defined(__x86_64__)
+  if (path == CodecPath::AVX2) {
+    shuffle_avx2(in, in_len, out, out_len, count, m);
+    return true;
+  }
+  if (path == CodecPath::SSSE3) {
+    shuffle_ssse3(in, in_len, out, out_len, count, m);
+    return true;
+  }
+#endif
+  (void)path, (void)in, (void)in_len, (void)out, (void)out_len, (void)count,
+      (void)m;
+  return false;
+}
+}; // namespace batch_detail
+
+// Best path this CPU supports, detected once.
+auto codec_path() -> CodecPath {
+  static const CodecPath path = [] {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return CodecPath::AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+      return CodecPath::SSSE3;
+    }
+#endif
+    return CodecPath::SCALAR;
+  }();
+  return path;
+}
+
+// Encodes count orders back to back into buffer as v1 ORDER_NEW messages.
+// Returns number of bytes written.
+auto serialise_orders(const Order *orders, size_t count, uint8_t *buffer,
+                      CodecPath path = codec_path()) -> size_t {
+  using namespace batch_detail;
+  if (!shuffle(path, reinterpret_cast<const uint8_t *>(orders),
+               sizeof(Order), buffer, ORDER_LEN, count, ORDER_ENCODE)) {
+    for (size_t i = 0; i < count; i++) {
+      serialise_order(orders[i], &buffer[i * ORDER_LEN]);
+    }
+  }
+  return count * ORDER_LEN;
+}
+
+// Decodes count back to back ORDER_NEW messages. The caller has checked the
+// type bytes.
+void deserialise_orders(const uint8_t *buffer, size_t count, Order *orders,
+                        CodecPath path = codec_path()) {
+  using namespace batch_detail;
+  if (!shuffle(path, buffer, ORDER_LEN, reinterpret_cast<uint8_t *>(orders),
+               sizeof(Order), count, ORDER_DECODE)) {
+    for (size_t i = 0; i < count; i++) {
+      deserialise_order(&buffer[i * ORDER_LEN], orders[i]);
+    }
+  }
+}
+
+auto serialise_execution_reports(const ExecutionReport *reports, size_t count,
+                                 uint8_t *buffer,
+                                 CodecPath path = codec_path()) -> size_t {
+  using namespace batch_detail;
+  if (!shuffle(path, reinterpret_cast<const uint8_t *>(reports),
+               sizeof(ExecutionReport), buffer, EXEC_REPORT_LEN, count,
+               REPORT_ENCODE)) {
+    for (size_t i = 0; i < count; i++) {
+      serialise_execution_report(reports[i], &buffer[i * EXEC_REPORT_LEN]);
+    }
+  }
+  return count * EXEC_REPORT_LEN;
+}
+
+void deserialise_execution_reports(const uint8_t *buffer, size_t count,
+                                   ExecutionReport *reports,
+                                   CodecPath path = codec_path()) {
+  using namespace batch_detail;
+  if (!shuffle(path, buffer, EXEC_REPORT_LEN,
+               reinterpret_cast<uint8_t *>(reports), sizeof(ExecutionReport),
+               count, REPORT_DECODE)) {
+    for (size_t i = 0; i < count; i++) {
+      deserialise_execution_report(&buffer[i * EXEC_REPORT_LEN], reports[i]);
+    }
+  }
+}
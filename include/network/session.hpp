@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "containers/circular_buffer.hpp"
+#include "engine/types.hpp"
+
+// Outbound side of a client session. It outlives the client's connections:
+// every report for the client is numbered here (0, 1, 2, ... in the order the
+// dispatcher writes them) and the last `depth` of them are kept, so a client
+// that reconnects can be sent exactly what it missed, without the engine.
+// Reports are kept decoded and encoded again on replay, since the client may
+// come back speaking another protocol version.
+// Not thread safe. The receive thread hands sessions out and expires them,
+// the reports in them belong to the dispatcher.
+class Session {
+private:
+  static constexpr size_t DEFAULT_DEPTH = 1024;
+
+  circular_buffer<ExecutionReport> sent; // oldest first.
+  uint64_t next_seq = 0;
+
+public:
+  // What the client has to show to resume it, set before it is published.
+  uint64_t token = 0;
+  // Receive thread only: when the client's last connection closed, 0 while
+  // it has one.
+  TimeStamp idle_since = 0;
+
+  // circular_buffer keeps one slot empty.
+  explicit Session(size_t depth = DEFAULT_DEPTH) : sent(depth + 1) {}
+
+  // Ready a pooled session for a new client, keeping its buffer.
+  void reset() {
+    sent.clear();
+    next_seq = 0;
+    token = 0;
+    idle_since = 0;
+  }
+
+  // Bytes a session of depth takes, its buffer included.
+  static constexpr auto bytes_for(size_t depth = DEFAULT_DEPTH) -> size_t {
+    return sizeof(Session) + (depth + 1) * sizeof(ExecutionReport);
+  }
+
+  // Numbers the report and keeps it, dropping the oldest if full.
+  auto record(const ExecutionReport &report) -> uint64_t {
+    sent.push(report);
+    return next_seq++;
+  }
+
+  // Sequence number the next recorded report gets.
+  auto next_sequence() const -> uint64_t { return next_seq; }
+  // Oldest report that can still be replayed.
+  auto oldest_sequence() const -> uint64_t { return next_seq - sent.size(); }
+
+  // Where a replay for a client that has seen everything before `from`
+  // starts. Later than `from` if the reports in between have been dropped.
+  auto resume_point(uint64_t from) const -> uint64_t {
+    return std::clamp(from, oldest_sequence(), next_seq);
+  }
+
+  // seq must be in [oldest_sequence(), next_sequence()).
+  auto at(uint64_t seq) const -> const ExecutionReport & {
+    return sent[seq - oldest_sequence()];
+  }
+};
@@ -0,0 +1,195 @@
+#pragma once
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "engine/types.hpp"
+
+// Shared memory transport for clients on the same host.
+// The gateway maps one file in /dev/shm holding a fixed number of session
+// slots. Each slot is a pair of SPSC byte rings, client -> gateway and
+// gateway -> client, carrying exactly the bytes a socket would: same
+// messages, same encoding, so both ends reuse their TCP parsing and framing.
+// Nothing blocks, both ends poll.
+//
+// Slot life cycle, state written by the side named:
+//   FREE -(client)-> REQUESTED -(gateway)-> ACTIVE
+//   ACTIVE -(gateway, hanging up)-> CLOSING
+//   REQUESTED, ACTIVE or CLOSING -(client, done with the rings)-> CLOSED
+//   CLOSED -(gateway, once the dispatcher is done with it)-> FREE
+// Only the client can say it has stopped touching the rings, so a slot the
+// gateway hung up on stays CLOSING until it does. The gateway empties the
+// rings before a slot goes back to FREE, so a client may write its first
+// messages right after claiming one. A client that dies without saying so
+// is noticed through its pid, and its slot is freed as if it were CLOSED.
+
+namespace shm {
+static constexpr const char *GATEWAY_PATH = "/dev/shm/tachyon_gateway";
+static constexpr size_t MAX_SESSIONS = 16;
+static constexpr size_t RING_BYTES = 256 * 1024;
+static constexpr uint64_t MAGIC = 0x5441434859304E32; // "TACHY0N2"
+
+// Single producer, single consumer byte stream. head and tail only grow, so
+// tail - head is the fill level and no slot is wasted.
+template <size_t Capacity> struct ByteRing {
+  static_assert((Capacity & (Capacity - 1)) == 0, "power of two");
+  static constexpr size_t CACHE_LINE = 64;
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> head{0}; // consumer's.
+  alignas(CACHE_LINE) std::atomic<uint64_t> tail{0}; // producer's.
+  alignas(CACHE_LINE) uint8_t data[Capacity];
+
+  // Only while neither end is using the ring.
+  void reset() {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+  }
+
+  auto size() const -> size_t {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_relaxed);
+  }
+
+  // Producer only. Copies as much of src as fits, returns bytes written.
+  auto write(const uint8_t *src, size_t len) -> size_t {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t h = head.load(std::memory_order_acquire);
+    size_t n = std::min<size_t>(len, Capacity - (t - h));
+    size_t at = t & (Capacity - 1);
+    size_t first = std::min(n, Capacity - at);
+    std::memcpy(&data[at], src, first);
+    std::memcpy(data, src + first, n - first);
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer only. Copies up to max bytes out, returns bytes read.
+  auto read(uint8_t *dst, size_t max) -> size_t {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+    size_t n = std::min<size_t>(max, t - h);
+    size_t at = h & (Capacity - 1);
+    size_t first = std::min(n, Capacity - at);
+    std::memcpy(dst, &data[at], first);
+    std::memcpy(dst + first, data, n - first);
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+};
+
+enum class SlotState : uint32_t { FREE, REQUESTED, ACTIVE, CLOSING, CLOSED };
+
+struct Slot {
+  alignas(64) std::atomic<SlotState> state{SlotState::FREE};
+  std::atomic<pid_t> client_pid{0}; // set by the client after claiming.
+  ClientId client_id{};             // set by the gateway before ACTIVE.
+  ByteRing<RING_BYTES> inbound;  // client -> gateway.
+  ByteRing<RING_BYTES> outbound; // gateway -> client.
+};
+
+struct Region {
+  uint64_t magic;
+  Slot slots[MAX_SESSIONS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<SlotState>::is_always_lock_free,
+              "atomics in shared memory must be address free");
+
+// Maps size bytes of path, creating (and zeroing) the file if asked to.
+inline auto map_file(const std::string &path, size_t size, bool create,
+                     bool writable = true) -> void * {
+  int flags = create ? O_RDWR | O_CREAT | O_TRUNC
+                     : (writable ? O_RDWR : O_RDONLY);
+  int fd = open(path.c_str(), flags, 0600);
+  if (fd == -1) {
+    throw std::runtime_error("Error opening shared memory file " + path);
+  }
+  if (create && ftruncate(fd, static_cast<off_t>(size)) == -1) {
+    close(fd);
+    throw std::runtime_error("Error sizing shared memory file " + path);
+  }
+  struct stat info;
+  if (!create &&
+      (fstat(fd, &info) == -1 || static_cast<size_t>(info.st_size) < size)) {
+    close(fd); // touching a short mapping past its end is a SIGBUS.
+    throw std::runtime_error("Shared memory file too small " + path);
+  }
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *addr = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file alive.
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("Error mapping shared memory file " + path);
+  }
+  return addr;
+}
+
+// Gateway side. Starts from a clean file, any old sessions are gone.
+inline auto create_region(const std::string &path) -> Region * {
+  // Default init: the file is already zero, the rings' bytes aren't touched.
+  auto *region = new (map_file(path, sizeof(Region), true)) Region;
+  region->magic = MAGIC;
+  return region;
+}
+
+// Client side.
+inline auto open_region(const std::string &path) -> Region * {
+  auto *region = static_cast<Region *>(map_file(path, sizeof(Region), false));
+  if (region->magic != MAGIC) {
+    munmap(region, sizeof(Region));
+    throw std::runtime_error("Not a gateway shared memory file " + path);
+  }
+  return region;
+}
+
+inline void close_region(Region *region) { munmap(region, sizeof(Region)); }
+
+// Gateway side. False only once we know the client process is gone.
+inline auto client_alive(const Slot &slot) -> bool {
+  pid_t pid = slot.client_pid.load(std::memory_order_relaxed);
+  return pid == 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+// Gateway side, once neither end can touch the slot's rings any more.
+inline void free_slot(Slot &slot) {
+  slot.inbound.reset();
+  slot.outbound.reset();
+  slot.client_pid.store(0, std::memory_order_relaxed);
+  slot.state.store(SlotState::FREE, std::memory_order_release);
+}
+
+// Client side. Returns nullptr if every slot is taken.
+inline auto claim_slot(Region *region) -> Slot * {
+  for (Slot &slot : region->slots) {
+    SlotState expected = SlotState::FREE;
+    if (slot.state.compare_exchange_strong(expected, SlotState::REQUESTED,
+                                           std::memory_order_acq_rel)) {
+      slot.client_pid.store(getpid(), std::memory_order_relaxed);
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Client side, once it will touch the slot's rings no more. Call it once:
+// after it the gateway may hand the slot to somebody else.
+inline void release_slot(Slot *slot) {
+  SlotState state = slot->state.load(std::memory_order_acquire);
+  while (state != SlotState::CLOSED && state != SlotState::FREE &&
+         !slot->state.compare_exchange_weak(state, SlotState::CLOSED,
+                                            std::memory_order_acq_rel)) {
+  }
+}
+}; // namespace shm
@@ -1,54 +1,231 @@
 #pragma once
 #include "engine/concepts.hpp"
-#include <containers/flat_hashmap.hpp>
+#include <atomic>
+#include <containers/epoch.hpp>
 #include <containers/lock_queue.hpp>
+#include <containers/lockfree_queue.hpp>
+#include <containers/memory_usage.hpp>
+#include <containers/object_pool.hpp>
+#include <containers/slot_table.hpp>
 #include <cstddef>
 #include <cstdint>
+#include <engine/settings.hpp>
 #include <engine/types.hpp>
+#include <network/protocol.hpp>
+#include <network/session.hpp>
+#include <network/shm_transport.hpp>
 #include <string>
+#include <vector>
 
 // If we directly force the concept, this results in a circular error.
 template <RxTxBuffer RxBuffer, RxTxBuffer TxBuffer> struct ClientConnection {
   int fd;
   ClientId client_id{};
+  shm::Slot *shm_slot = nullptr; // shared memory session instead of fd.
 
   RxBuffer rx_buffer;
   TxBuffer tx_buffer;
   size_t tx_offset = 0; // how much of tx buffer is already sent?
-  ClientConnection(int file_descriptor)
+
+  // Set by the receive thread when it retires the connection.
+  std::atomic<bool> closed{false};
+  // Version the client asked for. Written by the receive thread, the
+  // dispatcher switches the outbound stream over when it sees a change.
+  std::atomic<uint8_t> protocol{PROTOCOL_V1};
+
+  // Receive thread only state.
+  uint8_t rx_protocol = PROTOCOL_V1; // how to parse what is in rx_buffer.
+  uint32_t rx_sequence = 0;          // next inbound v2 sequence number.
+  bool fresh = true; // nothing received yet, a resume is still allowed.
+
+  // Set by the receive thread (release) once resume_sequence and the
+  // resumed id are written, cleared by the dispatcher after the replay.
+  std::atomic<bool> resume_pending{false}; // replay owed before any report.
+  uint64_t resume_sequence = 0; // first report the client hasn't seen.
+  // Set by the receive thread when the client asks for its session token,
+  // cleared by the dispatcher once it has written it.
+  std::atomic<bool> token_owed{false};
+
+  // Dispatcher only state, never touched by the receive thread.
+  bool dirty = false;            // queued on the dispatcher's dirty list.
+  bool write_blocked = false;    // socket full, waiting for EPOLLOUT.
+  bool write_registered = false; // fd is in the dispatcher's epoll set.
+  uint8_t tx_protocol = PROTOCOL_V1; // what tx_buffer is being written in.
+  ClientConnection(int file_descriptor = -1)
       : fd(file_descriptor), rx_buffer(1024), tx_buffer(1024) {}
+
+  // Ready a pooled connection for a new client, keeping its buffers.
+  void reset(int file_descriptor) {
+    fd = file_descriptor;
+    client_id = {};
+    shm_slot = nullptr;
+    rx_buffer.clear();
+    tx_buffer.clear();
+    tx_offset = 0;
+    closed.store(false, std::memory_order_relaxed);
+    protocol.store(PROTOCOL_V1, std::memory_order_relaxed);
+    rx_protocol = PROTOCOL_V1;
+    rx_sequence = 0;
+    fresh = true;
+    resume_pending.store(false, std::memory_order_relaxed);
+    resume_sequence = 0;
+    token_owed.store(false, std::memory_order_relaxed);
+    dirty = false;
+    write_blocked = false;
+    write_registered = false;
+    tx_protocol = PROTOCOL_V1;
+  }
 };
 
 template <TachyonConfig config> class TcpServer {
 private:
+  using Connection = ClientConnection<typename config::RxBufferType,
+                                      typename config::TxBufferType>;
+
   int listen_fd{}; // File descriptor for listening to sockets connections.
   std::atomic<ClientId> next_id; //  the client Id we need to assign
                                  //  to the incoming new client.
   config::EventQueue &event_queue;
-  config::ExecReportQueue &execution_reports;
+  using consumer_id = typename config::OutputRing::consumer_id;
+  config::OutputRing &engine_output; // the dispatcher reads reports from it.
+  consumer_id dispatch_consumer;
 
   static constexpr int BACKLOG = 20;
   static constexpr int MAX_EPOLL_EVENTS = 10;
-  static constexpr int MAX_TEMP_BUFF_SIZE = 4096;
+  static constexpr int RECLAIM_INTERVAL_MS = 1;
+  static constexpr int SESSION_SWEEP_MS = 100; // while sessions are idle.
+  static constexpr size_t DISPATCHER_EPOCH = 0; // participant slot.
+  static constexpr size_t MAX_DISPATCH_BATCH = 100; // reports per flush.
+  static constexpr size_t MAX_DIRTY_CONNECTIONS = 1024; // initial reserve.
+  static constexpr int MAX_RECV_SIZE = 4096; // bytes asked of each recv.
+  static constexpr size_t KICK_QUEUE_SIZE = 1024;
+  static constexpr size_t RETIRE_QUEUE_SIZE = 1024;
+  // With shared memory sessions open the receive loop spins on them and
+  // only looks at the sockets every this many passes.
+  static constexpr unsigned SOCKET_POLL_INTERVAL = 64;
+  static constexpr int SHM_IDLE_POLL_MS = 1; // looking for new sessions.
+  static constexpr unsigned SHM_LIVENESS_INTERVAL = 1U << 16; // passes.
   static void setNonBlocking(int file_descriptor);
 
   void handleNewConnection(struct epoll_event evt, int epoll_fd);
-  void handleNewOrder(uint8_t *buffer, ClientId cid);
-  void handleCancellation(uint8_t *buffer, ClientId cid);
+  void admitConnection(Connection *conn); // assign id, login, publish.
+  void pollShm(int epoll_fd, bool check_liveness);
+  void openShmSession(size_t slot);
+  void retireConnection(Connection *conn, int epoll_fd);
+  void reclaimConnections(); // receive thread.
+  auto forgetRetired() -> bool; // dispatcher, true if it did anything.
+  auto claimRequest() -> ClientRequest *; // next free engine queue slot.
+  auto drainRx(Connection *conn) -> bool; // false if the client sent garbage.
+  auto drainFrames(Connection *conn) -> bool; // v2 part of drainRx.
+  void handleNewOrder(const uint8_t *buffer, ClientId cid, uint8_t protocol);
+  void handleCancellation(const uint8_t *buffer, ClientId cid,
+                          uint8_t protocol);
+  auto handleResume(Connection *conn, const uint8_t *buffer) -> bool;
+  void writeReports(Connection *conn, const ExecutionReport *reports,
+                    size_t count, uint64_t sequence); // all for conn, the
+                                                      // first is `sequence`.
 
   config::ClientMap client_map; // for dispatcher.
 
-  auto flushBuffer(ClientConnection<typename config::RxBufferType,
-                                    typename config::TxBufferType> *conn)
-      -> bool; // return true if buff empty, all
-               // sent. False if socket is full.
+  // Connections are recycled, never freed. A closed one is retired: the
+  // receive thread unlinks it and hands it to the dispatcher on
+  // retire_queue, the dispatcher forgets it (drops it from blocked_list and
+  // its write epoll set) and hands it back on released_queue. Only then is
+  // its fd let go and the connection pooled, so the dispatcher never holds
+  // a connection that went to another client. A shared memory slot also
+  // waits for the client to release it, see shm_transport.hpp.
+  object_pool<Connection> connection_pool; // receive thread.
+  size_t pooled_connections = 0; // counted into SESSION_MEMORY_BYTES.
+  size_t buffer_bytes;           // what connections' buffers start at.
+  LockFreeSPSCQueue<Connection *> retire_queue{RETIRE_QUEUE_SIZE};
+  LockFreeSPSCQueue<Connection *> released_queue{RETIRE_QUEUE_SIZE};
+  std::vector<Connection *> retired; // receive thread, not handed over yet.
+  size_t retiring = 0;               // handed over, not back yet.
+  std::vector<Connection *> released; // dispatcher, not handed back yet.
+
+  // Shared memory sessions, receive thread only.
+  shm::Region *shm_region = nullptr;
+  Connection *shm_sessions[shm::MAX_SESSIONS] = {}; // by slot.
+  size_t active_shm = 0;
+  bool shm_retiring[shm::MAX_SESSIONS] = {}; // retired, not freed yet.
+  // Let go by the dispatcher, freed once the client is done with them too.
+  std::vector<size_t> closing_slots;
+
+  // Dispatcher state. Only connections with pending tx data are visited, so
+  // the dispatcher cost scales with active sessions, not with ids issued.
+  int write_epoll_fd = -1; // EPOLLOUT notifications for blocked sockets.
+  std::vector<Connection *> dirty_list;
+  std::vector<Connection *> blocked_list; // waiting for EPOLLOUT.
+
+  // Sessions by client id, opened with the client's first connection and
+  // kept past its last one for session_grace_ms, so it can reconnect and
+  // resume. The replay itself is written by the dispatcher. Expired
+  // sessions go back to the pool once the dispatcher has left the epoch
+  // they were unlinked in; it only holds one for the length of a pass.
+  // Pool, counts and lists belong to the receive thread.
+  threadsafe::slot_table<ClientId, Session *> sessions; // for dispatcher.
+  object_pool<Session> session_pool;
+  size_t pooled_sessions = 0; // counted into SESSION_MEMORY_BYTES.
+  size_t live_sessions = 0;   // in the table.
+  size_t max_sessions;
+  uint64_t grace_ns;
+  std::vector<std::pair<ClientId, TimeStamp>> idle; // oldest first.
+  threadsafe::epoch_manager epochs{1}; // the dispatcher is the only reader.
+  std::vector<std::pair<Session *, uint64_t>> expired;
+  // Ids whose connection has something for the dispatcher that no report
+  // would make it notice: a replay owed after a resume, a session token
+  // asked for, or the part of the login response the socket didn't take.
+  // Receive thread to dispatcher.
+  LockFreeSPSCQueue<ClientId> kick_queue{KICK_QUEUE_SIZE};
+  void kick(ClientId cid); // receive thread.
+
+  auto acquireSession() -> Session *; // receive thread, from here down.
+  static auto newToken() -> uint64_t;
+  void dropSession(ClientId cid);
+  void expireSessions(); // past their grace, and reclaim what's safe.
+  void resumeSession(Connection *conn, ClientId cid, Session *session);
+  // Dispatcher: whatever the receive thread left owed to conn, found under
+  // cid, ahead of any report. True if that was a replay, which covers
+  // everything the session has recorded.
+  auto writeOwed(Connection *conn, ClientId cid, Session *session) -> bool;
+
+  auto acquireConnection() -> Connection *; // receive thread.
+  void reserveBuffers(Connection *conn);
+  // prepare() on a connection buffer, counting what it grew by.
+  template <typename Buffer>
+  static auto prepareCounted(Buffer &buffer, size_t size) -> uint8_t *;
+
+  auto flushBuffer(Connection *conn) -> bool; // return true if buff empty, all
+                                              // sent. False if socket is full.
+  void markDirty(Connection *conn);
+  void flushDirty();
+  auto waitWritable(Connection *conn) -> bool; // false if it can't be armed.
+  void retryBlocked();
 public:
-  TcpServer(config::EventQueue &event_queue,
-            config::ExecReportQueue &execution_reports);
+  // The connection table and the first settings.connections connections,
+  // with their buffers, are allocated here.
+  TcpServer(config::EventQueue &event_queue, config::OutputRing &engine_output,
+            consumer_id dispatch_consumer,
+            const settings::Settings &settings = {});
+  // What the constructor allocates for settings.
+  static auto footprint(const settings::Settings &settings) -> size_t;
 
   void init(std::string port);
+  // Also accept co-located clients over shared memory at path.
+  void initShm(std::string path);
   // NOTE: we use separate file_descriptors and epolls for reading and writing,
   // and assume that the client also has separate read write threads.
   void receiveData();
   void dispatchData();
+
+  // The connection and session tables, sized at construction. Connections,
+  // sessions and their buffers come on top of them as clients arrive, see
+  // SESSION_MEMORY_BYTES.
+  auto tableMemory() const -> MemoryUsage {
+    MemoryUsage usage = sessions.memory();
+    if constexpr (requires { client_map.memory(); }) {
+      usage += client_map.memory();
+    }
+    return usage;
+  }
 };
@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Counts heap allocations, to prove the hot paths make none once started
+// and to keep it that way. Built with -DTACHYON_TRACK_ALLOCS (cmake
+// -DTACHYON_TRACK_ALLOCS=ON) src/alloc_tracker.cpp replaces the global
+// operator new and delete, and every call is counted against the calling
+// thread and the exchange's current phase. Direct malloc calls, from C
+// libraries say, aren't seen.
+//
+// A NoAllocation scope put around code that mustn't allocate (the engine's
+// batch loop, a benchmark's timed loop) aborts with where and how many
+// times, if anything under it did.
+//
+// Without TACHYON_TRACK_ALLOCS nothing is counted, the scopes are empty and
+// every count reads 0.
+
+namespace alloc {
+static constexpr const char *REPORT_PATH = "logs/allocations.txt";
+static constexpr size_t MAX_THREADS = 32; // the last slot is shared.
+static constexpr size_t NAME_BYTES = 16;
+
+#ifdef TACHYON_TRACK_ALLOCS
+static constexpr bool TRACKING = true;
+#else
+static constexpr bool TRACKING = false;
+#endif
+
+enum class Phase : uint8_t { STARTUP, STEADY, SHUTDOWN, COUNT };
+
+static constexpr size_t PHASES = static_cast<size_t>(Phase::COUNT);
+
+static constexpr std::array<const char *, PHASES> PHASE_NAMES = {
+    "startup", "steady", "shutdown"};
+
+struct Counts {
+  uint64_t allocations = 0;
+  uint64_t frees = 0;
+  uint64_t bytes = 0; // asked for by the allocations.
+};
+
+// One per thread. Atomic adds, since threads past MAX_THREADS share the
+// last one; uncontended they cost little next to the malloc they count.
+struct alignas(64) ThreadCounts {
+  std::atomic<uint64_t> allocations[PHASES]{};
+  std::atomic<uint64_t> frees[PHASES]{};
+  std::atomic<uint64_t> bytes[PHASES]{};
+  char name[NAME_BYTES]{};
+};
+
+inline ThreadCounts thread_counts[MAX_THREADS];
+inline std::atomic<size_t> threads_claimed{0};
+inline std::atomic<Phase> current_phase{Phase::STARTUP};
+
+// Claiming a slot mustn't allocate, it happens inside operator new.
+inline auto local() -> ThreadCounts & {
+  thread_local ThreadCounts *mine = nullptr;
+  if (mine == nullptr) {
+    size_t idx = threads_claimed.fetch_add(1, std::memory_order_relaxed);
+    mine = &thread_counts[idx < MAX_THREADS ? idx : MAX_THREADS - 1];
+  }
+  return *mine;
+}
+
+inline auto phase() -> Phase {
+  return current_phase.load(std::memory_order_relaxed);
+}
+inline void set_phase(Phase p) {
+  current_phase.store(p, std::memory_order_relaxed);
+}
+
+// Called by the operator new and delete replacements.
+inline void on_alloc(size_t bytes) {
+  auto p = static_cast<size_t>(phase());
+  ThreadCounts &counts = local();
+  counts.allocations[p].fetch_add(1, std::memory_order_relaxed);
+  counts.bytes[p].fetch_add(bytes, std::memory_order_relaxed);
+}
+inline void on_free() {
+  local().frees[static_cast<size_t>(phase())].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+inline void name_thread(const char *name) {
+  if constexpr (TRACKING) {
+    std::strncpy(local().name, name, NAME_BYTES - 1);
+  }
+}
+
+inline auto read(const ThreadCounts &counts, Phase p) -> Counts {
+  auto i = static_cast<size_t>(p);
+  return {counts.allocations[i].load(std::memory_order_relaxed),
+          counts.frees[i].load(std::memory_order_relaxed),
+          counts.bytes[i].load(std::memory_order_relaxed)};
+}
+
+// The calling thread's allocations so far, all phases.
+inline auto this_thread() -> uint64_t {
+  if constexpr (!TRACKING) {
+    return 0;
+  }
+  const ThreadCounts &counts = local();
+  uint64_t n = 0;
+  for (size_t p = 0; p < PHASES; p++) {
+    n += counts.allocations[p].load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+// Every thread's, in one phase.
+inline auto total(Phase p) -> Counts {
+  Counts sum;
+  size_t threads = std::min(threads_claimed.load(), MAX_THREADS);
+  for (size_t t = 0; t < threads; t++) {
+    Counts counts = read(thread_counts[t], p);
+    sum.allocations += counts.allocations;
+    sum.frees += counts.frees;
+    sum.bytes += counts.bytes;
+  }
+  return sum;
+}
+
+// A line per thread and phase that saw any, "engine steady allocations=0
+// frees=0 bytes=0". Unnamed threads are "thread-<slot>".
+inline auto format() -> std::string {
+  std::string out;
+  size_t threads = std::min(threads_claimed.load(), MAX_THREADS);
+  for (size_t t = 0; t < threads; t++) {
+    std::string name = thread_counts[t].name[0] != '\0'
+                           ? thread_counts[t].name
+                           : "thread-" + std::to_string(t);
+    for (size_t p = 0; p < PHASES; p++) {
+      Counts counts = read(thread_counts[t], static_cast<Phase>(p));
+      if (counts.allocations == 0 && counts.frees == 0) {
+        continue;
+      }
+      out += name + " " + PHASE_NAMES[p] +
+             " allocations=" + std::to_string(counts.allocations) +
+             " frees=" + std::to_string(counts.frees) +
+             " bytes=" + std::to_string(counts.bytes) + "\n";
+    }
+  }
+  return out;
+}
+
+inline auto report(const std::string &path = REPORT_PATH) -> bool {
+  if constexpr (!TRACKING) {
+    return false;
+  }
+  FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  std::string text = format();
+  std::fwrite(text.data(), 1, text.size(), file);
+  return std::fclose(file) == 0;
+}
+
+class NoAllocation {
+private:
+  const char *where;
+  uint64_t before;
+
+public:
+  explicit NoAllocation(const char *what) : where(what), before(this_thread()) {}
+  ~NoAllocation() {
+    if constexpr (TRACKING) {
+      uint64_t made = this_thread() - before;
+      if (made != 0) {
+        std::fprintf(stderr, "%s: %llu heap allocations in a no allocation "
+                             "scope\n",
+                     where, static_cast<unsigned long long>(made));
+        std::abort();
+      }
+    }
+  }
+  NoAllocation(const NoAllocation &) = delete;
+  auto operator=(const NoAllocation &) -> NoAllocation & = delete;
+};
+}; // namespace alloc
@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TACHYON_HAVE_TSC 1
+#endif
+
+// Cheap nanosecond time stamps, for the hot paths.
+// steady_clock::now() goes through the vDSO and, depending on the clock
+// source (and in most VMs), costs tens of nanoseconds or a real syscall.
+// Reading the CPU's time stamp counter is one instruction; it is turned into
+// nanoseconds with a multiply and a shift, at a rate measured once against
+// steady_clock. Values are on steady_clock's epoch, so the two can be mixed.
+// If the counter doesn't tick at a constant rate (or this isn't x86-64)
+// steady_clock is used instead.
+//
+// Measuring the rate takes CALIBRATION_MS, call calibrate() at start up so
+// the first now() on a hot path doesn't.
+
+namespace tsc {
+static constexpr uint64_t CALIBRATION_MS = 10;
+
+inline auto steady_ns() -> uint64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Calibration {
+  bool usable = false; // invariant counter, rate measured.
+  uint64_t base_ticks = 0;
+  uint64_t base_ns = 0;
+  uint64_t ns_per_tick = 0; // 32.32 fixed point.
+};
+
+inline auto measure() -> Calibration {
+  Calibration cal;
+#ifdef TACHYON_HAVE_TSC
+  unsigned eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0 ||
+      (edx & (1u << 8)) == 0) {
+    return cal; // no invariant TSC, it may stop or change rate.
+  }
+  uint64_t ns0 = steady_ns();
+  uint64_t ticks0 = __rdtsc();
+  uint64_t ns1;
+  while ((ns1 = steady_ns()) - ns0 < CALIBRATION_MS * 1000000) {
+  }
+  uint64_t ticks1 = __rdtsc();
+  if (ticks1 <= ticks0) {
+    return cal;
+  }
+  cal.ns_per_tick = ((ns1 - ns0) << 32) / (ticks1 - ticks0);
+  cal.base_ticks = ticks0;
+  cal.base_ns = ns0;
+  cal.usable = true;
+#endif
+  return cal;
+}
+
+inline auto calibration() -> const Calibration & {
+  static const Calibration cal = measure();
+  return cal;
+}
+
+inline void calibrate() { calibration(); }
+
+inline auto now() -> uint64_t {
+#ifdef TACHYON_HAVE_TSC
+  const Calibration &cal = calibration();
+  if (cal.usable) {
+    __extension__ unsigned __int128 elapsed = __rdtsc() - cal.base_ticks;
+    return cal.base_ns +
+           static_cast<uint64_t>((elapsed * cal.ns_per_tick) >> 32);
+  }
+#endif
+  return steady_ns();
+}
+}; // namespace tsc
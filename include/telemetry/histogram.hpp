@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of latencies in nanoseconds, HDR style.
+// Values below 2^SUB_BITS get a bucket each; above that every power of two
+// is split into 2^SUB_BITS equal buckets, so any value is known to within
+// 1 / 2^SUB_BITS (~3%) however large it is. Values from 2^MAX_BITS up
+// (about a minute) all land in the last bucket. Counts are atomics so the
+// exporter can read a histogram while its owner records into it; with one
+// writer a record is a relaxed load and store, no read-modify-write.
+// Histograms merge by adding their buckets.
+
+namespace metrics {
+class Histogram {
+public:
+  static constexpr unsigned SUB_BITS = 5;
+  static constexpr unsigned MAX_BITS = 36;
+  static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+  static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+  static constexpr uint64_t MAX_VALUE = (uint64_t(1) << MAX_BITS) - 1;
+
+  static auto bucket(uint64_t value) -> size_t {
+    value = std::min(value, MAX_VALUE);
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    unsigned exponent = std::bit_width(value) - 1; // >= SUB_BITS.
+    unsigned shift = exponent - SUB_BITS;
+    return ((shift + 1) << SUB_BITS) + (value >> shift) - SUB_BUCKETS;
+  }
+
+  // Largest value that lands in bucket b.
+  static auto highest(size_t b) -> uint64_t {
+    if (b < SUB_BUCKETS) {
+      return b;
+    }
+    unsigned shift = (b >> SUB_BITS) - 1;
+    uint64_t mantissa = (b & (SUB_BUCKETS - 1)) + SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+private:
+  std::atomic<uint64_t> counts[BUCKETS]{};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> largest{0};
+
+  static void bump(std::atomic<uint64_t> &slot, uint64_t n) {
+    slot.store(slot.load(std::memory_order_relaxed) + n,
+               std::memory_order_relaxed);
+  }
+
+public:
+  Histogram() = default;
+  Histogram(const Histogram &) = delete;
+  auto operator=(const Histogram &) -> Histogram & = delete;
+
+  // Single writer only. n samples of value.
+  void record(uint64_t value, uint64_t n = 1) {
+    bump(counts[bucket(value)], n);
+    bump(total, n);
+    if (value > largest.load(std::memory_order_relaxed)) {
+      largest.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Any number of writers.
+  void record_shared(uint64_t value, uint64_t n = 1) {
+    counts[bucket(value)].fetch_add(n, std::memory_order_relaxed);
+    total.fetch_add(n, std::memory_order_relaxed);
+    uint64_t seen = largest.load(std::memory_order_relaxed);
+    while (value > seen &&
+           !largest.compare_exchange_weak(seen, value,
+                                          std::memory_order_relaxed)) {
+    }
+  }
+
+  // Not thread safe for this one, other may be being recorded into.
+  void merge(const Histogram &other) {
+    for (size_t b = 0; b < BUCKETS; b++) {
+      bump(counts[b], other.counts[b].load(std::memory_order_relaxed));
+    }
+    bump(total, other.total.load(std::memory_order_relaxed));
+    largest.store(std::max(largest.load(std::memory_order_relaxed),
+                           other.largest.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+  }
+
+  auto count() const -> uint64_t {
+    return total.load(std::memory_order_relaxed);
+  }
+  auto max() const -> uint64_t {
+    return largest.load(std::memory_order_relaxed);
+  }
+
+  // Smallest bucket bound at or below which a fraction q of the samples
+  // are, never above max(). 0 when empty.
+  auto percentile(double q) const -> uint64_t {
+    uint64_t n = count();
+    if (n == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(n)));
+    rank = std::clamp<uint64_t>(rank, 1, n);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; b++) {
+      seen += counts[b].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(highest(b), max());
+      }
+    }
+    return max(); // counts still being written past total.
+  }
+};
+}; // namespace metrics
@@ -0,0 +1,395 @@
+#pragma once
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/histogram.hpp"
+
+// Process wide counters and gauges.
+// Every thread that records something gets its own cache line padded block
+// and is the only writer of it, so an update is a relaxed load and store to
+// a line nobody else writes: no lock, no read-modify-write, no sharing. A
+// background Exporter sums the blocks every interval and publishes the
+// totals to a file and to a UNIX socket (connect, read, done).
+//
+// Counters only grow. A gauge holds the latest value set by the one thread
+// that owns it; gauges that are cheaper to read from outside (queue depths)
+// can instead be sampled by the exporter through a callback.
+//
+// Latencies go into a histogram per pipeline stage, also one per thread and
+// merged by the exporter. A request's stages, from the stamps taken on it:
+//   received (gateway decoded it) -> engine dequeue -> engine done with it
+//   -> dispatcher dequeue -> its reports written to the socket.
+
+namespace metrics {
+static constexpr const char *FILE_PATH = "logs/metrics.txt";
+static constexpr const char *SOCKET_PATH = "/tmp/tachyon_metrics.sock";
+static constexpr int EXPORT_INTERVAL_MS = 1000;
+static constexpr size_t MAX_THREADS = 32;
+
+enum class Counter : uint8_t {
+  ORDERS_NEW,      // new order requests processed.
+  CANCELS,         // cancel requests processed.
+  FILLS,
+  REJECTS,         // any rejected request.
+  BYTES_IN,        // from clients, sockets and shared memory.
+  BYTES_OUT,
+  SESSIONS_OPENED,
+  SESSIONS_CLOSED,
+  SESSIONS_EXPIRED, // dropped after their grace period, see settings.hpp.
+  SESSIONS_REFUSED, // new clients turned away at max_sessions.
+  // Connection and session objects and their buffers. They're pooled and
+  // kept, so this only grows; counted by whichever thread grew a buffer.
+  SESSION_MEMORY_BYTES,
+  // Engine hardware counters, summed over the batches it sampled. Same
+  // order as perf::Event.
+  ENGINE_SAMPLED_EVENTS,
+  ENGINE_CYCLES,
+  ENGINE_INSTRUCTIONS,
+  ENGINE_L1D_MISSES,
+  ENGINE_LLC_MISSES,
+  ENGINE_BRANCH_MISSES,
+  ENGINE_DTLB_MISSES,
+  ENGINE_PAGE_FAULTS,
+  ENGINE_CONTEXT_SWITCHES,
+  COUNT
+};
+
+enum class Gauge : uint8_t {
+  EVENT_QUEUE_DEPTH, // requests waiting for the engine.
+  OUTPUT_BACKLOG,    // engine output not yet read by every stage.
+  BOOK_ORDERS,       // resting orders.
+  // Memory, in bytes allocated unless said otherwise, for capacity planning.
+  EVENT_QUEUE_BYTES,
+  OUTPUT_RING_BYTES,
+  BOOK_BYTES,            // arena, order id indexes and price levels.
+  BOOK_ARENA_SLOTS,      // slots ever used, the arena's high water mark.
+  BOOK_INDEX_TOMBSTONES, // erased entries still taking index slots.
+  COUNT
+};
+
+enum class Stage : uint8_t {
+  GATEWAY,    // received -> engine dequeue, time in the event queue.
+  ENGINE,     // engine batch time / events in it, a per event average.
+  HANDOFF,    // engine publish -> dispatcher dequeue, time in the output ring.
+  WRITE,      // dispatcher dequeue -> written.
+  END_TO_END, // received -> written.
+  COUNT
+};
+
+static constexpr size_t COUNTERS = static_cast<size_t>(Counter::COUNT);
+static constexpr size_t GAUGES = static_cast<size_t>(Gauge::COUNT);
+static constexpr size_t STAGES = static_cast<size_t>(Stage::COUNT);
+
+static constexpr std::array<const char *, COUNTERS> COUNTER_NAMES = {
+    "orders_new",     "cancels",   "fills",           "rejects",
+    "bytes_in",       "bytes_out", "sessions_opened", "sessions_closed",
+    "sessions_expired",            "sessions_refused",
+    "session_memory_bytes",
+    "engine_sampled_events",       "engine_cycles",
+    "engine_instructions",         "engine_l1d_misses",
+    "engine_llc_misses",           "engine_branch_misses",
+    "engine_dtlb_misses",          "engine_page_faults",
+    "engine_context_switches"};
+static constexpr std::array<const char *, GAUGES> GAUGE_NAMES = {
+    "event_queue_depth", "output_backlog",    "book_orders",
+    "event_queue_bytes", "output_ring_bytes", "book_bytes",
+    "book_arena_slots",  "book_index_tombstones"};
+static constexpr std::array<const char *, STAGES> STAGE_NAMES = {
+    "gateway", "engine", "handoff", "write", "end_to_end"};
+
+struct alignas(64) ThreadBlock {
+  std::atomic<uint64_t> counters[COUNTERS]{};
+  std::atomic<uint64_t> gauges[GAUGES]{};
+  std::atomic<bool> gauge_set[GAUGES]{};
+  Histogram latencies[STAGES];
+  bool shared = false; // the overflow block, several writers.
+};
+
+// A stage's histogram boiled down, nanoseconds.
+struct Latency {
+  uint64_t count = 0;
+  uint64_t p50 = 0;
+  uint64_t p99 = 0;
+  uint64_t p999 = 0;
+  uint64_t max = 0;
+};
+
+struct Snapshot {
+  uint64_t counters[COUNTERS]{};
+  uint64_t gauges[GAUGES]{};
+  Latency latencies[STAGES];
+
+  auto counter(Counter c) const -> uint64_t {
+    return counters[static_cast<size_t>(c)];
+  }
+  auto gauge(Gauge g) const -> uint64_t {
+    return gauges[static_cast<size_t>(g)];
+  }
+  auto latency(Stage s) const -> const Latency & {
+    return latencies[static_cast<size_t>(s)];
+  }
+
+  // One "name value" line per metric.
+  auto format() const -> std::string {
+    std::string out;
+    for (size_t i = 0; i < COUNTERS; i++) {
+      out += std::string(COUNTER_NAMES[i]) + " " +
+             std::to_string(counters[i]) + "\n";
+    }
+    for (size_t i = 0; i < GAUGES; i++) {
+      out +=
+          std::string(GAUGE_NAMES[i]) + " " + std::to_string(gauges[i]) + "\n";
+    }
+    out += "sessions_active " +
+           std::to_string(counter(Counter::SESSIONS_OPENED) -
+                          counter(Counter::SESSIONS_CLOSED)) +
+           "\n";
+    for (size_t i = 0; i < STAGES; i++) {
+      std::string name = std::string("latency_") + STAGE_NAMES[i];
+      const Latency &l = latencies[i];
+      out += name + "_count " + std::to_string(l.count) + "\n";
+      out += name + "_p50_ns " + std::to_string(l.p50) + "\n";
+      out += name + "_p99_ns " + std::to_string(l.p99) + "\n";
+      out += name + "_p99_9_ns " + std::to_string(l.p999) + "\n";
+      out += name + "_max_ns " + std::to_string(l.max) + "\n";
+    }
+    return out;
+  }
+};
+
+class Registry {
+private:
+  static inline std::atomic<uint64_t> generations{0};
+
+  const uint64_t generation = generations.fetch_add(1) + 1; // never 0.
+  ThreadBlock blocks[MAX_THREADS + 1]; // the last one is shared overflow.
+  std::atomic<size_t> claimed{0};
+  std::function<uint64_t()> samplers[GAUGES];
+
+public:
+  Registry() { blocks[MAX_THREADS].shared = true; }
+  Registry(const Registry &) = delete;
+  auto operator=(const Registry &) -> Registry & = delete;
+
+  // The calling thread's block, handed out on first use.
+  auto local() -> ThreadBlock & {
+    thread_local ThreadBlock *mine = nullptr;
+    thread_local uint64_t owner = 0; // generation mine belongs to.
+    if (owner != generation) {
+      size_t idx = claimed.fetch_add(1, std::memory_order_relaxed);
+      mine = &blocks[idx < MAX_THREADS ? idx : MAX_THREADS];
+      owner = generation;
+    }
+    return *mine;
+  }
+
+  void add(Counter c, uint64_t n = 1) {
+    ThreadBlock &block = local();
+    std::atomic<uint64_t> &slot = block.counters[static_cast<size_t>(c)];
+    if (block.shared) {
+      slot.fetch_add(n, std::memory_order_relaxed);
+    } else {
+      slot.store(slot.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+    }
+  }
+
+  void set(Gauge g, uint64_t value) {
+    ThreadBlock &block = local();
+    block.gauges[static_cast<size_t>(g)].store(value,
+                                               std::memory_order_relaxed);
+    block.gauge_set[static_cast<size_t>(g)].store(true,
+                                                  std::memory_order_relaxed);
+  }
+
+  // A request spent ns in stage s.
+  void record(Stage s, uint64_t ns) {
+    ThreadBlock &block = local();
+    Histogram &histogram = block.latencies[static_cast<size_t>(s)];
+    if (block.shared) {
+      histogram.record_shared(ns);
+    } else {
+      histogram.record(ns);
+    }
+  }
+
+  // Setup only, before the exporter starts. Called from the exporter thread.
+  void sample(Gauge g, std::function<uint64_t()> read) {
+    samplers[static_cast<size_t>(g)] = std::move(read);
+  }
+
+  auto snapshot() const -> Snapshot {
+    Snapshot snap;
+    for (const ThreadBlock &block : blocks) {
+      for (size_t i = 0; i < COUNTERS; i++) {
+        snap.counters[i] += block.counters[i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < GAUGES; i++) {
+        if (block.gauge_set[i].load(std::memory_order_relaxed)) {
+          snap.gauges[i] = block.gauges[i].load(std::memory_order_relaxed);
+        }
+      }
+    }
+    for (size_t i = 0; i < GAUGES; i++) {
+      if (samplers[i]) {
+        snap.gauges[i] = samplers[i]();
+      }
+    }
+    for (size_t i = 0; i < STAGES; i++) {
+      snap.latencies[i] = latency(static_cast<Stage>(i));
+    }
+    return snap;
+  }
+
+  // Every thread's histogram for stage s, merged.
+  void merged(Stage s, Histogram &into) const {
+    size_t used = std::min(claimed.load(std::memory_order_relaxed), MAX_THREADS);
+    for (size_t b = 0; b < used; b++) {
+      into.merge(blocks[b].latencies[static_cast<size_t>(s)]);
+    }
+    into.merge(blocks[MAX_THREADS].latencies[static_cast<size_t>(s)]);
+  }
+
+  auto latency(Stage s) const -> Latency {
+    Histogram all;
+    merged(s, all);
+    return {all.count(), all.percentile(0.5), all.percentile(0.99),
+            all.percentile(0.999), all.max()};
+  }
+};
+
+// The process's registry.
+inline auto registry() -> Registry & {
+  static Registry instance;
+  return instance;
+}
+
+inline void add(Counter c, uint64_t n = 1) { registry().add(c, n); }
+inline void set(Gauge g, uint64_t value) { registry().set(g, value); }
+inline void record(Stage s, uint64_t ns) { registry().record(s, ns); }
+
+// Publishes the registry every interval until stopped. The file is replaced
+// whole each time; the socket answers every connection with the latest
+// snapshot and closes it.
+class Exporter {
+private:
+  Registry &source;
+  std::string file_path;
+  std::string socket_path;
+  int interval_ms;
+  int listen_fd = -1;
+  std::atomic<bool> running{false};
+  std::thread worker;
+
+  void writeFile(const std::string &text) {
+    std::string tmp = file_path + ".tmp";
+    FILE *file = std::fopen(tmp.c_str(), "w");
+    if (file == nullptr) {
+      return; // no logs directory, the socket still works.
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+    std::rename(tmp.c_str(), file_path.c_str()); // readers see whole files.
+  }
+
+  void serve(const std::string &text) {
+    int client = accept(listen_fd, nullptr, nullptr);
+    if (client == -1) {
+      return;
+    }
+    size_t sent = 0;
+    while (sent < text.size()) {
+      ssize_t n =
+          send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      sent += static_cast<size_t>(n);
+    }
+    close(client);
+  }
+
+  void run() {
+    alloc::name_thread("metrics");
+    using clock = std::chrono::steady_clock;
+    auto next_export = clock::now();
+    std::string text;
+    while (running.load(std::memory_order_relaxed)) {
+      auto now = clock::now();
+      if (now >= next_export) {
+        text = source.snapshot().format();
+        writeFile(text);
+        next_export = now + std::chrono::milliseconds(interval_ms);
+      }
+      int wait = static_cast<int>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(next_export -
+                                                                now)
+              .count());
+      pollfd pfd{listen_fd, POLLIN, 0};
+      if (poll(&pfd, 1, std::max(wait, 1)) > 0) {
+        serve(source.snapshot().format()); // fresh, it was asked for.
+      }
+    }
+    writeFile(source.snapshot().format()); // final totals.
+  }
+
+public:
+  explicit Exporter(Registry &reg = registry(),
+                    std::string file = FILE_PATH,
+                    std::string socket = SOCKET_PATH,
+                    int interval = EXPORT_INTERVAL_MS)
+      : source(reg), file_path(std::move(file)),
+        socket_path(std::move(socket)), interval_ms(interval) {}
+  ~Exporter() { stop(); }
+  Exporter(const Exporter &) = delete;
+  auto operator=(const Exporter &) -> Exporter & = delete;
+
+  void start() {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+      throw std::runtime_error("Metrics socket path too long " + socket_path);
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1) {
+      throw std::runtime_error("Error creating metrics socket");
+    }
+    unlink(socket_path.c_str()); // left over from an earlier run.
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+            -1 ||
+        listen(listen_fd, 4) == -1) {
+      close(listen_fd);
+      listen_fd = -1;
+      throw std::runtime_error("Error binding metrics socket " + socket_path);
+    }
+    running.store(true);
+    worker = std::thread(&Exporter::run, this);
+  }
+
+  void stop() {
+    if (!running.exchange(false)) {
+      return;
+    }
+    worker.join();
+    close(listen_fd);
+    unlink(socket_path.c_str());
+  }
+};
+}; // namespace metrics
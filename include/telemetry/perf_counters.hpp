@@ -0,0 +1,164 @@
+#pragma once
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// Hardware performance counters of the calling thread, via perf_event_open.
+// Tells whether time went to cache misses, branch misses or TLB misses
+// rather than just how much there was. Only user space is counted, which
+// perf_event_paranoid <= 2 allows without privileges.
+//
+// Each event is opened on its own; those the machine or kernel doesn't
+// offer (VMs often have no PMU at all, containers may block the syscall)
+// are left out and read as not valid. When more events are open than the
+// PMU has registers the kernel time-slices them, and read() scales the
+// counts up by enabled / running time.
+//
+// A read is a syscall per event, microseconds in all: fine around a
+// benchmark run or an occasional engine batch, not per order.
+
+namespace perf {
+enum class Event : uint8_t {
+  CYCLES,
+  INSTRUCTIONS,
+  L1D_MISSES,     // L1 data cache read misses.
+  LLC_MISSES,     // last level cache misses.
+  BRANCH_MISSES,
+  DTLB_MISSES,    // data TLB read misses.
+  PAGE_FAULTS,    // software event, there even without a PMU.
+  CONTEXT_SWITCHES, // software event.
+  COUNT
+};
+
+static constexpr size_t EVENTS = static_cast<size_t>(Event::COUNT);
+
+static constexpr std::array<const char *, EVENTS> EVENT_NAMES = {
+    "cycles",        "instructions", "l1d_misses",  "llc_misses",
+    "branch_misses", "dtlb_misses",  "page_faults", "context_switches"};
+
+struct Sample {
+  uint64_t values[EVENTS]{};
+  bool valid[EVENTS]{};
+
+  auto operator[](Event e) const -> uint64_t {
+    return values[static_cast<size_t>(e)];
+  }
+  auto has(Event e) const -> bool { return valid[static_cast<size_t>(e)]; }
+
+  // Counts between an earlier sample and this one.
+  auto since(const Sample &earlier) const -> Sample {
+    Sample diff;
+    for (size_t i = 0; i < EVENTS; i++) {
+      diff.valid[i] = valid[i] && earlier.valid[i];
+      diff.values[i] = diff.valid[i] ? values[i] - earlier.values[i] : 0;
+    }
+    return diff;
+  }
+};
+
+class Counters {
+private:
+  int fds[EVENTS];
+
+  static constexpr auto cache_miss(uint64_t cache) -> uint64_t {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+
+  static auto open_event(uint32_t type, uint64_t config) -> int {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // This thread, any CPU, no group.
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+public:
+  // Opens every event it can for the calling thread, stopped.
+  Counters() {
+    static constexpr std::array<std::pair<uint32_t, uint64_t>, EVENTS> kinds =
+        {{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+          {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+          {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+          {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+          {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}}};
+    for (size_t i = 0; i < EVENTS; i++) {
+      fds[i] = open_event(kinds[i].first, kinds[i].second);
+    }
+  }
+  ~Counters() {
+    for (int fd : fds) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+  Counters(const Counters &) = delete;
+  auto operator=(const Counters &) -> Counters & = delete;
+
+  auto has(Event e) const -> bool { return fds[static_cast<size_t>(e)] != -1; }
+  // Whether any hardware event could be opened.
+  auto hardware() const -> bool {
+    for (size_t i = 0; i < static_cast<size_t>(Event::PAGE_FAULTS); i++) {
+      if (fds[i] != -1) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Zeroes the counts and starts counting.
+  void start() {
+    for (int fd : fds) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+  void stop() {
+    for (int fd : fds) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+  }
+
+  // Counts since start(), running or not.
+  auto read() const -> Sample {
+    Sample sample;
+    for (size_t i = 0; i < EVENTS; i++) {
+      uint64_t data[3]; // value, time enabled, time running.
+      if (fds[i] == -1 ||
+          ::read(fds[i], data, sizeof(data)) != sizeof(data)) {
+        continue;
+      }
+      sample.valid[i] = true;
+      if (data[2] != 0 && data[2] < data[1]) { // time-sliced.
+        data[0] = static_cast<uint64_t>(static_cast<double>(data[0]) *
+                                        static_cast<double>(data[1]) /
+                                        static_cast<double>(data[2]));
+      }
+      sample.values[i] = data[0];
+    }
+    return sample;
+  }
+};
+}; // namespace perf
@@ -0,0 +1,298 @@
+#pragma once
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "telemetry/clock.hpp"
+
+// Hot path trace points, for chasing latency spikes one order at a time.
+// Built with -DTACHYON_TRACE (cmake -DTACHYON_TRACE=ON) the TRACE_* macros
+// write a fixed size record (time, point, id, thread) into the calling
+// thread's own ring: no lock, no allocation after the thread's first record,
+// one writer per ring. The rings are flight recorders, the oldest records
+// are overwritten, and are dumped to a binary file when the exchange stops.
+// trace_dump turns that file into Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev), where the records sharing an id, an order's path through
+// gateway, engine, book and dispatcher, are joined by flow arrows.
+//
+// Without TACHYON_TRACE the macros expand to nothing and their arguments are
+// not evaluated.
+
+namespace trace {
+static constexpr const char *FILE_PATH = "logs/trace.bin";
+static constexpr size_t RING_RECORDS = 1 << 16; // per thread, power of two.
+static constexpr size_t MAX_THREADS = 32;
+static constexpr size_t NAME_BYTES = 16;
+static constexpr uint64_t MAGIC = 0x5441434859305452; // "TACHY0TR"
+
+enum class Point : uint16_t {
+  GATEWAY_RECV,    // span, a read from one connection. id: bytes.
+  GATEWAY_NEW,     // a new order decoded. id: order.
+  GATEWAY_CANCEL,  // a cancel decoded. id: order to cancel.
+  ENGINE_BATCH,    // span, id: events in it.
+  ENGINE_EVENT,    // span, id: order.
+  BOOK_MATCH,      // span, id: incoming order.
+  BOOK_FILL,       // id: resting order filled.
+  BOOK_ADD,        // id: order now resting.
+  BOOK_CANCEL,     // id: order removed.
+  DISPATCH_REPORT, // a report picked up. id: order.
+  DISPATCH_FLUSH,  // span, writing out the batch. id: connections.
+  COUNT
+};
+
+static constexpr std::array<const char *, static_cast<size_t>(Point::COUNT)>
+    POINT_NAMES = {"gateway_recv",   "gateway_new",     "gateway_cancel",
+                   "engine_batch",   "engine_event",    "book_match",
+                   "book_fill",      "book_add",        "book_cancel",
+                   "dispatch_report", "dispatch_flush"};
+
+enum class Phase : uint8_t { INSTANT, BEGIN, END };
+
+struct Record {
+  uint64_t time; // tsc::now(), nanoseconds.
+  uint64_t id;
+  uint32_t thread;
+  Point point;
+  Phase phase;
+};
+static_assert(sizeof(Record) == 24);
+
+struct Ring {
+  std::atomic<uint64_t> written{0}; // records ever written.
+  uint32_t thread = 0;
+  char name[NAME_BYTES]{};
+  Record records[RING_RECORDS];
+};
+
+// Every ring handed out so far, they live as long as the process.
+struct Rings {
+  std::unique_ptr<Ring> rings[MAX_THREADS];
+  std::atomic<size_t> claimed{0};
+};
+
+inline auto rings() -> Rings & {
+  static Rings instance;
+  return instance;
+}
+
+// The calling thread's ring, nullptr once MAX_THREADS threads have one.
+inline auto local() -> Ring * {
+  thread_local Ring *mine = [] () -> Ring * {
+    Rings &all = rings();
+    size_t idx = all.claimed.load(std::memory_order_relaxed);
+    do {
+      if (idx >= MAX_THREADS) {
+        return nullptr;
+      }
+    } while (!all.claimed.compare_exchange_weak(idx, idx + 1,
+                                                std::memory_order_acq_rel));
+    auto ring = std::make_unique<Ring>();
+    ring->thread = static_cast<uint32_t>(syscall(SYS_gettid));
+    Ring *raw = ring.get();
+    all.rings[idx] = std::move(ring);
+    return raw;
+  }();
+  return mine;
+}
+
+inline void record(Point point, Phase phase, uint64_t id) {
+  Ring *ring = local();
+  if (ring == nullptr) {
+    return;
+  }
+  uint64_t n = ring->written.load(std::memory_order_relaxed);
+  ring->records[n & (RING_RECORDS - 1)] = {tsc::now(), id, ring->thread,
+                                          point, phase};
+  ring->written.store(n + 1, std::memory_order_release);
+}
+
+inline void name_thread(const char *name) {
+  Ring *ring = local();
+  if (ring != nullptr) {
+    std::strncpy(ring->name, name, NAME_BYTES - 1);
+  }
+}
+
+// A thread's records as read back, oldest first.
+struct ThreadTrace {
+  uint32_t thread = 0;
+  std::string name;
+  std::vector<Record> records;
+};
+
+// File: MAGIC, thread count, then per thread its id, name, record count
+// and records. Meant for after the traced threads have stopped; a ring
+// still being written may have its oldest records torn.
+inline auto dump(const std::string &path) -> bool {
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  Rings &all = rings();
+  uint64_t threads = std::min(all.claimed.load(std::memory_order_acquire),
+                              MAX_THREADS);
+  std::fwrite(&MAGIC, sizeof(MAGIC), 1, file);
+  std::fwrite(&threads, sizeof(threads), 1, file);
+  for (size_t i = 0; i < threads; i++) {
+    const Ring *ring = all.rings[i].get();
+    uint64_t written = ring != nullptr
+                           ? ring->written.load(std::memory_order_acquire)
+                           : 0;
+    uint64_t count = std::min<uint64_t>(written, RING_RECORDS);
+    uint32_t thread = ring != nullptr ? ring->thread : 0;
+    char name[NAME_BYTES]{};
+    if (ring != nullptr) {
+      std::memcpy(name, ring->name, NAME_BYTES);
+    }
+    std::fwrite(&thread, sizeof(thread), 1, file);
+    std::fwrite(name, NAME_BYTES, 1, file);
+    std::fwrite(&count, sizeof(count), 1, file);
+    for (uint64_t seq = written - count; seq < written; seq++) {
+      std::fwrite(&ring->records[seq & (RING_RECORDS - 1)], sizeof(Record), 1,
+                  file);
+    }
+  }
+  return std::fclose(file) == 0;
+}
+
+// False if path isn't a trace file or is cut short.
+inline auto load(const std::string &path, std::vector<ThreadTrace> &threads)
+    -> bool {
+  FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  uint64_t magic = 0, count = 0;
+  bool ok = std::fread(&magic, sizeof(magic), 1, file) == 1 &&
+            magic == MAGIC && std::fread(&count, sizeof(count), 1, file) == 1;
+  for (uint64_t i = 0; ok && i < count; i++) {
+    ThreadTrace trace;
+    char name[NAME_BYTES];
+    uint64_t records = 0;
+    ok = std::fread(&trace.thread, sizeof(trace.thread), 1, file) == 1 &&
+         std::fread(name, NAME_BYTES, 1, file) == 1 &&
+         std::fread(&records, sizeof(records), 1, file) == 1 &&
+         records <= RING_RECORDS;
+    if (ok) {
+      name[NAME_BYTES - 1] = '\0';
+      trace.name = name;
+      trace.records.resize(records);
+      ok = std::fread(trace.records.data(), sizeof(Record), records, file) ==
+           records;
+      threads.push_back(std::move(trace));
+    }
+  }
+  std::fclose(file);
+  return ok;
+}
+
+// Chrome trace event format. Times are made relative to the earliest
+// record. If only_id isn't 0, just the records with that id are kept. Every
+// id seen on more than one record (0 and span ids aside) gets a flow
+// through its records in time order, so an order can be followed across
+// threads.
+inline auto to_chrome_json(const std::vector<ThreadTrace> &threads,
+                           uint64_t only_id = 0) -> std::string {
+  uint64_t start = UINT64_MAX;
+  for (const ThreadTrace &thread : threads) {
+    for (const Record &r : thread.records) {
+      start = std::min(start, r.time);
+    }
+  }
+  auto micros = [start](uint64_t time) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f",
+                  static_cast<double>(time - start) / 1000.0);
+    return std::string(buf);
+  };
+  auto flows_through = [](Point p) {
+    return p == Point::GATEWAY_NEW || p == Point::GATEWAY_CANCEL ||
+           p == Point::ENGINE_EVENT || p == Point::BOOK_MATCH ||
+           p == Point::BOOK_FILL || p == Point::BOOK_ADD ||
+           p == Point::BOOK_CANCEL || p == Point::DISPATCH_REPORT;
+  };
+
+  std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  bool first = true;
+  auto emit = [&](const std::string &event) {
+    out += first ? "" : ",\n";
+    out += event;
+    first = false;
+  };
+  // Per id, (time, thread) of the records a flow goes through.
+  std::map<uint64_t, std::vector<std::pair<uint64_t, uint32_t>>> flows;
+  for (const ThreadTrace &thread : threads) {
+    std::string tid = std::to_string(thread.thread);
+    if (!thread.name.empty()) {
+      emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + tid +
+           ",\"args\":{\"name\":\"" + thread.name + "\"}}");
+    }
+    for (const Record &r : thread.records) {
+      if (only_id != 0 && r.id != only_id) {
+        continue;
+      }
+      auto point = static_cast<size_t>(r.point);
+      const char *name =
+          point < POINT_NAMES.size() ? POINT_NAMES[point] : "unknown";
+      const char *phase = r.phase == Phase::BEGIN ? "B"
+                          : r.phase == Phase::END ? "E"
+                                                  : "i";
+      std::string event = std::string("{\"ph\":\"") + phase +
+                          "\",\"name\":\"" + name +
+                          "\",\"pid\":1,\"tid\":" + tid +
+                          ",\"ts\":" + micros(r.time);
+      if (r.phase == Phase::INSTANT) {
+        event += ",\"s\":\"t\"";
+      }
+      emit(event + ",\"args\":{\"id\":" + std::to_string(r.id) + "}}");
+      if (r.id != 0 && r.phase != Phase::END && flows_through(r.point)) {
+        flows[r.id].emplace_back(r.time, r.thread);
+      }
+    }
+  }
+  for (auto &[id, steps] : flows) {
+    if (steps.size() < 2) {
+      continue;
+    }
+    std::sort(steps.begin(), steps.end());
+    for (size_t i = 0; i < steps.size(); i++) {
+      const char *phase = i == 0 ? "s" : i + 1 == steps.size() ? "f" : "t";
+      emit(std::string("{\"ph\":\"") + phase +
+           "\",\"name\":\"order\",\"cat\":\"order\",\"id\":" +
+           std::to_string(id) + ",\"pid\":1,\"tid\":" +
+           std::to_string(steps[i].second) + ",\"ts\":" +
+           micros(steps[i].first) + ",\"bp\":\"e\"}");
+    }
+  }
+  out += "\n]}\n";
+  return out;
+}
+}; // namespace trace
+
+#ifdef TACHYON_TRACE
+#define TRACE_INSTANT(point, id)                                               \
+  ::trace::record(::trace::Point::point, ::trace::Phase::INSTANT, (id))
+#define TRACE_BEGIN(point, id)                                                 \
+  ::trace::record(::trace::Point::point, ::trace::Phase::BEGIN, (id))
+#define TRACE_END(point, id)                                                   \
+  ::trace::record(::trace::Point::point, ::trace::Phase::END, (id))
+#define TRACE_THREAD(name) ::trace::name_thread(name)
+#define TRACE_DUMP(path) ::trace::dump(path)
+#else
+#define TRACE_INSTANT(point, id) ((void)0)
+#define TRACE_BEGIN(point, id) ((void)0)
+#define TRACE_END(point, id) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#define TRACE_DUMP(path) ((void)0)
+#endif
@@ -0,0 +1,231 @@
+#pragma once
+#include <sys/time.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "telemetry/alloc_tracker.hpp"
+
+// Notices when a pipeline thread stops making progress or a queue backs up,
+// and writes down when, so tail latency can be lined up with the backup.
+//
+// Each watched thread bumps its Heartbeat once per pass of its loop, a
+// relaxed store to a line nobody else writes. The watchdog thread looks
+// every interval: a heartbeat that hasn't moved for stall_ms is logged as a
+// stall (a page fault storm, a disk write blocking the logger, a thread
+// that died on an exception), and again with its length once it moves.
+// Queues are watched through callbacks for their depth and high water mark
+// (the consumers keep that themselves, exact, at no extra cost); a queue
+// over SATURATED_PERCENT full is logged until it drains, and every time its
+// high water mark reaches another tenth of the capacity past half.
+
+namespace watchdog {
+static constexpr const char *LOG_PATH = "logs/watchdog.txt";
+static constexpr int INTERVAL_MS = 5;
+static constexpr int STALL_MS = 50;
+static constexpr uint64_t SATURATED_PERCENT = 75;
+
+// The low bit is set while the owner is blocked waiting for input, which is
+// idleness, not a stall; the next beat clears it. Still one store either way.
+struct alignas(64) Heartbeat {
+  std::atomic<uint64_t> beats{0};
+
+  // Owner thread only.
+  void beat() {
+    beats.store((beats.load(std::memory_order_relaxed) | 1) + 1,
+                std::memory_order_relaxed);
+  }
+  // Owner thread only, right before a blocking wait.
+  void wait() {
+    beats.store(beats.load(std::memory_order_relaxed) | 1,
+                std::memory_order_relaxed);
+  }
+};
+
+// The exchange's threads.
+enum class Thread : uint8_t {
+  GATEWAY,
+  ENGINE,
+  JOURNAL,
+  TRADE_LOG,
+  DISPATCHER,
+  COUNT
+};
+
+static constexpr std::array<const char *, static_cast<size_t>(Thread::COUNT)>
+    THREAD_NAMES = {"gateway", "engine", "journal", "trade_log", "dispatcher"};
+
+inline Heartbeat heartbeats[static_cast<size_t>(Thread::COUNT)];
+
+inline void beat(Thread t) { heartbeats[static_cast<size_t>(t)].beat(); }
+inline void wait(Thread t) { heartbeats[static_cast<size_t>(t)].wait(); }
+
+class Watchdog {
+private:
+  struct WatchedThread {
+    std::string name;
+    const Heartbeat *heartbeat;
+    uint64_t last_beats = 0;
+    uint64_t still_since = 0; // ms, when last_beats was first seen.
+    bool stalled = false;
+  };
+
+  struct WatchedQueue {
+    std::string name;
+    uint64_t capacity;
+    std::function<uint64_t()> depth;
+    std::function<uint64_t()> high_water;
+    uint64_t saturated_since = 0; // ms, 0 while below the line.
+    uint64_t reported_tenths = 5; // high water logged up to here.
+  };
+
+  std::vector<WatchedThread> threads;
+  std::vector<WatchedQueue> queues;
+  std::string log_path;
+  FILE *log = nullptr;
+  int interval_ms;
+  uint64_t stall_ms;
+  std::atomic<bool> running{false};
+  std::thread worker;
+
+  static auto steady_ms() -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Wall clock, to line up with other logs. "2024-01-31 12:00:00.123".
+  static auto wall_time() -> std::string {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    tm local;
+    localtime_r(&tv.tv_sec, &local);
+    char buf[32];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local);
+    std::snprintf(buf + n, sizeof(buf) - n, ".%03ld", tv.tv_usec / 1000);
+    return buf;
+  }
+
+  void write(const std::string &line) {
+    if (log == nullptr) {
+      return;
+    }
+    std::string entry = wall_time() + " " + line + "\n";
+    std::fwrite(entry.data(), 1, entry.size(), log);
+    std::fflush(log); // whatever happens next, this is on disk.
+  }
+
+  void run() {
+    alloc::name_thread("watchdog");
+    while (running.load(std::memory_order_relaxed)) {
+      check(steady_ms());
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+  }
+
+public:
+  explicit Watchdog(std::string path = LOG_PATH, int interval = INTERVAL_MS,
+                    int stall = STALL_MS)
+      : log_path(std::move(path)), interval_ms(interval),
+        stall_ms(static_cast<uint64_t>(stall)) {}
+  ~Watchdog() {
+    stop();
+    if (log != nullptr) {
+      std::fclose(log);
+    }
+  }
+  Watchdog(const Watchdog &) = delete;
+  auto operator=(const Watchdog &) -> Watchdog & = delete;
+
+  // Setup only, before start(). A thread is only judged once it has beaten,
+  // and not while it waits.
+  void watch(std::string name, const Heartbeat &heartbeat) {
+    threads.push_back({std::move(name), &heartbeat});
+  }
+  void watch(Thread t) {
+    watch(THREAD_NAMES[static_cast<size_t>(t)],
+          heartbeats[static_cast<size_t>(t)]);
+  }
+  void watch(std::string name, uint64_t capacity,
+             std::function<uint64_t()> depth,
+             std::function<uint64_t()> high_water) {
+    queues.push_back(
+        {std::move(name), capacity, std::move(depth), std::move(high_water)});
+  }
+
+  // Opens the log, the watching starts on the next check().
+  void open() {
+    if (log == nullptr) {
+      log = std::fopen(log_path.c_str(), "a");
+    }
+  }
+
+  void start() {
+    open();
+    write("watchdog started");
+    running.store(true);
+    worker = std::thread(&Watchdog::run, this);
+  }
+
+  void stop() {
+    if (!running.exchange(false)) {
+      return;
+    }
+    worker.join();
+    write("watchdog stopped");
+  }
+
+  // One look at everything, now_ms on the steady clock. The watchdog thread
+  // calls it every interval.
+  void check(uint64_t now_ms) {
+    for (WatchedThread &thread : threads) {
+      uint64_t beats = thread.heartbeat->beats.load(std::memory_order_relaxed);
+      if (beats != thread.last_beats || beats == 0 || (beats & 1) != 0) {
+        if (thread.stalled) {
+          write("RESUMED " + thread.name + " after " +
+                std::to_string(now_ms - thread.still_since) + " ms");
+        }
+        thread.last_beats = beats;
+        thread.still_since = now_ms;
+        thread.stalled = false;
+      } else if (!thread.stalled && now_ms - thread.still_since >= stall_ms) {
+        thread.stalled = true;
+        write("STALL " + thread.name + " no progress for " +
+              std::to_string(now_ms - thread.still_since) + " ms");
+      }
+    }
+    for (WatchedQueue &queue : queues) {
+      uint64_t depth = queue.depth();
+      uint64_t percent = queue.capacity ? depth * 100 / queue.capacity : 0;
+      std::string fill = std::to_string(depth) + "/" +
+                         std::to_string(queue.capacity) + " (" +
+                         std::to_string(percent) + "%)";
+      if (percent >= SATURATED_PERCENT && queue.saturated_since == 0) {
+        queue.saturated_since = now_ms ? now_ms : 1;
+        write("SATURATED " + queue.name + " " + fill);
+      } else if (percent < SATURATED_PERCENT && queue.saturated_since != 0) {
+        write("DRAINED " + queue.name + " " + fill + " after " +
+              std::to_string(now_ms - queue.saturated_since) + " ms");
+        queue.saturated_since = 0;
+      }
+      uint64_t high = queue.high_water();
+      uint64_t tenths = queue.capacity ? high * 10 / queue.capacity : 0;
+      if (tenths > queue.reported_tenths) {
+        queue.reported_tenths = tenths;
+        write("HIGH WATER " + queue.name + " " + std::to_string(high) + "/" +
+              std::to_string(queue.capacity) + " (" +
+              std::to_string(high * 100 / queue.capacity) + "%)");
+      }
+    }
+  }
+};
+}; // namespace watchdog
@@ -0,0 +1,89 @@
+#include "telemetry/alloc_tracker.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Replacements for the global operator new and delete that count every
+// call, see include/telemetry/alloc_tracker.hpp. Only linked in with
+// TACHYON_TRACK_ALLOCS; the rest of the time this file is empty.
+
+#ifdef TACHYON_TRACK_ALLOCS
+namespace {
+auto allocate(size_t bytes) -> void * {
+  alloc::on_alloc(bytes);
+  return std::malloc(bytes != 0 ? bytes : 1);
+}
+
+auto allocate(size_t bytes, std::align_val_t align) -> void * {
+  alloc::on_alloc(bytes);
+  void *p = nullptr;
+  size_t alignment = std::max(static_cast<size_t>(align), sizeof(void *));
+  if (posix_memalign(&p, alignment, bytes != 0 ? bytes : 1) != 0) {
+    return nullptr;
+  }
+  return p;
+}
+
+void release(void *p) {
+  if (p != nullptr) {
+    alloc::on_free();
+    std::free(p);
+  }
+}
+
+template <typename... Align> auto checked(size_t bytes, Align... align) -> void * {
+  void *p = allocate(bytes, align...);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+} // namespace
+
+auto operator new(size_t n) -> void * { return checked(n); }
+auto operator new[](size_t n) -> void * { return checked(n); }
+auto operator new(size_t n, std::align_val_t a) -> void * {
+  return checked(n, a);
+}
+auto operator new[](size_t n, std::align_val_t a) -> void * {
+  return checked(n, a);
+}
+auto operator new(size_t n, const std::nothrow_t &) noexcept -> void * {
+  return allocate(n);
+}
+auto operator new[](size_t n, const std::nothrow_t &) noexcept -> void * {
+  return allocate(n);
+}
+auto operator new(size_t n, std::align_val_t a, const std::nothrow_t &) noexcept
+    -> void * {
+  return allocate(n, a);
+}
+auto operator new[](size_t n, std::align_val_t a,
+                    const std::nothrow_t &) noexcept -> void * {
+  return allocate(n, a);
+}
+
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+void operator delete(void *p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { release(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+  release(p);
+}
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  release(p);
+}
+#endif
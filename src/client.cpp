@@ -25,12 +25,15 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <utility>
 
 #include "engine/concepts.hpp"
 #include "engine/constants.hpp"
 #include "engine/types.hpp"
 #include "my_config.hpp"
 #include "network/serialise.hpp"
+#include "network/serialise_batch.hpp"
+#include "network/serialise_v2.hpp"
 
 // NOTE: the report writing scheme isn't good rigth now.
 // Especially because ID's are not known at initilasation.
@@ -46,10 +49,44 @@ Client<config>::Client()
   file << "Execution Reports for Client " << my_id << "\n";
 }
 
-template <TachyonConfig config> Client<config>::~Client() { writeReports(); }
+template <TachyonConfig config> Client<config>::~Client() {
+  writeReports();
+  if (shm_slot != nullptr) {
+    shm::release_slot(shm_slot); // unless moveData() already did.
+  }
+  if (shm_region != nullptr) {
+    shm::close_region(shm_region);
+  }
+}
 
 template <TachyonConfig config>
-void Client<config>::init(std::string host, std::string port) {
+void Client<config>::init(std::string host, std::string port,
+                          uint8_t protocol) {
+  connectTo(host, port);
+  requestToken();
+  selectProtocol(protocol);
+}
+
+template <TachyonConfig config>
+void Client<config>::resume(std::string host, std::string port) {
+  if (shm_slot != nullptr) {
+    throw std::runtime_error("Only a TCP session can be resumed");
+  }
+  connectTo(host, port);
+  // Whatever was in flight went with the old connection: the server
+  // replays the reports we missed, orders not yet sent are dropped.
+  rx_buffer.clear();
+  tx_buffer.clear();
+  rx_protocol = PROTOCOL_V1;
+  tx_sequence = 0;
+  resuming = true;
+  tx_buffer.commit(serialise_login_resume({my_id, session_token, next_report},
+                                          tx_buffer.prepare(RESUME_LEN)));
+  selectProtocol(std::exchange(tx_protocol, PROTOCOL_V1));
+}
+
+template <TachyonConfig config>
+void Client<config>::connectTo(std::string host, std::string port) {
   struct addrinfo hints;
   struct addrinfo *servinfo;
   struct addrinfo *ptr;
@@ -87,6 +124,37 @@ void Client<config>::init(std::string host, std::string port) {
   freeaddrinfo(servinfo);
 }
 
+template <TachyonConfig config>
+void Client<config>::initShm(std::string path, uint8_t protocol) {
+  shm_region = shm::open_region(path);
+  shm_slot = shm::claim_slot(shm_region);
+  if (shm_slot == nullptr) {
+    shm::close_region(shm_region);
+    throw std::runtime_error("No free shared memory session");
+  }
+  std::cout << "Client connected to server over shared memory\n";
+  // The gateway may not have picked the slot up yet, but we can already
+  // write: it reads from the start of the ring once it does.
+  requestToken();
+  selectProtocol(protocol);
+}
+
+template <TachyonConfig config> void Client<config>::requestToken() {
+  // Has to be our first message; the answer comes before any report.
+  tx_buffer.commit(serialise_session_token(
+      {}, tx_buffer.prepare(SESSION_TOKEN_LEN)));
+}
+
+template <TachyonConfig config>
+void Client<config>::selectProtocol(uint8_t protocol) {
+  if (protocol != PROTOCOL_V1) {
+    // Goes out ahead of any order, the server switches right after it.
+    tx_buffer.commit(serialise_protocol_select(
+        protocol, tx_buffer.prepare(PROTOCOL_SELECT_LEN)));
+    tx_protocol = protocol;
+  }
+}
+
 template <TachyonConfig config> auto Client<config>::flushBuffer() -> bool {
   if (tx_buffer.size() == 0) {
     return true;
@@ -94,8 +162,14 @@ template <TachyonConfig config> auto Client<config>::flushBuffer() -> bool {
   const uint8_t *data_ptr = tx_buffer.begin();
   size_t remaining = tx_buffer.size();
 
-  // non blocking send.
-  ssize_t sent = send(sockfd, data_ptr, remaining, MSG_DONTWAIT);
+  ssize_t sent;
+  if (shm_slot != nullptr) {
+    sent = static_cast<ssize_t>(shm_slot->inbound.write(data_ptr, remaining));
+  } else {
+    // non blocking send. MSG_NOSIGNAL so a dropped connection shows up in
+    // moveData() as a disconnect, rather than killing us.
+    sent = send(sockfd, data_ptr, remaining, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
 
   if (sent > 0) {
     tx_buffer.erase(sent);
@@ -130,6 +204,10 @@ template <TachyonConfig config> void Client<config>::moveData() {
   // recv -> rx_buffer -> deserialise -> exec reports queue -> used by
   // strategist. tx_buffer -> flush.
   // TODO: make some proper mechanism to close true loop
+  if (shm_slot != nullptr) {
+    moveDataShm();
+    return;
+  }
 
   int epoll_fd = epoll_create1(0);
   if (epoll_fd == -1) {
@@ -151,21 +229,7 @@ template <TachyonConfig config> void Client<config>::moveData() {
       break;
     }
     // Now we handle transmit.
-    uint8_t serialise_buf[64];
-    int pops = 0;
-    Order order{};
-    while (pops < 100 && orders_to_place.try_pop(order)) {
-      size_t len = serialise_order(order, serialise_buf);
-      tx_buffer.insert(serialise_buf, len);
-      pops++;
-    }
-    pops = 0;
-    OrderId to_cancel;
-    while (pops < 100 && cancels_to_place.try_pop(to_cancel)) {
-      size_t len = serialise_order_cancel(to_cancel, serialise_buf);
-      tx_buffer.insert(serialise_buf, len);
-      pops++;
-    }
+    queueRequests();
 
     bool all_sent = flushBuffer();
     // upon printing all sent is almost always true.
@@ -194,6 +258,7 @@ template <TachyonConfig config> void Client<config>::moveData() {
           } else {
             std::cout << "Server disconnected.\n";
             close(events.data.fd);
+            close(epoll_fd);
             return;
           }
         }
@@ -211,19 +276,123 @@ template <TachyonConfig config> void Client<config>::moveData() {
   }
 }
 
+// Same loop without sockets: both directions are rings we poll.
+template <TachyonConfig config> void Client<config>::moveDataShm() {
+  std::cout << "Client loop started\n";
+  while (true) {
+    queueRequests();
+    flushBuffer();
+
+    if (shm_slot->outbound.size() > 0) {
+      rx_buffer.commit(shm_slot->outbound.read(
+          rx_buffer.prepare(MAX_TEMP_BUF_SIZE), MAX_TEMP_BUF_SIZE));
+      drainRx();
+    } else if (shm_slot->state.load(std::memory_order_acquire) ==
+               shm::SlotState::CLOSING) {
+      std::cout << "Server disconnected.\n";
+      // Done with the rings, the gateway may give the slot away now.
+      shm::release_slot(std::exchange(shm_slot, nullptr));
+      return;
+    }
+  }
+}
+
+template <TachyonConfig config> void Client<config>::queueRequests() {
+  if (tx_protocol == PROTOCOL_V2) {
+    queueFrames();
+    return;
+  }
+  uint8_t serialise_buf[64];
+  // Collect the orders first so the whole run is encoded in one go.
+  Order batch[MAX_ORDER_BATCH];
+  size_t n_orders = 0;
+  while (n_orders < MAX_ORDER_BATCH &&
+         orders_to_place.try_pop(batch[n_orders])) {
+    n_orders++;
+  }
+  if (n_orders > 0) {
+    tx_buffer.commit(serialise_orders(
+        batch, n_orders,
+        tx_buffer.prepare(n_orders * OrderMessage::wire_size)));
+  }
+  int pops = 0;
+  OrderId to_cancel;
+  while (pops < 100 && cancels_to_place.try_pop(to_cancel)) {
+    size_t len = serialise_order_cancel(to_cancel, serialise_buf);
+    tx_buffer.insert(serialise_buf, len);
+    pops++;
+  }
+}
+
+template <TachyonConfig config> void Client<config>::queueFrames() {
+  // One frame of orders and one of cancels per pass. Payloads are written
+  // behind a header filled in once we know the count.
+  constexpr size_t MAX_BATCH = MAX_ORDER_BATCH;
+  static_assert(MAX_BATCH <= MAX_FRAME_MESSAGES);
+
+  uint8_t *frame =
+      tx_buffer.prepare(FRAME_HEADER_LEN + MAX_BATCH * ORDER_V2_LEN);
+  uint8_t count = 0;
+  Order order{};
+  while (count < MAX_BATCH && orders_to_place.try_pop(order)) {
+    serialise_order_v2(order, &frame[FRAME_HEADER_LEN + count * ORDER_V2_LEN]);
+    count++;
+  }
+  if (count > 0) {
+    write_frame_header(MessageType::ORDER_NEW, count, tx_sequence, frame);
+    tx_sequence += count;
+    tx_buffer.commit(FRAME_HEADER_LEN + count * ORDER_V2_LEN);
+  }
+
+  frame = tx_buffer.prepare(FRAME_HEADER_LEN + MAX_BATCH * CANCEL_V2_LEN);
+  count = 0;
+  OrderId to_cancel;
+  while (count < MAX_BATCH && cancels_to_place.try_pop(to_cancel)) {
+    serialise_order_cancel_v2(
+        to_cancel, &frame[FRAME_HEADER_LEN + count * CANCEL_V2_LEN]);
+    count++;
+  }
+  if (count > 0) {
+    write_frame_header(MessageType::ORDER_CANCEL, count, tx_sequence, frame);
+    tx_sequence += count;
+    tx_buffer.commit(FRAME_HEADER_LEN + count * CANCEL_V2_LEN);
+  }
+}
+
+template <TachyonConfig config> void Client<config>::drainFrames() {
+  while (rx_buffer.size() >= FRAME_HEADER_LEN) {
+    const uint8_t *frame = rx_buffer.begin();
+    FrameHeader header = read_frame_header(frame);
+    if (!valid_frame_header(header) ||
+        header.type != MessageType::EXEC_REPORT) {
+      break; // invalid data, same as v1 we just stop.
+    }
+    if (rx_buffer.size() < header.length) {
+      break;
+    }
+    const uint8_t *payload = frame + FRAME_HEADER_LEN;
+    for (uint8_t i = 0; i < header.count; i++) {
+      ExecutionReport exec_report;
+      deserialise_execution_report_v2(payload, exec_report);
+      reports.push(exec_report);
+      payload += EXEC_REPORT_V2_LEN;
+    }
+    next_report += header.count;
+    rx_buffer.erase(header.length);
+  }
+}
+
 template <TachyonConfig config> void Client<config>::drainRx() {
   while (rx_buffer.size() > 0) {
-    uint8_t msg_type = *rx_buffer.begin();
-    uint32_t expected_len = 0;
-
-    if (msg_type == static_cast<uint8_t>(MessageType::LOGIN_RESPONSE)) {
-      expected_len = 5; //  1 + 4 for client.
+    if (rx_protocol == PROTOCOL_V2) {
+      drainFrames();
+      return;
     }
+    uint8_t msg_type = *rx_buffer.begin();
+    size_t expected_len = CLIENT_INBOUND_LENGTHS[msg_type];
     // TODO: there should be a feature for occur once only events right? Look
     // that up?
-    else if (msg_type == static_cast<uint8_t>(MessageType::EXEC_REPORT)) {
-      expected_len = 1 + sizeof(ExecutionReport);
-    } else {
+    if (expected_len == 0) {
       // invalid data.
       // Should we do anything.
       // i guess not.
@@ -234,16 +403,43 @@ template <TachyonConfig config> void Client<config>::drainRx() {
     }
     // full message available!.
     uint8_t *msg_start = rx_buffer.begin();
-    if (msg_type == static_cast<uint8_t>(MessageType::LOGIN_RESPONSE)) {
-      uint32_t net_id;
-      std::memcpy(&net_id, &msg_start[1], 4);
-      my_id = be32toh(net_id);
+    if (msg_type == static_cast<uint8_t>(MessageType::EXEC_REPORT)) {
+      // Reports usually arrive in runs, decode the whole run at once.
+      size_t run = 1;
+      while (run < MAX_REPORT_BATCH &&
+             rx_buffer.size() >= (run + 1) * EXEC_REPORT_LEN &&
+             msg_start[run * EXEC_REPORT_LEN] == msg_type) {
+        run++;
+      }
+      ExecutionReport batch[MAX_REPORT_BATCH];
+      deserialise_execution_reports(msg_start, run, batch);
+      for (size_t i = 0; i < run; i++) {
+        reports.push(batch[i]); // thread safe queue.
+      }
+      next_report += run;
+      rx_buffer.erase(run * EXEC_REPORT_LEN);
+      continue;
     }
-
-    else if (msg_type == static_cast<uint8_t>(MessageType::EXEC_REPORT)) {
-      ExecutionReport exec_report;
-      deserialise_execution_report(msg_start, exec_report);
-      reports.push(exec_report); // thread safe queue.
+    if (msg_type == static_cast<uint8_t>(MessageType::LOGIN_RESPONSE)) {
+      ClientId provisional = deserialise_new_login(msg_start);
+      if (!resuming) { // our id comes back in RESUME_RESPONSE.
+        my_id = provisional;
+      }
+    } else if (msg_type == static_cast<uint8_t>(MessageType::SESSION_TOKEN)) {
+      session_token = deserialise_session_token(msg_start).token;
+    } else if (msg_type ==
+               static_cast<uint8_t>(MessageType::RESUME_RESPONSE)) {
+      SessionResume resume = deserialise_resume_response(msg_start);
+      if (resume.next_sequence > next_report) {
+        std::cout << "Lost reports " << next_report << " to "
+                  << resume.next_sequence - 1 << " on resume\n";
+      }
+      my_id = resume.client_id;
+      next_report = resume.next_sequence;
+      resuming = false;
+    } else {
+      // Server's echo, frames from here on.
+      rx_protocol = deserialise_protocol_select(msg_start);
     }
     // erase old data.
     rx_buffer.erase(expected_len);
@@ -3,11 +3,10 @@
 
 #include <algorithm>
 #include <atomic>
-#include <chrono>
 #include <cstdint>
 #include <fstream>
-#include <iostream>
 #include <limits>
+#include <optional>
 #include <regex>
 #include <thread>
 
@@ -15,129 +14,216 @@
 #include "engine/concepts.hpp"
 #include "engine/constants.hpp"
 #include "engine/types.hpp"
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/clock.hpp"
+#include "telemetry/metrics.hpp"
+#include "telemetry/perf_counters.hpp"
+#include "telemetry/trace.hpp"
+#include "telemetry/watchdog.hpp"
 
 extern std::atomic<bool> start_exchange;
 extern std::atomic<bool> keep_running;
 uint64_t batch_size = 100000;
 
 template <TachyonConfig config>
-Engine<config>::Engine(config::EventQueue &ev_q,
-                       config::EventQueue &prcs_events,
-                       OrderBook<config> &orderbook, LoggerClass<config> &lgr)
-    : event_queue(ev_q), logger(lgr), processed_events(prcs_events),
-      orderbook(orderbook) {
-  trades_buffer.reserve(MAX_TRADE_BUFFER_SIZE);
-}
+Engine<config>::Engine(config::EventQueue &ev_q, OrderBook<config> &orderbook,
+                       LoggerClass<config> &lgr, md::Publisher &market_data,
+                       size_t max_batch, size_t perf_sample_interval)
+    : event_queue(ev_q), logger(lgr), market_data(market_data),
+      orderbook(orderbook), batch(std::max<size_t>(max_batch, 1)),
+      perf_sample_interval(perf_sample_interval) {}
 
 template <TachyonConfig config> Engine<config>::~Engine() = default;
 
+// The order a request is about, what its trace records are keyed by.
+[[maybe_unused]] static auto traceId(const ClientRequest &request) -> OrderId {
+  return request.type == RequestType::New ? request.new_order.order_id
+                                          : request.order_id_to_cancel;
+}
+
+static_assert(static_cast<size_t>(metrics::Counter::ENGINE_CONTEXT_SWITCHES) -
+                      static_cast<size_t>(metrics::Counter::ENGINE_CYCLES) ==
+                  perf::EVENTS - 1,
+              "engine counters follow perf::Event");
+
+// Adds one sampled batch's hardware counts to the metrics.
+static void recordPerf(const perf::Sample &sample, size_t events) {
+  metrics::add(metrics::Counter::ENGINE_SAMPLED_EVENTS, events);
+  for (size_t i = 0; i < perf::EVENTS; i++) {
+    if (sample.valid[i]) {
+      metrics::add(static_cast<metrics::Counter>(
+                       static_cast<size_t>(metrics::Counter::ENGINE_CYCLES) + i),
+                   sample.values[i]);
+    }
+  }
+}
+
+// The book's footprint, for the memory gauges. Counts the book keeps as it
+// goes, cheap enough for every batch.
+template <TachyonConfig config>
+static void recordMemory(const OrderBook<config> &orderbook) {
+  auto usage = orderbook.memory();
+  metrics::set(metrics::Gauge::BOOK_BYTES, usage.total().bytes);
+  metrics::set(metrics::Gauge::BOOK_ARENA_SLOTS,
+               usage.arena.live + usage.arena.tombstones);
+  metrics::set(metrics::Gauge::BOOK_INDEX_TOMBSTONES,
+               usage.arena_idx.tombstones + usage.list_idx.tombstones);
+}
+
 // WARNING: Check for seg faults becase we ignore the boolean returned by insert
 // in map and only use it.
 
+// Each fill is reported straight from the book as the sweep finds it.
 template <TachyonConfig config>
-void Engine<config>::handle_GTC_LIMIT(ClientRequest &incoming, TimeStamp now) {
-  trades_buffer.clear();
+void Engine<config>::matchAndReport(ClientRequest &incoming, TimeStamp now) {
   orderbook.match(incoming,
-                  trades_buffer); // incoming must be passed by reference.
+                  [&](Trade &trade, const ClientRequest &resting) {
+                    trade.time_stamp = now;
+                    metrics::add(metrics::Counter::FILLS);
+                    logger.logTrade(trade, resting, incoming, trade.quantity);
+                    market_data.trade(trade);
+                  });
+}
+
+template <TachyonConfig config>
+void Engine<config>::handle_GTC_LIMIT(ClientRequest &incoming, TimeStamp now) {
+  matchAndReport(incoming, now); // incoming must be passed by reference.
   if (incoming.new_order.quantity > 0) {
     orderbook.add(incoming); // Some quantity was left so we add to order book.
-  }
-  for (auto [trade, resting] : trades_buffer) {
-    trade.time_stamp = now;
-    logger.logTrade(trade, resting, incoming, trade.quantity);
+    market_data.add(incoming.new_order.side, incoming.new_order.price,
+                    incoming.new_order.quantity, now);
   }
 }
 
 template <TachyonConfig config>
 void Engine<config>::handle_GTC_MARKET(ClientRequest &incoming) {
+  metrics::add(metrics::Counter::REJECTS);
   logger.logInvalidOrder(incoming);
 }
 
 template <TachyonConfig config>
 void Engine<config>::handle_IOC_LIMIT(ClientRequest &incoming, TimeStamp now) {
-  trades_buffer.clear();
-  orderbook.match(incoming, trades_buffer);
   // NOTE: since this is IOC order, we do NOT pass add it irrespective of
   // remaining quantity.
-  for (auto [trade, resting] : trades_buffer) {
-    trade.time_stamp = now;
-    logger.logTrade(trade, resting, incoming, trade.quantity);
-  }
+  matchAndReport(incoming, now);
 }
 
 template <TachyonConfig config>
 void Engine<config>::handle_IOC_MARKET(ClientRequest &incoming, TimeStamp now) {
-  if (incoming.new_order.side == Side::ASK) { // We set price to zero.
-    incoming.new_order.price =
-        (CLIENT_BASE_PRICE) +
-        (CLIENT_PRICE_DISTRIB_MIN); // price distrib min is -ve
+  // Any price in the book's band will do.
+  if (incoming.new_order.side == Side::ASK) {
+    incoming.new_order.price = orderbook.minPrice();
   } else if (incoming.new_order.side == Side::BID) {
-    incoming.new_order.price = (CLIENT_BASE_PRICE) + (CLIENT_PRICE_DISTRIB_MAX);
+    incoming.new_order.price = orderbook.maxPrice();
   }
-  trades_buffer.clear();
-  orderbook.match(incoming, trades_buffer);
   // NOTE: since this is IOC order, we do NOT pass add it irrespective of
   // remaining quantity.
-  for (auto [trade, resting] : trades_buffer) {
-    trade.time_stamp = now;
-    logger.logTrade(trade, resting, incoming, trade.quantity);
-  }
+  matchAndReport(incoming, now);
 }
 
-// TODO: right now the execution reports logging is not correct.
-// Takers have zero remaining quantity. this is because of reference at end.
-// pass trade quantity and init quanity or their difference.
-// However actual trades are correct.
+template <TachyonConfig config>
+void Engine<config>::handleEvent(ClientRequest &incoming, TimeStamp now) {
+  // printEvent(incoming); // For debugging only!
+  TRACE_BEGIN(ENGINE_EVENT, traceId(incoming));
+  logger.logEvent(incoming);
+  if (incoming.type == RequestType::New) {
+    metrics::add(metrics::Counter::ORDERS_NEW);
+    // For now, we assume correct quantity. A limit price the book has no
+    // level for is rejected.
+    logger.logNewOrder(incoming);
+    if (incoming.new_order.order_type == OrderType::LIMIT &&
+        !orderbook.inBand(incoming.new_order.price)) {
+      metrics::add(metrics::Counter::REJECTS);
+      logger.logInvalidOrder(incoming);
+    } else if (incoming.new_order.tif == TimeInForce::GTC) {
+      if (incoming.new_order.order_type == OrderType::LIMIT) {
+        handle_GTC_LIMIT(incoming, now);
+      } else if (incoming.new_order.order_type == OrderType::MARKET) {
+        // Invalid order type. Handle properly.
+        handle_GTC_MARKET(incoming);
+      }
+    } else if (incoming.new_order.tif == TimeInForce::IOC) {
+      if (incoming.new_order.order_type == OrderType::LIMIT) {
+        handle_IOC_LIMIT(incoming, now);
+      } else if (incoming.new_order.order_type == OrderType::MARKET) {
+        handle_IOC_MARKET(incoming, now);
+      }
+    }
+  } else if (incoming.type == RequestType::Cancel) {
+    metrics::add(metrics::Counter::CANCELS);
+    ClientRequest to_cancel;
+    if (orderbook.cancelOrder(incoming.order_id_to_cancel, to_cancel)) {
+      logger.logCancelOrder(to_cancel);
+      market_data.remove(to_cancel.new_order.side, to_cancel.new_order.price,
+                         to_cancel.new_order.quantity, now);
+    } else {
+      metrics::add(metrics::Counter::REJECTS);
+      logger.logNotFound(incoming);
+    }
+  }
+  TRACE_END(ENGINE_EVENT, traceId(incoming));
+}
 
 template <TachyonConfig config> void Engine<config>::handleEvents() {
+  TRACE_THREAD("engine");
+  alloc::name_thread("engine");
   while (!start_exchange.load(std::memory_order_acquire)) {
     std::this_thread::yield();
   }
-  ClientRequest incoming;
-
-  uint64_t processed_events_count = 0;
+  // Counters belong to the thread that opens them.
+  std::optional<perf::Counters> counters;
+  if (perf_sample_interval > 0) {
+    counters.emplace();
+    counters->start();
+  }
+  uint64_t batches = 0;
   // NOTE: Only GTC LIMIT handlers exist now.
   while (keep_running.load(std::memory_order_relaxed)) {
-    if (event_queue.try_pop(incoming)) {
-      TimeStamp now = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                          std::chrono::steady_clock::now().time_since_epoch())
-                          .count();
-      // printEvent(incoming); // For debugging only!
-      processed_events.push(incoming);
-      processed_events_count++;
-      if (processed_events_count % MAX_PROCESSED_EVENTS_SIZE == 0) {
-        std::cout << "Events processed: " << processed_events_count << "\n";
-        std::cout << "Orderbook Size: "
-                  << orderbook.size_asks() + orderbook.size_bids() << "\n";
-        std::cout << "Event queue size: " << event_queue.size() << "\n";
-      }
-      if (incoming.type == RequestType::New) {
-        // For now, we assume correct price and quantity. So every order will
-        // be accepted.
-        logger.logNewOrder(incoming);
-        if (incoming.new_order.tif == TimeInForce::GTC) {
-          if (incoming.new_order.order_type == OrderType::LIMIT) {
-            handle_GTC_LIMIT(incoming, now);
-          } else if (incoming.new_order.order_type == OrderType::MARKET) {
-            // Invalid order type. Handle properly.
-            handle_GTC_MARKET(incoming);
-          }
-        } else if (incoming.new_order.tif == TimeInForce::IOC) {
-          if (incoming.new_order.order_type == OrderType::LIMIT) {
-            handle_IOC_LIMIT(incoming, now);
-          } else if (incoming.new_order.order_type == OrderType::MARKET) {
-            handle_IOC_MARKET(incoming, now);
-          }
-        }
-      } else if (incoming.type == RequestType::Cancel) {
-        ClientRequest to_cancel;
-        if (orderbook.cancelOrder(incoming.order_id_to_cancel, to_cancel)) {
-          logger.logCancelOrder(to_cancel);
-        } else {
-          logger.logNotFound(incoming);
-        }
+    watchdog::beat(watchdog::Thread::ENGINE);
+    size_t count = event_queue.pop_batch(batch.data(), batch.size());
+    if (count == 0) {
+      continue;
+    }
+    // Aborts if the batch touched the heap, when built to track allocations.
+    alloc::NoAllocation no_alloc("engine batch");
+    bool sampled = counters && ++batches % perf_sample_interval == 0;
+    perf::Sample before;
+    if (sampled) {
+      before = counters->read();
+    }
+    // Two clock reads for the batch: they all arrived by now, and they are
+    // all done at the end of it.
+    TimeStamp now = tsc::now();
+    TRACE_BEGIN(ENGINE_BATCH, count);
+    // Cancels look their order up in the book's indexes, start those loads
+    // now so they overlap with the events ahead of them.
+    for (size_t i = 0; i < count; i++) {
+      if (batch[i].type == RequestType::Cancel) {
+        orderbook.prefetchCancel(batch[i].order_id_to_cancel);
       }
     }
+    for (size_t i = 0; i < count; i++) {
+      TimeStamp received = batch[i].time_stamp;
+      metrics::record(metrics::Stage::GATEWAY,
+                      now > received ? now - received : 0);
+      handleEvent(batch[i], now);
+      logger.finishEvent();
+    }
+    TimeStamp done = tsc::now();
+    logger.flush(done); // everything the batch produced, with one release.
+    // Each event is charged its share of the batch, not the time it waited
+    // behind the ones before it.
+    uint64_t per_event = (done - now) / count;
+    for (size_t i = 0; i < count; i++) {
+      metrics::record(metrics::Stage::ENGINE, per_event);
+    }
+    TRACE_END(ENGINE_BATCH, count);
+    if (sampled) {
+      recordPerf(counters->read().since(before), count);
+    }
+
+    metrics::set(metrics::Gauge::BOOK_ORDERS, orderbook.size());
+    recordMemory(orderbook);
   }
 }
 
@@ -5,35 +5,161 @@
 
 #include <chrono>
 #include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
 
+#include "containers/huge_page_allocator.hpp"
 #include "network/tcpserver.hpp"
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/clock.hpp"
+#include "telemetry/trace.hpp"
 
 std::atomic<bool> start_exchange(false);
 extern std ::atomic<bool> keep_running;
 
 template <TachyonConfig config>
-Exchange<config>::Exchange()
-    : logger(event_queue, execution_report, trades_queue, processed_events),
-      engine(event_queue, processed_events, orderbook, logger),
-      tcpserver(event_queue, execution_report) {}
+Exchange<config>::Exchange(const settings::Settings &s)
+    : settings(checked(s)), event_queue(settings.event_queue_capacity),
+      engine_output(settings.output_ring_capacity), orderbook(settings),
+      logger(event_queue, engine_output, journal, trade_log),
+      engine(event_queue, orderbook, logger, market_data),
+      tcpserver(event_queue, engine_output, dispatch, settings) {}
+
+template <TachyonConfig config>
+auto Exchange<config>::footprint(const settings::Settings &s) -> size_t {
+  size_t bytes =
+      OrderBook<config>::footprint(s) + TcpServer<config>::footprint(s);
+  if constexpr (requires { config::EventQueue::bytes_for(0); }) {
+    bytes += config::EventQueue::bytes_for(s.event_queue_capacity);
+  }
+  if constexpr (requires { config::OutputRing::bytes_for(0); }) {
+    bytes += config::OutputRing::bytes_for(s.output_ring_capacity);
+  }
+  return bytes;
+}
+
+template <TachyonConfig config>
+auto Exchange<config>::checked(const settings::Settings &s)
+    -> settings::Settings {
+  try {
+    settings::validate(s);
+  } catch (const std::invalid_argument &e) {
+    throw std::runtime_error(std::string("settings: ") + e.what());
+  }
+  numa::Topology topology = numa::Topology::read();
+  for (int node : {s.engine_node, s.gateway_node}) {
+    if (node != settings::NO_NODE && topology.find(node) == nullptr) {
+      std::string nodes = topology.describe();
+      nodes.pop_back(); // the last line's newline.
+      throw std::runtime_error("settings: there is no NUMA node " +
+                               std::to_string(node) + ", this machine has\n" +
+                               nodes);
+    }
+  }
+  size_t bytes = footprint(s);
+  if (s.memory_budget != 0 && bytes > s.memory_budget) {
+    throw std::runtime_error("settings need " + std::to_string(bytes) +
+                             " bytes, over the memory budget of " +
+                             std::to_string(s.memory_budget));
+  }
+  std::cout << "Allocating " << (bytes >> 20) << " MiB up front\n";
+  return s;
+}
+
+template <TachyonConfig config> void Exchange<config>::place() {
+  bool consumer = settings.queue_placement == settings::QueuePlacement::CONSUMER;
+  int event_queue_node = consumer ? engineNode() : gatewayNode();
+  int output_ring_node = consumer ? gatewayNode() : engineNode();
+  auto where = [](int node) {
+    return node == settings::NO_NODE ? std::string("any node")
+                                     : "node " + std::to_string(node);
+  };
+  std::cout << "NUMA topology:\n" << topology.describe();
+  std::cout << "Engine thread, book and log writers on "
+            << where(engineNode()) << ", receive and dispatcher threads on "
+            << where(gatewayNode()) << ", event queue on "
+            << where(event_queue_node) << ", output ring on "
+            << where(output_ring_node) << "\n";
+  bool placed = numa::place(event_queue, event_queue_node);
+  placed = numa::place(engine_output, output_ring_node) && placed;
+  placed = numa::place(orderbook, engineNode()) && placed;
+  if (!placed) {
+    std::cerr << "numa: the kernel refused to place some tables, they are "
+                 "wherever they were first touched\n";
+  }
+}
 
 template <TachyonConfig config> void Exchange<config>::init() {
-  tcpserver.init("12345");
+  tsc::calibrate(); // before any thread stamps anything.
+  place();
+  // How the big tables ended up backed: no explicit pages reserved, or THP
+  // off, and they are on ordinary pages with nothing said at runtime.
+  for (size_t b = 0; b < huge::BACKINGS; b++) {
+    size_t bytes = huge::mapped[b].load(std::memory_order_relaxed);
+    if (bytes != 0) {
+      std::cout << "Huge page tables: " << (bytes >> 20) << " MiB on "
+                << huge::BACKING_NAMES[b] << "\n";
+    }
+  }
+  tcpserver.init(settings.port);
+  tcpserver.initShm(shm::GATEWAY_PATH);
+  // Depths are read from the exporter's thread, nobody on the hot path
+  // spends time on them.
+  metrics::registry().sample(metrics::Gauge::EVENT_QUEUE_DEPTH,
+                             [this] { return event_queue.size(); });
+  metrics::registry().sample(metrics::Gauge::OUTPUT_BACKLOG,
+                             [this] { return engine_output.backlog(); });
+  if constexpr (requires { event_queue.memory(); }) {
+    metrics::registry().sample(metrics::Gauge::EVENT_QUEUE_BYTES,
+                               [this] { return event_queue.memory().bytes; });
+  }
+  metrics::registry().sample(metrics::Gauge::OUTPUT_RING_BYTES, [this] {
+    return engine_output.memory().bytes;
+  });
+  metrics_exporter.start();
+  for (size_t t = 0; t < static_cast<size_t>(watchdog::Thread::COUNT); t++) {
+    watchdog.watch(static_cast<watchdog::Thread>(t));
+  }
+  if constexpr (requires { event_queue.high_water_mark(); }) {
+    watchdog.watch(
+        "event_queue", event_queue.capacity(),
+        [this] { return event_queue.size(); },
+        [this] { return event_queue.high_water_mark(); });
+  }
+  // What used to be the processed event, trade and report queues are now
+  // each a consumer's stretch of the output ring.
+  for (auto [name, id] : {std::pair{"journal", journal},
+                          std::pair{"trade_log", trade_log},
+                          std::pair{"dispatch", dispatch}}) {
+    watchdog.watch(
+        name, engine_output.capacity(),
+        [this, id] { return engine_output.backlog(id); },
+        [this, id] { return engine_output.high_water_mark(id); });
+  }
+  watchdog.start();
   // Should automatically use std::move.
-  engine_event_handler = std::thread(&Engine<config>::handleEvents, &engine);
-  engine_event_log_writer = std::thread(
+  engine_event_handler = numa::spawn(topology, engineNode(),
+                                     &Engine<config>::handleEvents, &engine);
+  engine_event_log_writer = numa::spawn(
+      topology, engineNode(),
       &LoggerClass<config>::writeProcessedEventsLogsContinuous, &logger);
   execution_report_dispatcher =
-      std::thread(&TcpServer<config>::dispatchData, &tcpserver);
+      numa::spawn(topology, gatewayNode(), &TcpServer<config>::dispatchData,
+                  &tcpserver);
   trades_log_writer =
-      std::thread(&LoggerClass<config>::writeTradeLogsContinuous, &logger);
-  tcpserver_recieve = std::thread(&TcpServer<config>::receiveData, &tcpserver);
+      numa::spawn(topology, engineNode(),
+                  &LoggerClass<config>::writeTradeLogsContinuous, &logger);
+  tcpserver_recieve = numa::spawn(topology, gatewayNode(),
+                                  &TcpServer<config>::receiveData, &tcpserver);
 
   std::cout << "Exchange initialised\n";
 }
 
 template <TachyonConfig config> void Exchange<config>::run() {
+  alloc::set_phase(alloc::Phase::STEADY);
   start_exchange.store(true, std::memory_order_release);
   std::cout << "Exchange has opened\n";
   start = std::chrono::steady_clock::now();
@@ -42,6 +168,8 @@ template <TachyonConfig config> void Exchange<config>::run() {
 template <TachyonConfig config> Exchange<config>::~Exchange() = default;
 
 template <TachyonConfig config> void Exchange<config>::stop() {
+  watchdog.stop(); // before the threads stop beating.
+  alloc::set_phase(alloc::Phase::SHUTDOWN);
   keep_running.store(false);
   std::cout << "Exchange has closed\n";
   /* for (auto& client_order : client_threads) {
@@ -52,6 +180,10 @@ template <TachyonConfig config> void Exchange<config>::stop() {
   // execution_report_dispatcher.join();
   trades_log_writer.join();
   tcpserver_recieve.join();
+  metrics_exporter.stop();
+  // The dispatcher isn't joined, its newest records may be cut short.
+  TRACE_DUMP(trace::FILE_PATH);
+  alloc::report();
 }
 
 template class Exchange<my_config>;
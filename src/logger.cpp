@@ -1,31 +1,31 @@
 #include "engine/logger.hpp"
 #include "engine/constants.hpp"
 #include "my_config.hpp"
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/clock.hpp"
+#include "telemetry/watchdog.hpp"
 #include <fstream>
-#include <malloc.h>
+#include <thread>
 
 extern std::atomic<bool> start_exchange;
 extern std::atomic<bool> keep_running;
 
 template <TachyonConfig config>
 LoggerClass<config>::LoggerClass(config::EventQueue &ev_queue,
-                                 config::ExecReportQueue &exec_queue,
-                                 config::TradesQueue &tr_queue,
-                                 config::EventQueue &prcs_events)
-    : event_queue(ev_queue), execution_reports(exec_queue), trades(tr_queue),
-      processed_events(prcs_events) {
+                                 config::OutputRing &engine_output,
+                                 consumer_id journal_consumer,
+                                 consumer_id trade_log_consumer)
+    : event_queue(ev_queue), output(engine_output), journal(journal_consumer),
+      trade_log(trade_log_consumer) {
 
   // Getting ready for later logging.
   // Writing Processed events.
-  std::ofstream file;
-  file.open("logs/processed_events.txt", std::ios ::out);
-  file << "Processed Events by Engine\n";
-  file.close();
+  events_file.open("logs/processed_events.txt", std::ios ::out);
+  events_file << "Processed Events by Engine\n";
 
   // Writing trades.
-  file.open("logs/processed_trades.txt", std::ios::out);
-  file << "Processed Trades\n";
-  file.close();
+  trades_file.open("logs/processed_trades.txt", std::ios::out);
+  trades_file << "Processed Trades\n";
 }
 
 template <TachyonConfig config> LoggerClass<config>::~LoggerClass() {
@@ -34,171 +34,253 @@ template <TachyonConfig config> LoggerClass<config>::~LoggerClass() {
 }
 
 template <TachyonConfig config>
-void LoggerClass<config>::logTrade(Trade &trade, ClientRequest &resting,
-                                   ClientRequest &incoming,
+auto LoggerClass<config>::claimOutput() -> EngineOutput * {
+  EngineOutput *out;
+  while ((out = output.claim()) == nullptr) {
+    // The stages can't free anything they can't see. About to be seen,
+    // done or not; it is as done as it gets for now.
+    publishHeld(tsc::now());
+    // Waiting for the slowest stage. Nothing drains the ring once the
+    // exchange is stopping, so from then on output is dropped.
+    if (!keep_running.load(std::memory_order_relaxed)) {
+      last_output = nullptr;
+      return nullptr;
+    }
+    std::this_thread::yield();
+  }
+  out->ends_request = false;
+  last_output = out;
+  return out;
+}
+
+template <TachyonConfig config>
+auto LoggerClass<config>::claimReport() -> ExecutionReport * {
+  EngineOutput *out = claimOutput();
+  if (out == nullptr) {
+    return nullptr;
+  }
+  out->type = OutputType::REPORT;
+  out->report = ExecutionReport{};
+  return &out->report;
+}
+
+template <TachyonConfig config>
+void LoggerClass<config>::publishHeld(TimeStamp done) {
+  for (uint64_t seq = output.flushed(); seq < output.committed(); seq++) {
+    if (output[seq].type == OutputType::EVENT) {
+      output[seq].completed = done;
+    }
+  }
+  output.flush();
+}
+
+template <TachyonConfig config>
+void LoggerClass<config>::flush(TimeStamp done) {
+  last_output = nullptr;
+  publishHeld(done);
+}
+
+template <TachyonConfig config>
+void LoggerClass<config>::logEvent(ClientRequest &incoming) {
+  EngineOutput *out = claimOutput();
+  if (out == nullptr) {
+    return;
+  }
+  out->type = OutputType::EVENT;
+  out->event = record_of(incoming);
+  out->completed = 0; // stamped when published.
+  output.commit();
+}
+
+template <TachyonConfig config>
+void LoggerClass<config>::finishEvent() {
+  // Only a full ring publishes mid request, and it does so before claiming,
+  // so the last entry is still unpublished.
+  if (last_output != nullptr) {
+    last_output->ends_request = true;
+    last_output = nullptr;
+  }
+}
+
+template <TachyonConfig config>
+void LoggerClass<config>::logTrade(const Trade &trade,
+                                   const ClientRequest &resting,
+                                   const ClientRequest &incoming,
                                    Quantity trade_quantity) {
-  //  NOTE: if needed for performance, we may reconstruct trade object and not
-  //  accept it as parameter.
-  trades.push(trade);
-  ExecutionReport exec_report{};
-
-  exec_report.client_id = incoming.client_id;
-  exec_report.order_id = incoming.new_order.order_id;
-  exec_report.price = resting.new_order.price;
-  exec_report.last_quantity = trade_quantity; // Quantity traded
-  exec_report.remaining_quantity = incoming.new_order.quantity;
-  exec_report.type = ExecType::TRADE;
-  exec_report.side = incoming.new_order.side;
-  execution_reports.push(exec_report);
-
-  exec_report.client_id = resting.client_id;
-  exec_report.order_id = resting.new_order.order_id;
-  exec_report.price = resting.new_order.price;
-  exec_report.last_quantity = trade_quantity;
-  exec_report.remaining_quantity = resting.new_order.quantity;
-  exec_report.type = ExecType::TRADE;
-  exec_report.side = resting.new_order.side;
-  execution_reports.push(exec_report);
+  // Only what the reports need is stored here, the dispatcher builds them.
+  EngineOutput *out = claimOutput();
+  if (out == nullptr) {
+    return;
+  }
+  out->type = OutputType::FILL;
+  out->fill = {trade.maker_order_id,
+               trade.taker_order_id,
+               resting.client_id,
+               incoming.client_id,
+               trade.time_stamp,
+               trade.price,
+               trade_quantity,
+               resting.new_order.quantity,
+               incoming.new_order.quantity,
+               trade.aggressor_side};
+  output.commit();
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::logSelfTrade(ClientRequest &incoming) {
-  ExecutionReport report{};
-  report.client_id = incoming.client_id;
-  report.last_quantity = 0;
-  report.remaining_quantity = incoming.new_order.quantity;
-  report.price = incoming.new_order.price;
-  report.order_id = incoming.new_order.order_id;
-  report.type = ExecType::REJECTED;
-  report.reason = RejectReason::SELF_TRADE;
-  report.side = incoming.new_order.side;
+  ExecutionReport *report = claimReport();
+  if (report == nullptr) {
+    return;
+  }
+  report->client_id = incoming.client_id;
+  report->last_quantity = 0;
+  report->remaining_quantity = incoming.new_order.quantity;
+  report->price = incoming.new_order.price;
+  report->order_id = incoming.new_order.order_id;
+  report->type = ExecType::REJECTED;
+  report->reason = RejectReason::SELF_TRADE;
+  report->side = incoming.new_order.side;
 
-  execution_reports.push(report);
+  output.commit();
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::logCancelOrder(ClientRequest &incoming) {
-  ExecutionReport exec_report{};
-  exec_report.client_id = incoming.client_id;
-  exec_report.order_id = incoming.new_order.order_id;
-  exec_report.price = incoming.new_order.price;
-  exec_report.last_quantity = 0;
-  exec_report.remaining_quantity = incoming.new_order.quantity;
-  exec_report.type = ExecType::CANCELED;
-  exec_report.side = incoming.new_order.side;
-  execution_reports.push(exec_report);
+  ExecutionReport *exec_report = claimReport();
+  if (exec_report == nullptr) {
+    return;
+  }
+  exec_report->client_id = incoming.client_id;
+  exec_report->order_id = incoming.new_order.order_id;
+  exec_report->price = incoming.new_order.price;
+  exec_report->last_quantity = 0;
+  exec_report->remaining_quantity = incoming.new_order.quantity;
+  exec_report->type = ExecType::CANCELED;
+  exec_report->side = incoming.new_order.side;
+  output.commit();
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::logInvalidOrder(ClientRequest &incoming) {
-  ExecutionReport exec_report{};
-  exec_report.client_id = incoming.client_id;
-  exec_report.order_id = incoming.new_order.order_id;
-  exec_report.price = incoming.new_order.price;
-  exec_report.last_quantity = 0;
-  exec_report.remaining_quantity = incoming.new_order.quantity;
-  exec_report.type = ExecType::REJECTED;
-  exec_report.reason = RejectReason::INVALID_ORDER_TYPE;
-  exec_report.side = incoming.new_order.side;
-  execution_reports.push(exec_report);
+  ExecutionReport *exec_report = claimReport();
+  if (exec_report == nullptr) {
+    return;
+  }
+  exec_report->client_id = incoming.client_id;
+  exec_report->order_id = incoming.new_order.order_id;
+  exec_report->price = incoming.new_order.price;
+  exec_report->last_quantity = 0;
+  exec_report->remaining_quantity = incoming.new_order.quantity;
+  exec_report->type = ExecType::REJECTED;
+  exec_report->reason = RejectReason::INVALID_ORDER_TYPE;
+  exec_report->side = incoming.new_order.side;
+  output.commit();
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::logNotFound(ClientRequest &incoming) {
-  ExecutionReport exec_report{};
-  exec_report.client_id = incoming.client_id;
-  exec_report.order_id = incoming.order_id_to_cancel;
-  exec_report.price = 0;
-  exec_report.last_quantity = 0;
-  exec_report.remaining_quantity = 0;
-  exec_report.type = ExecType::REJECTED;
-  exec_report.reason = RejectReason::ORDER_NOT_FOUND;
-  execution_reports.push(exec_report);
+  ExecutionReport *exec_report = claimReport();
+  if (exec_report == nullptr) {
+    return;
+  }
+  exec_report->client_id = incoming.client_id;
+  exec_report->order_id = incoming.order_id_to_cancel;
+  exec_report->price = 0;
+  exec_report->last_quantity = 0;
+  exec_report->remaining_quantity = 0;
+  exec_report->type = ExecType::REJECTED;
+  exec_report->reason = RejectReason::ORDER_NOT_FOUND;
+  output.commit();
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::logNewOrder(ClientRequest &incoming) {
-  ExecutionReport exec_report{};
-  exec_report.client_id = incoming.client_id;
-  exec_report.order_id = incoming.new_order.order_id;
-  exec_report.price = incoming.new_order.price;
-  exec_report.last_quantity = 0;
-  exec_report.remaining_quantity = incoming.new_order.quantity;
-  exec_report.type = ExecType::NEW;
-  exec_report.side = incoming.new_order.side;
-  execution_reports.push(exec_report);
-}
-
-template <TachyonConfig config>
-void LoggerClass<config>::writeProcessedEventsLogs() {
-  std::ofstream processed_requests_file;
-  processed_requests_file.open("logs/processed_events.txt", std::ios::app);
-  ClientRequest event{};
-  uint32_t before_size = processed_events.size();
-  for (uint32_t i = 0; i < before_size;
-       i++) { // At least MAX PROCESSED events must be there.
-    processed_events.try_pop(event);
-    processed_requests_file << "Client " << event.client_id << ": ";
+  ExecutionReport *exec_report = claimReport();
+  if (exec_report == nullptr) {
+    return;
+  }
+  exec_report->client_id = incoming.client_id;
+  exec_report->order_id = incoming.new_order.order_id;
+  exec_report->price = incoming.new_order.price;
+  exec_report->last_quantity = 0;
+  exec_report->remaining_quantity = incoming.new_order.quantity;
+  exec_report->type = ExecType::NEW;
+  exec_report->side = incoming.new_order.side;
+  output.commit();
+}
+
+// Writes out every event the journal hasn't yet, straight from the ring.
+template <TachyonConfig config>
+auto LoggerClass<config>::writeProcessedEventsLogs() -> bool {
+  uint64_t from = output.position(journal);
+  uint64_t to = output.available(journal);
+  for (uint64_t seq = from; seq < to; seq++) {
+    const EngineOutput &out = output[seq];
+    if (out.type != OutputType::EVENT) {
+      continue;
+    }
+    const RequestRecord &event = out.event;
+    events_file << "Client " << event.client_id << ": ";
     if (event.type == RequestType::New) {
-      processed_requests_file
-          << "ORDER ID " << event.new_order.order_id << " "
-          << (event.new_order.side == Side::BID ? "BUY " : "SELL ")
-          << event.new_order.quantity << " @ " << event.new_order.price << " "
-          << (event.new_order.order_type == OrderType::LIMIT ? "LIMIT "
-                                                             : "MARKET ")
-          << (event.new_order.tif == TimeInForce::GTC ? "GTC " : "IOC ")
-          << "TIMESTAMP-" << event.time_stamp << "\n";
+      events_file << "ORDER ID " << event.new_order.order_id << " "
+                  << (event.new_order.side == Side::BID ? "BUY " : "SELL ")
+                  << event.new_order.quantity << " @ "
+                  << event.new_order.price << " "
+                  << (event.new_order.order_type == OrderType::LIMIT
+                          ? "LIMIT "
+                          : "MARKET ")
+                  << (event.new_order.tif == TimeInForce::GTC ? "GTC " : "IOC ")
+                  << "TIMESTAMP-" << event.time_stamp << "\n";
     } else if (event.type == RequestType::Cancel) {
-      processed_requests_file << "CANCEL " << " ORDER ID "
-                              << event.order_id_to_cancel << " TIMESTAMP-"
-                              << event.time_stamp << "\n";
+      events_file << "CANCEL " << " ORDER ID " << event.order_id_to_cancel
+                  << " TIMESTAMP-" << event.time_stamp << "\n";
     }
   }
-  processed_requests_file.close();
+  output.release(journal, to);
+  return from != to;
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::writeProcessedEventsLogsContinuous() {
+  alloc::name_thread("journal");
   while (!start_exchange.load(std::memory_order_acquire)) {
     std::this_thread::yield();
   }
   while (keep_running.load(std::memory_order_relaxed)) {
-    if (processed_events.size() >= MAX_PROCESSED_EVENTS_SIZE) {
-      writeProcessedEventsLogs();
+    watchdog::beat(watchdog::Thread::JOURNAL);
+    if (!writeProcessedEventsLogs()) {
+      std::this_thread::yield();
     }
   }
 }
 
-template <TachyonConfig config> void LoggerClass<config>::writeTradeLogs() {
-  std::ofstream file;
-  // Writing trades.
-  file.open("logs/processed_trades.txt", std::ios::app);
-  Trade trade{};
-  for (uint32_t i = 0; i < MAX_TRADES_QUEUE_SIZE; i++) {
-    if (trades.try_pop( // This should succeed.
-            trade)) {   // Note: trades qeueue will automatically
-                        // be cleared by this mechanism.
-      file << "MAKER: " << trade.maker_order_id
-           << " TAKER: " << trade.taker_order_id << " " << trade.quantity
-           << " @ " << trade.price << " TIMESTAMP-" << trade.time_stamp << "\n";
-    } else {
-      std::this_thread::yield();
+template <TachyonConfig config> auto LoggerClass<config>::writeTradeLogs() -> bool {
+  uint64_t from = output.position(trade_log);
+  uint64_t to = output.available(trade_log);
+  for (uint64_t seq = from; seq < to; seq++) {
+    const EngineOutput &out = output[seq];
+    if (out.type != OutputType::FILL) {
+      continue;
     }
+    Trade trade = trade_of(out.fill);
+    trades_file << "MAKER: " << trade.maker_order_id
+                << " TAKER: " << trade.taker_order_id << " " << trade.quantity
+                << " @ " << trade.price << " TIMESTAMP-" << trade.time_stamp
+                << "\n";
   }
-
-  file.close();
+  output.release(trade_log, to);
+  return from != to;
 }
 
 template <TachyonConfig config>
 void LoggerClass<config>::writeTradeLogsContinuous() {
+  alloc::name_thread("trade_log");
   while (!start_exchange.load(std::memory_order_acquire)) {
     std::this_thread::yield();
   }
   while (keep_running.load(std::memory_order_relaxed)) {
-    if (trades.size() == MAX_TRADES_QUEUE_SIZE) {
-      writeTradeLogs();
-      malloc_trim(0);
-    } else {
+    watchdog::beat(watchdog::Thread::TRADE_LOG);
+    if (!writeTradeLogs()) {
       std::this_thread::yield();
     }
   }
@@ -1,10 +1,23 @@
 #include "engine/concepts.hpp"
 #include "my_config.hpp"
 #include "network/client.hpp"
+#include <string>
 #include <thread>
 
-auto main() -> int {
+auto main(int argc, char **argv) -> int {
   int num_clients = 4;
+  // "--v2" switches the bots to the framed protocol, "--shm" connects them
+  // through the gateway's shared memory file instead of TCP.
+  uint8_t protocol = PROTOCOL_V1;
+  bool use_shm = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--v2") {
+      protocol = PROTOCOL_V2;
+    } else if (arg == "--shm") {
+      use_shm = true;
+    }
+  }
   std::vector<Client<my_config> *> clients;
   std::vector<std::thread> exchange_data;
   std::vector<std::thread> generate_orders;
@@ -12,7 +25,11 @@ auto main() -> int {
   for (int i = 0; i < num_clients; i++) {
     auto *new_client = new Client<my_config>();
     clients.push_back(new_client);
-    new_client->init("localhost", "12345");
+    if (use_shm) {
+      new_client->initShm(shm::GATEWAY_PATH, protocol);
+    } else {
+      new_client->init("localhost", "12345", protocol);
+    }
     exchange_data.emplace_back(&Client<my_config>::moveData, new_client);
     generate_orders.emplace_back(&Client<my_config>::generateOrders,
                                  new_client);
@@ -5,28 +5,42 @@
 #include <cstdint>
 #include <engine/concepts.hpp>
 #include <engine/exchange.hpp>
+#include <engine/settings.hpp>
+#include <exception>
+#include <iostream>
 #include <ratio>
+#include <telemetry/alloc_tracker.hpp>
 
 std::atomic<bool> keep_running(true);
 
 // Signal handler for Ctrl + C
 
-auto main() -> int {
+// tachyon [settings file], tachyon.conf by default; without one the
+// built in defaults are used.
+auto main(int argc, char **argv) -> int {
   // The main entry point of our simulation.
+  alloc::name_thread("main");
 
-  uint32_t duration = 50000; // Running duration in ms.
-  Exchange<my_config> exchange;
-  // exchange.addClients(4);
-  exchange.init();
-  auto start = std::chrono::steady_clock::now();
-  exchange.run();
-  auto end = std::chrono::steady_clock::now();
-  while (true) {
-    end = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
-            .count() > duration) {
-      exchange.stop();
-      break;
+  try {
+    settings::Settings config =
+        argc > 1 ? settings::load(argv[1]) : settings::load_or_defaults();
+    uint64_t duration = config.duration_ms; // Running duration in ms.
+    Exchange<my_config> exchange(config);   // checks the memory budget.
+    // exchange.addClients(4);
+    exchange.init();
+    auto start = std::chrono::steady_clock::now();
+    exchange.run();
+    auto end = std::chrono::steady_clock::now();
+    while (true) {
+      end = std::chrono::steady_clock::now();
+      if (std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+              .count() > static_cast<int64_t>(duration)) {
+        exchange.stop();
+        break;
+      }
     }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
   }
 }
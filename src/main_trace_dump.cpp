@@ -0,0 +1,47 @@
+#include "telemetry/trace.hpp"
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts the exchange's trace dump into Chrome trace JSON.
+//   trace_dump [trace file] [json file] [--order ID]
+// Defaults to logs/trace.bin and logs/trace.json. "--order" keeps only the
+// records of one order, its path from the gateway to the dispatcher.
+auto main(int argc, char **argv) -> int {
+  std::string in = trace::FILE_PATH;
+  std::string out = "logs/trace.json";
+  uint64_t order = 0;
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--order" && i + 1 < argc) {
+      order = std::stoull(argv[++i]);
+    } else if (positional == 0) {
+      in = arg;
+      positional++;
+    } else {
+      out = arg;
+    }
+  }
+
+  std::vector<trace::ThreadTrace> threads;
+  if (!trace::load(in, threads)) {
+    std::cerr << "Can't read trace file " << in << "\n";
+    return 1;
+  }
+  std::ofstream file(out);
+  file << trace::to_chrome_json(threads, order);
+  if (!file) {
+    std::cerr << "Can't write " << out << "\n";
+    return 1;
+  }
+  size_t records = 0;
+  for (const trace::ThreadTrace &thread : threads) {
+    records += thread.records.size();
+  }
+  std::cout << records << " records from " << threads.size()
+            << " threads written to " << out << "\n";
+  return 0;
+}
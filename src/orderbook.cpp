@@ -15,27 +15,29 @@
 template <TachyonConfig config>
 void OrderBook<config>::add(ClientRequest &incoming) {
   // TODO: Make it return boolean for invalid orders?
-  Price book_price =
-      incoming.new_order.price - CLIENT_BASE_PRICE -
-      (CLIENT_PRICE_DISTRIB_MIN); // price_distrib_min is negative.
+  Price book_price = incoming.new_order.price - min_price;
   // NOTE: we use an arena otheriwse objects are destroyed.
   if (book_price < 0 || book_price >= bids.size()) {
     // TODO: make proper logging instead of throwing.
     throw std::out_of_range("Price invalid");
   }
 
+  TRACE_INSTANT(BOOK_ADD, incoming.new_order.order_id);
   uint32_t allotted_index = arena.allocateSlot(incoming);
+  resting++;
   OrderId order_id =
       incoming.new_order.order_id; // NOTE: directly binding gives some error.
   arena_idx.insert({order_id, allotted_index});
 
   if (incoming.new_order.side == Side::BID) {
+    live_levels += bids[book_price].size() == 0;
     bids[book_price].push_back(
         arena[arena_idx.at(incoming.new_order.order_id)].clr);
     intrusive_list<ClientRequest>::iterator it = bids[book_price].end();
     it--;
     list_idx.insert({order_id, {Side::BID, book_price, it}});
   } else {
+    live_levels += asks[book_price].size() == 0;
     asks[book_price].push_back(
         arena[arena_idx.at(incoming.new_order.order_id)].clr);
 
@@ -49,17 +51,9 @@ template <TachyonConfig config>
 void OrderBook<config>::match(
     ClientRequest &incoming,
     std::vector<std::pair<Trade, ClientRequest>> &trades) {
-  if (incoming.new_order.side == Side::BID) {
-    matchImplementation(
-        incoming, asks,
-        [](Price p_sell, Price p_buy) -> bool { return (p_buy >= p_sell); },
-        trades);
-  } else {
-    matchImplementation(
-        incoming, bids,
-        [](Price p_buy, Price p_sell) -> bool { return (p_buy >= p_sell); },
-        trades);
-  }
+  match(incoming, [&trades](Trade &trade, const ClientRequest &resting) {
+    trades.push_back({trade, resting});
+  });
 }
 
 template <TachyonConfig config>
@@ -68,6 +62,7 @@ auto OrderBook<config>::cancelOrder(OrderId order_id, ClientRequest &to_cancel)
   if (!list_idx.contains(order_id)) {
     return false;
   }
+  TRACE_INSTANT(BOOK_CANCEL, order_id);
   auto [side, price, it] = list_idx.at(order_id);
 
   if (side == Side::BID) {
@@ -78,9 +73,11 @@ auto OrderBook<config>::cancelOrder(OrderId order_id, ClientRequest &to_cancel)
     }
     to_cancel = *it;
     bids[price].erase(it);
+    live_levels -= bids[price].size() == 0;
     arena.freeSlot(arena_idx.at(order_id)); // Free a slot.
     arena_idx.erase(order_id);              // Also erase it's map.
     list_idx.erase(order_id);
+    resting--;
     return true;
   }
   if (side == Side::ASK) {
@@ -92,9 +89,11 @@ auto OrderBook<config>::cancelOrder(OrderId order_id, ClientRequest &to_cancel)
 
     to_cancel = *it;
     asks[price].erase(it);
+    live_levels -= asks[price].size() == 0;
     arena.freeSlot(arena_idx.at(order_id)); // Free a slot.
     arena_idx.erase(order_id);              // Also erase it's map.
     list_idx.erase(order_id);
+    resting--;
     return true;
   }
   return false;
@@ -7,14 +7,15 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/epoll.h>
+#include <sys/random.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
-#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -24,11 +25,19 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <utility>
 
 #include "engine/concepts.hpp"
 #include "engine/types.hpp"
 #include "my_config.hpp"
 #include "network/serialise.hpp"
+#include "network/serialise_batch.hpp"
+#include "network/serialise_v2.hpp"
+#include "telemetry/alloc_tracker.hpp"
+#include "telemetry/clock.hpp"
+#include "telemetry/metrics.hpp"
+#include "telemetry/trace.hpp"
+#include "telemetry/watchdog.hpp"
 
 extern std ::atomic<bool> keep_running;
 
@@ -40,10 +49,42 @@ void TcpServer<config>::setNonBlocking(int file_descriptor) {
 
 template <TachyonConfig config>
 TcpServer<config>::TcpServer(config::EventQueue &event_queue,
-                             config::ExecReportQueue &execution_reports)
-    : event_queue(event_queue), execution_reports(execution_reports),
-      client_map(16) {
+                             config::OutputRing &engine_output,
+                             consumer_id dispatch_consumer,
+                             const settings::Settings &settings)
+    : event_queue(event_queue), engine_output(engine_output),
+      dispatch_consumer(dispatch_consumer),
+      client_map(settings.connection_table_size),
+      connection_pool(settings.connections),
+      buffer_bytes(settings.connection_buffer_bytes),
+      sessions(settings.connection_table_size),
+      session_pool(settings.connections),
+      max_sessions(settings.max_sessions != 0 ? settings.max_sessions
+                                              : settings.connection_table_size),
+      grace_ns(settings.session_grace_ms * 1000000) {
   next_id.store(1);
+  // The first chunk's buffers are sized now rather than on first use.
+  std::vector<Connection *> first(connection_pool.available());
+  for (Connection *&conn : first) {
+    conn = acquireConnection();
+  }
+  for (size_t i = first.size(); i > 0; i--) {
+    connection_pool.release(first[i - 1]); // back in the same order.
+  }
+  session_pool.release(acquireSession()); // counts the first chunk.
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::footprint(const settings::Settings &settings)
+    -> size_t {
+  size_t bytes = settings.connections *
+                 (sizeof(Connection) + 2 * settings.connection_buffer_bytes +
+                  Session::bytes_for());
+  bytes += decltype(sessions)::bytes_for(settings.connection_table_size);
+  if constexpr (requires { config::ClientMap::bytes_for(0); }) {
+    bytes += config::ClientMap::bytes_for(settings.connection_table_size);
+  }
+  return bytes;
 }
 
 template <TachyonConfig config>
@@ -100,6 +141,12 @@ void TcpServer<config>::init(
   std::cout << "Server initialised. Waiting for connections.\n";
 }
 
+template <TachyonConfig config>
+void TcpServer<config>::initShm(std::string path) {
+  shm_region = shm::create_region(path);
+  std::cout << "Shared memory sessions at " << path << "\n";
+}
+
 // designed to run on a single thread to accept orders.
 
 template <TachyonConfig config> void TcpServer<config>::receiveData() {
@@ -116,11 +163,34 @@ template <TachyonConfig config> void TcpServer<config>::receiveData() {
     throw std::runtime_error("epoll_ctl: listen_fd");
   }
   std::cout << "Engine event loop started\n";
+  TRACE_THREAD("gateway");
+  alloc::name_thread("gateway");
 
+  unsigned shm_passes = 0;
   while (keep_running.load()) {
-
+    watchdog::beat(watchdog::Thread::GATEWAY);
+    // Wake up periodically while retired connections and expired sessions
+    // wait for reclamation, and now and then while sessions are idle.
+    bool reclaiming = !retired.empty() || retiring > 0 ||
+                      !closing_slots.empty() || !expired.empty();
+    int timeout = reclaiming       ? RECLAIM_INTERVAL_MS
+                  : !idle.empty() ? SESSION_SWEEP_MS
+                                  : -1;
+    if (shm_region != nullptr) {
+      // Shared memory sessions are polled. While any is open we spin on
+      // them and keep the epoll syscall off that path.
+      shm_passes++;
+      pollShm(epoll_fd, shm_passes % SHM_LIVENESS_INTERVAL == 0);
+      if (active_shm > 0 && shm_passes % SOCKET_POLL_INTERVAL != 0) {
+        continue;
+      }
+      timeout = active_shm > 0 ? 0 : SHM_IDLE_POLL_MS;
+    }
+    if (timeout != 0) {
+      watchdog::wait(watchdog::Thread::GATEWAY); // no clients is no stall.
+    }
     int n_ready_fds = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS,
-                                 -1); // Partially blocking call..
+                                 timeout); // Partially blocking call..
 
     if (n_ready_fds == -1) {
       perror("epoll_wait");
@@ -131,12 +201,12 @@ template <TachyonConfig config> void TcpServer<config>::receiveData() {
         handleNewConnection(evt, epoll_fd);
       } else {
         // data from existing client.
-        auto *conn =
-            (ClientConnection<typename config::RxBufferType,
-                              typename config::TxBufferType> *)events[i]
-                .data.ptr;
-        uint8_t temp_buff[MAX_TEMP_BUFF_SIZE];
-        ssize_t bytes_read = recv(conn->fd, temp_buff, sizeof(temp_buff), 0);
+        auto *conn = static_cast<Connection *>(events[i].data.ptr);
+        // recv straight into the tail of the rx buffer, behind whatever
+        // partial frame is left over from the last read.
+        ssize_t bytes_read =
+            recv(conn->fd, prepareCounted(conn->rx_buffer, MAX_RECV_SIZE),
+                 MAX_RECV_SIZE, 0);
 
         if (bytes_read <= 0) {
           // handle disconnect or error.
@@ -144,68 +214,358 @@ template <TachyonConfig config> void TcpServer<config>::receiveData() {
             continue; // spurious wakeup.
           }
           std::cout << "Client disconnected\n";
-          close(conn->fd);
-          // TODO: there must be a faster way for client map.
-          if (client_map.contains(conn->client_id)) {
-            client_map.erase(conn->client_id);
-          }
-          // NOTE: may release in heap use after free if deleted conn
-          // prematurely. So commented out for now. Memory leak will be there.
-          // delete conn;
+          retireConnection(conn, epoll_fd);
           continue;
         }
-        conn->rx_buffer.insert(temp_buff, bytes_read);
-
-        // drain as many full messages as possible.
-        while (conn->rx_buffer.size() > 0) {
-          uint8_t msg_type = *conn->rx_buffer.begin();
-          uint32_t expected_len = 0;
-          uint8_t *raw = conn->rx_buffer.begin();
-          if (msg_type == static_cast<uint8_t>(MessageType::ORDER_NEW)) {
-            expected_len = 1 + sizeof(Order);
-          }
+        conn->rx_buffer.commit(bytes_read);
+        metrics::add(metrics::Counter::BYTES_IN, bytes_read);
 
-          else if (msg_type ==
-                   static_cast<uint8_t>(MessageType::ORDER_CANCEL)) {
-            expected_len = 9; // Update this if cancel struct changes.
-          } else {
-            // Invalid data.
-            std::cout << "Bad client invalid data, closing\n";
-            std::cout << "Client requested msg type = "
-                      << static_cast<int>(msg_type) << "\n";
-            close(conn->fd);
-
-            if (client_map.contains(conn->client_id)) {
-              std::cout << "Client was there in hash map\n";
-              client_map.erase(conn->client_id);
-            }
-            // Bad client.
-            delete conn;
-            break;
-          }
+        // drain as many full messages as possible, decoding them in place.
+        TRACE_BEGIN(GATEWAY_RECV, bytes_read);
+        bool drained = drainRx(conn);
+        TRACE_END(GATEWAY_RECV, bytes_read);
+        if (!drained) {
+          // Bad client.
+          retireConnection(conn, epoll_fd);
+        }
+      }
+    }
+    if (!retired.empty() || retiring > 0 || !closing_slots.empty()) {
+      reclaimConnections();
+    }
+    if (!idle.empty() || !expired.empty()) {
+      expireSessions();
+    }
+  }
+}
 
-          if (conn->rx_buffer.size() < expected_len) {
-            // Not enough data yet. Wait for next call.
-            break;
-          }
-          // We have a full message!
-          uint8_t *msg_start = conn->rx_buffer.begin();
-          if (msg_type == static_cast<uint8_t>(MessageType::ORDER_NEW)) {
-            handleNewOrder(msg_start, conn->client_id);
-          }
+template <TachyonConfig config>
+auto TcpServer<config>::drainRx(Connection *conn) -> bool {
+  while (conn->rx_buffer.size() > 0) {
+    if (conn->rx_protocol == PROTOCOL_V2) {
+      return drainFrames(conn);
+    }
+    uint8_t msg_type = *conn->rx_buffer.begin();
+    size_t expected_len = GATEWAY_INBOUND_LENGTHS[msg_type];
+    if (expected_len == 0) {
+      // Invalid data.
+      std::cout << "Bad client invalid data, closing\n";
+      std::cout << "Client requested msg type = " << static_cast<int>(msg_type)
+                << "\n";
+      return false;
+    }
 
-          else if (msg_type ==
-                   static_cast<uint8_t>(MessageType::ORDER_CANCEL)) {
-            handleCancellation(msg_start, conn->client_id);
-          }
-          // nothing else should happen.
+    if (conn->rx_buffer.size() < expected_len) {
+      // Not enough data yet. Wait for next call.
+      return true;
+    }
+    // We have a full message!
+    uint8_t *msg_start = conn->rx_buffer.begin();
+    bool first_message = std::exchange(conn->fresh, false);
+    auto type = static_cast<MessageType>(msg_type);
+    if (first_message && type != MessageType::LOGIN_RESUME &&
+        !sessions.contains(conn->client_id)) {
+      std::cout << "Session limit reached, closing\n";
+      metrics::add(metrics::Counter::SESSIONS_REFUSED);
+      return false;
+    }
+    switch (type) {
+    case MessageType::ORDER_NEW:
+      handleNewOrder(msg_start, conn->client_id, PROTOCOL_V1);
+      break;
+    case MessageType::ORDER_CANCEL:
+      handleCancellation(msg_start, conn->client_id, PROTOCOL_V1);
+      break;
+    case MessageType::PROTOCOL_SELECT: {
+      uint8_t version = deserialise_protocol_select(msg_start);
+      if (version != PROTOCOL_V1 && version != PROTOCOL_V2) {
+        std::cout << "Client asked for unknown protocol " << int(version)
+                  << ", closing\n";
+        return false;
+      }
+      // Everything after this message is in the new version. The dispatcher
+      // picks the switch up with the next report it writes.
+      conn->rx_protocol = version;
+      conn->protocol.store(version, std::memory_order_release);
+      break;
+    }
+    case MessageType::LOGIN_RESUME:
+      // Only before anything was sent under the provisional id.
+      if (!first_message || !handleResume(conn, msg_start)) {
+        return false;
+      }
+      break;
+    case MessageType::SESSION_TOKEN:
+      // Only before anything that could be reported on, so it goes out
+      // right behind the login response. The dispatcher writes it.
+      if (!first_message) {
+        std::cout << "Client asked for its session token late, closing\n";
+        return false;
+      }
+      conn->token_owed.store(true, std::memory_order_release);
+      kick(conn->client_id);
+      break;
+    default:
+      break; // the length table only lets the types above through.
+    }
 
-          // erase old data.
-          conn->rx_buffer.erase(expected_len);
-        }
+    // erase old data.
+    conn->rx_buffer.erase(expected_len);
+  }
+  return true;
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::drainFrames(Connection *conn) -> bool {
+  while (conn->rx_buffer.size() >= FRAME_HEADER_LEN) {
+    const uint8_t *frame = conn->rx_buffer.begin();
+    FrameHeader header = read_frame_header(frame);
+    if (!valid_frame_header(header) ||
+        (header.type != MessageType::ORDER_NEW &&
+         header.type != MessageType::ORDER_CANCEL)) {
+      std::cout << "Bad client invalid frame, closing\n";
+      return false;
+    }
+    if (header.sequence != conn->rx_sequence) {
+      std::cout << "Client sequence gap: expected " << conn->rx_sequence
+                << " got " << header.sequence << ", closing\n";
+      return false;
+    }
+    if (conn->rx_buffer.size() < header.length) {
+      return true; // wait for the rest of the frame.
+    }
+    // Fixed stride, the header already told us how far to go.
+    size_t stride = frame_payload_size(header.type);
+    const uint8_t *payload = frame + FRAME_HEADER_LEN;
+    if (header.type == MessageType::ORDER_NEW) {
+      for (uint8_t i = 0; i < header.count; i++, payload += stride) {
+        handleNewOrder(payload, conn->client_id, PROTOCOL_V2);
+      }
+    } else {
+      for (uint8_t i = 0; i < header.count; i++, payload += stride) {
+        handleCancellation(payload, conn->client_id, PROTOCOL_V2);
       }
     }
+    conn->rx_sequence += header.count;
+    conn->rx_buffer.erase(header.length);
+  }
+  return true;
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::handleResume(Connection *conn, const uint8_t *buffer)
+    -> bool {
+  SessionResume resume = deserialise_login_resume(buffer);
+  ClientId old_id = resume.client_id;
+  // The session must still be kept, the client must know its token, and
+  // nobody may be holding it.
+  Session *session = sessions.find(old_id);
+  if (session == nullptr || session->token != resume.token ||
+      client_map.contains(old_id) || !client_map.can_insert(old_id)) {
+    std::cout << "Client can't resume session " << old_id << ", closing\n";
+    return false;
+  }
+  // Provisional id had nothing sent to it, so it and its session can simply
+  // go. Everything the dispatcher needs is written before resume_pending
+  // (release), and it reads none of it until it has seen that set. It may
+  // still come across conn under the provisional id meanwhile, through the
+  // login's kick or its blocked list; all it does with that is flush.
+  session->idle_since = 0; // no longer expiring.
+  conn->resume_sequence = resume.next_sequence;
+  ClientId provisional = std::exchange(conn->client_id, old_id);
+  conn->resume_pending.store(true, std::memory_order_release);
+  client_map.erase(provisional);
+  if (sessions.contains(provisional)) {
+    dropSession(provisional);
+  }
+  client_map.insert({old_id, conn});
+  // Kick the dispatcher, in case no report for this client comes along.
+  kick(old_id);
+  std::cout << "Client resumed session " << old_id << " from report "
+            << resume.next_sequence << "\n";
+  return true;
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::pollShm(int epoll_fd, bool check_liveness) {
+  for (size_t i = 0; i < shm::MAX_SESSIONS; i++) {
+    shm::Slot &slot = shm_region->slots[i];
+    Connection *conn = shm_sessions[i];
+    shm::SlotState state = slot.state.load(std::memory_order_acquire);
+    if (conn == nullptr) {
+      if (state == shm::SlotState::REQUESTED) {
+        openShmSession(i);
+      } else if (state == shm::SlotState::CLOSED && !shm_retiring[i]) {
+        shm::free_slot(slot); // the client gave up before we opened it.
+      }
+      continue;
+    }
+    // Same as a recv: straight into the tail of the rx buffer. Anything the
+    // client wrote before it hung up is drained first.
+    if (slot.inbound.size() > 0) {
+      size_t bytes_read = slot.inbound.read(
+          prepareCounted(conn->rx_buffer, MAX_RECV_SIZE), MAX_RECV_SIZE);
+      conn->rx_buffer.commit(bytes_read);
+      metrics::add(metrics::Counter::BYTES_IN, bytes_read);
+      TRACE_BEGIN(GATEWAY_RECV, bytes_read);
+      bool drained = drainRx(conn);
+      TRACE_END(GATEWAY_RECV, bytes_read);
+      if (!drained) {
+        retireConnection(conn, epoll_fd); // Bad client.
+        continue;
+      }
+    }
+    bool gone = state == shm::SlotState::CLOSED ||
+                (check_liveness && !shm::client_alive(slot));
+    if (gone && slot.inbound.size() == 0) {
+      std::cout << "Client disconnected\n";
+      retireConnection(conn, epoll_fd);
+    }
+  }
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::acquireConnection() -> Connection * {
+  Connection *conn = connection_pool.acquire();
+  size_t pooled = connection_pool.capacity();
+  if (pooled != pooled_connections) {
+    // The pool grew a chunk and conn is one of its fresh connections, whose
+    // buffers are the size every new one starts with.
+    metrics::add(metrics::Counter::SESSION_MEMORY_BYTES,
+                 (pooled - pooled_connections) *
+                     (sizeof(Connection) + conn->rx_buffer.memory().bytes +
+                      conn->tx_buffer.memory().bytes));
+    pooled_connections = pooled;
+  }
+  reserveBuffers(conn);
+  return conn;
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::reserveBuffers(Connection *conn) {
+  if constexpr (requires { conn->rx_buffer.reserve(buffer_bytes); }) {
+    size_t before =
+        conn->rx_buffer.memory().bytes + conn->tx_buffer.memory().bytes;
+    conn->rx_buffer.reserve(buffer_bytes);
+    conn->tx_buffer.reserve(buffer_bytes);
+    size_t after =
+        conn->rx_buffer.memory().bytes + conn->tx_buffer.memory().bytes;
+    if (after != before) {
+      metrics::add(metrics::Counter::SESSION_MEMORY_BYTES, after - before);
+    }
+  }
+}
+
+template <TachyonConfig config>
+template <typename Buffer>
+auto TcpServer<config>::prepareCounted(Buffer &buffer, size_t size)
+    -> uint8_t * {
+  size_t before = buffer.memory().bytes;
+  uint8_t *out = buffer.prepare(size);
+  if (size_t after = buffer.memory().bytes; after != before) {
+    metrics::add(metrics::Counter::SESSION_MEMORY_BYTES, after - before);
+  }
+  return out;
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::openShmSession(size_t slot) {
+  Connection *conn = acquireConnection();
+  conn->reset(-1);
+  conn->shm_slot = &shm_region->slots[slot];
+  admitConnection(conn);
+  conn->shm_slot->client_id = conn->client_id;
+  // A client that gave up meanwhile has made it CLOSED, and is retired on
+  // the next pass.
+  shm::SlotState requested = shm::SlotState::REQUESTED;
+  conn->shm_slot->state.compare_exchange_strong(requested,
+                                                shm::SlotState::ACTIVE,
+                                                std::memory_order_acq_rel);
+  shm_sessions[slot] = conn;
+  active_shm++;
+  std::cout << "New client connected: shm slot = " << slot
+            << " with assigned id = " << conn->client_id << "\n";
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::retireConnection(Connection *conn, int epoll_fd) {
+  // Unlink first, then hand over to the dispatcher. The fd (or shared
+  // memory slot) stays ours until the dispatcher has given the connection
+  // back, so it can't be reused under it.
+  if (conn->shm_slot != nullptr) {
+    // Tell the client, in case it was us hanging up.
+    shm::SlotState active = shm::SlotState::ACTIVE;
+    conn->shm_slot->state.compare_exchange_strong(active,
+                                                  shm::SlotState::CLOSING,
+                                                  std::memory_order_acq_rel);
+    size_t slot = conn->shm_slot - shm_region->slots;
+    shm_sessions[slot] = nullptr;
+    shm_retiring[slot] = true;
+    active_shm--;
+  } else {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+  }
+  client_map.erase(conn->client_id);
+  conn->closed.store(true, std::memory_order_release);
+  metrics::add(metrics::Counter::SESSIONS_CLOSED);
+  retired.push_back(conn);
+  // Its session waits out the grace period for the client to resume.
+  Session *session = sessions.find(conn->client_id);
+  if (session != nullptr) {
+    session->idle_since = tsc::now();
+    idle.push_back({conn->client_id, session->idle_since});
+  }
+}
+
+template <TachyonConfig config> void TcpServer<config>::reclaimConnections() {
+  while (!retired.empty() && retire_queue.push(retired.back())) {
+    retired.pop_back();
+    retiring++;
+  }
+  Connection *conn;
+  while (released_queue.try_pop(conn)) {
+    retiring--;
+    if (conn->shm_slot != nullptr) {
+      closing_slots.push_back(conn->shm_slot - shm_region->slots);
+    } else {
+      close(conn->fd);
+    }
+    connection_pool.release(conn); // buffers are kept for the next client.
+  }
+  // The rings are only emptied once neither end can touch them.
+  std::erase_if(closing_slots, [this](size_t i) {
+    shm::Slot &slot = shm_region->slots[i];
+    if (slot.state.load(std::memory_order_acquire) != shm::SlotState::CLOSED &&
+        shm::client_alive(slot)) {
+      return false;
+    }
+    shm::free_slot(slot);
+    shm_retiring[i] = false;
+    return true;
+  });
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::forgetRetired() -> bool {
+  // Between passes: nothing of this pass holds a connection any more, only
+  // blocked_list and the write epoll set, across passes.
+  bool forgot = !released.empty();
+  while (!released.empty() && released_queue.push(released.back())) {
+    released.pop_back();
+  }
+  Connection *conn;
+  while (retire_queue.try_pop(conn)) {
+    forgot = true;
+    std::erase(blocked_list, conn);
+    if (conn->write_registered) {
+      epoll_ctl(write_epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+      conn->write_registered = false;
+    }
+    if (!released_queue.push(conn)) {
+      released.push_back(conn); // the receive thread is behind, next pass.
+    }
   }
+  return forgot;
 }
 
 template <TachyonConfig config>
@@ -221,87 +581,141 @@ void TcpServer<config>::handleNewConnection(struct epoll_event evt,
   }
   setNonBlocking(client_fd);
 
-  auto *conn = new ClientConnection<typename config::RxBufferType,
-                                    typename config::TxBufferType>(client_fd);
-  conn->client_id = next_id.fetch_add(1);
+  Connection *conn = acquireConnection();
+  conn->reset(client_fd);
   evt.events = EPOLLIN;
   evt.data.ptr = conn;
   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &evt) == -1) {
     perror("epoll_ctl: connected socket");
-    delete conn; // delete if connection failed.
+    connection_pool.release(conn); // nobody else has seen it.
     std::cout << "client is deleted wrong socket\n";
     close(client_fd);
+    return;
+  }
+  admitConnection(conn);
+  std::cout << "New client connected: fd = " << client_fd
+            << " with assigned id = " << conn->client_id << "\n";
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::admitConnection(Connection *conn) {
+  // Past max_sessions the client gets no session of its own, all it may do
+  // is resume one (see drainRx).
+  bool room = live_sessions < max_sessions;
+  conn->client_id = next_id.fetch_add(1);
+  while (!client_map.can_insert(conn->client_id) ||
+         (room && !sessions.can_insert(conn->client_id))) {
+    // slot still held by a session that outlived a whole lap of ids.
+    conn->client_id = next_id.fetch_add(1);
   }
+  // The session first, so the dispatcher finds it for any connection it
+  // finds.
+  if (room) {
+    Session *session = acquireSession();
+    session->token = newToken(); // only sent to a client that asks.
+    sessions.insert({conn->client_id, session});
+    live_sessions++;
+  }
+  // The login response goes through the tx buffer like any other message.
+  // Nobody else can see conn yet, so we flush it from here. Once conn is
+  // published the tx buffer is the dispatcher's: whatever the socket didn't
+  // take is left for it to send, and it is told so.
+  conn->tx_buffer.commit(serialise_new_login(
+      conn->client_id, prepareCounted(conn->tx_buffer, LOGIN_RESPONSE_LEN)));
+  bool sent = flushBuffer(conn);
 
   client_map.insert({conn->client_id, conn});
+  if (!sent) {
+    kick(conn->client_id);
+  }
+  metrics::add(metrics::Counter::SESSIONS_OPENED);
+}
 
-  uint8_t welcome[5];
-  serialise_new_login(conn->client_id, welcome);
-  // TODO: this is a blocking call. ideally use tx buffer.
-  send(client_fd, &welcome, sizeof(welcome), 0);
-  std::cout << "New client connected: fd = " << client_fd
-            << " with assigned id = " << conn->client_id << "\n";
+template <TachyonConfig config> void TcpServer<config>::kick(ClientId cid) {
+  while (!kick_queue.push(cid)) {
+    std::this_thread::yield(); // the dispatcher never waits on us.
+  }
 }
 
 template <TachyonConfig config>
-void TcpServer<config>::handleNewOrder(uint8_t *buffer, ClientId cid) {
-  Order order;
-  ClientRequest clr;
-  deserialise_order(buffer, order);
-  clr.type = RequestType::New;
-  clr.client_id = cid;
-  // TODO: avoid chrono syscalls.
-  // Find some better method of accurate time stamps.
-  clr.time_stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                       std::chrono::steady_clock::now().time_since_epoch())
-                       .count();
-  clr.new_order = order;
-  /* std::cout << "New Order placed with Order id = " << clr.new_order.order_id
-            << " client id: " << clr.client_id
-            << " price : " << clr.new_order.price
-            << " quantity:  " << clr.new_order.quantity << "\n"; */
-  event_queue.push(clr);
+auto TcpServer<config>::claimRequest() -> ClientRequest * {
+  ClientRequest *clr = event_queue.claim();
+  while (clr == nullptr) {
+    // Engine is behind. Hold the client back rather than dropping orders.
+    std::this_thread::yield();
+    clr = event_queue.claim();
+  }
+  return clr;
 }
 
 template <TachyonConfig config>
-void TcpServer<config>::handleCancellation(uint8_t *buffer, ClientId cid) {
-  OrderId order_id_to_cancel = deserialise_order_cancel(buffer);
-  ClientRequest clr;
-  clr.client_id = cid;
-  clr.type = RequestType::Cancel;
-  clr.order_id_to_cancel = order_id_to_cancel;
-  clr.time_stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                       std::chrono::steady_clock::now().time_since_epoch())
-                       .count();
-  // std::cout << "Cancellation request for order id " << clr.order_id_to_cancel
-  //   << " placed by client id " << cid << '\n';
-  event_queue.push(clr);
+void TcpServer<config>::handleNewOrder(const uint8_t *buffer, ClientId cid,
+                                       uint8_t protocol) {
+  // The request is built directly in the engine queue slot.
+  ClientRequest *clr = claimRequest();
+  if (protocol == PROTOCOL_V2) {
+    deserialise_order_v2(buffer, clr->new_order);
+  } else {
+    deserialise_order(buffer, clr->new_order);
+  }
+  clr->type = RequestType::New;
+  clr->client_id = cid;
+  clr->time_stamp = tsc::now(); // received, where its latency starts.
+  TRACE_INSTANT(GATEWAY_NEW, clr->new_order.order_id);
+  /* std::cout << "New Order placed with Order id = "
+            << clr->new_order.order_id << " client id: " << clr->client_id
+            << " price : " << clr->new_order.price
+            << " quantity:  " << clr->new_order.quantity << "\n"; */
+  event_queue.publish();
 }
 
 template <TachyonConfig config>
-auto TcpServer<config>::flushBuffer(
-    ClientConnection<typename config::RxBufferType,
-                     typename config::TxBufferType> *conn) -> bool {
+void TcpServer<config>::handleCancellation(const uint8_t *buffer,
+                                           ClientId cid, uint8_t protocol) {
+  ClientRequest *clr = claimRequest();
+  clr->client_id = cid;
+  clr->type = RequestType::Cancel;
+  clr->order_id_to_cancel = protocol == PROTOCOL_V2
+                                ? deserialise_order_cancel_v2(buffer)
+                                : deserialise_order_cancel(buffer);
+  clr->time_stamp = tsc::now();
+  TRACE_INSTANT(GATEWAY_CANCEL, clr->order_id_to_cancel);
+  // std::cout << "Cancellation request for order id "
+  //   << clr->order_id_to_cancel << " placed by client id " << cid << '\n';
+  event_queue.publish();
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::flushBuffer(Connection *conn) -> bool {
   if (conn->tx_buffer.size() == 0) {
     return true;
   }
   const uint8_t *data_ptr = conn->tx_buffer.begin();
   size_t remaining = conn->tx_buffer.size();
 
-  // non blocking send.
-  ssize_t sent = send(conn->fd, data_ptr, remaining, MSG_DONTWAIT);
+  ssize_t sent;
+  if (conn->shm_slot != nullptr) {
+    // A full ring behaves like a full socket buffer.
+    sent = static_cast<ssize_t>(
+        conn->shm_slot->outbound.write(data_ptr, remaining));
+  } else {
+    // non blocking send. MSG_NOSIGNAL so a dead peer can't SIGPIPE us.
+    sent = send(conn->fd, data_ptr, remaining, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
   if (sent > 0) {
     conn->tx_buffer.erase(sent);
+    metrics::add(metrics::Counter::BYTES_OUT, sent);
   }
 
   else if (sent == -1) {
     if (errno == EAGAIN || errno == EWOULDBLOCK) {
-      // kernel buffer full. stop trying.
-      std::cout << "Kernel buffer full\n";
+      // kernel buffer full. stop trying, caller waits for EPOLLOUT.
       return false;
     }
-    // other error? I guess client dead.
-    return false;
+    // other error? I guess client dead. Drop whatever is pending, the
+    // receive thread will see the hang up and close the connection.
+    conn->tx_buffer.clear();
+    return true;
   }
   // check if sent everything.
   if (conn->tx_buffer.size() == 0) {
@@ -313,48 +727,343 @@ auto TcpServer<config>::flushBuffer(
   return false;
 }
 
+template <TachyonConfig config>
+auto TcpServer<config>::acquireSession() -> Session * {
+  Session *session = session_pool.acquire();
+  if (size_t pooled = session_pool.capacity(); pooled != pooled_sessions) {
+    metrics::add(metrics::Counter::SESSION_MEMORY_BYTES,
+                 (pooled - pooled_sessions) * Session::bytes_for());
+    pooled_sessions = pooled;
+  }
+  session->reset();
+  return session;
+}
+
+template <TachyonConfig config> auto TcpServer<config>::newToken() -> uint64_t {
+  // Ids are handed out in order, so the token is all that keeps one client
+  // from resuming another's session. From the kernel's CSPRNG.
+  uint64_t token = 0;
+  if (getrandom(&token, sizeof(token), 0) != sizeof(token)) {
+    throw std::runtime_error("getrandom failed");
+  }
+  return token;
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::dropSession(ClientId cid) {
+  Session *session = sessions.find(cid);
+  sessions.erase(cid);
+  expired.push_back({session, epochs.epoch()});
+  live_sessions--;
+}
+
+template <TachyonConfig config> void TcpServer<config>::expireSessions() {
+  // Disconnects are appended as they happen, so the due ones are in front.
+  TimeStamp now = tsc::now();
+  size_t due = 0;
+  for (; due < idle.size() && now - idle[due].second >= grace_ns; due++) {
+    auto [cid, since] = idle[due];
+    Session *session = sessions.find(cid);
+    // Not if the client came back; if it went again, its later entry counts.
+    if (session != nullptr && session->idle_since == since) {
+      dropSession(cid);
+      metrics::add(metrics::Counter::SESSIONS_EXPIRED);
+    }
+  }
+  idle.erase(idle.begin(), idle.begin() + static_cast<std::ptrdiff_t>(due));
+
+  epochs.try_advance();
+  size_t kept = 0;
+  for (auto [session, retired_epoch] : expired) {
+    if (epochs.safe(retired_epoch)) {
+      session_pool.release(session);
+    } else {
+      expired[kept++] = {session, retired_epoch};
+    }
+  }
+  expired.resize(kept);
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::resumeSession(Connection *conn, ClientId cid,
+                                      Session *session) {
+  // Nothing but the login response has been written to this connection, so
+  // this is the first thing the client sees after it, and still in v1.
+  uint64_t from = session->resume_point(conn->resume_sequence);
+  conn->tx_buffer.commit(serialise_resume_response(
+      {cid, session->token, from}, prepareCounted(conn->tx_buffer, RESUME_LEN)));
+  conn->resume_pending.store(false, std::memory_order_relaxed);
+
+  ExecutionReport replay[MAX_DISPATCH_BATCH];
+  while (from < session->next_sequence()) {
+    size_t count = std::min<uint64_t>(MAX_DISPATCH_BATCH,
+                                      session->next_sequence() - from);
+    for (size_t i = 0; i < count; i++) {
+      replay[i] = session->at(from + i);
+    }
+    writeReports(conn, replay, count, from);
+    from += count;
+  }
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::writeOwed(Connection *conn, ClientId cid,
+                                  Session *session) -> bool {
+  if (conn->resume_pending.load(std::memory_order_acquire)) {
+    // client_id is settled once the flag is seen. Found under the
+    // provisional id, session is the one being dropped: leave it.
+    if (conn->client_id != cid) {
+      return false;
+    }
+    resumeSession(conn, cid, session);
+    return true;
+  }
+  if (conn->token_owed.load(std::memory_order_acquire)) {
+    // Asked for in the first message, so nothing but the login response
+    // is ahead of it, and still in v1.
+    conn->tx_buffer.commit(serialise_session_token(
+        {cid, session->token},
+        prepareCounted(conn->tx_buffer, SESSION_TOKEN_LEN)));
+    conn->token_owed.store(false, std::memory_order_relaxed);
+  }
+  return false;
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::writeReports(Connection *conn,
+                                     const ExecutionReport *reports,
+                                     size_t count, uint64_t sequence) {
+  uint8_t wanted = conn->protocol.load(std::memory_order_acquire);
+  if (wanted != conn->tx_protocol) {
+    // Client switched. The echo marks where the new version starts.
+    conn->tx_buffer.commit(serialise_protocol_select(
+        wanted, prepareCounted(conn->tx_buffer, PROTOCOL_SELECT_LEN)));
+    conn->tx_protocol = wanted;
+  }
+  // serialise straight into the connection's outbound buffer.
+  if (conn->tx_protocol == PROTOCOL_V2) {
+    uint8_t *out =
+        prepareCounted(conn->tx_buffer, count * EXEC_REPORT_FRAME_LEN);
+    for (size_t i = 0; i < count; i++) {
+      // The frame carries the low 32 bits of the session sequence.
+      out += serialise_execution_report_v2(
+          reports[i], static_cast<uint32_t>(sequence + i), out);
+    }
+    conn->tx_buffer.commit(count * EXEC_REPORT_FRAME_LEN);
+  } else {
+    conn->tx_buffer.commit(serialise_execution_reports(
+        reports, count,
+        prepareCounted(conn->tx_buffer, count * EXEC_REPORT_LEN)));
+  }
+}
+
+template <TachyonConfig config>
+void TcpServer<config>::markDirty(Connection *conn) {
+  if (!conn->dirty) {
+    conn->dirty = true;
+    dirty_list.push_back(conn);
+  }
+}
+
+template <TachyonConfig config> void TcpServer<config>::flushDirty() {
+  for (Connection *conn : dirty_list) {
+    conn->dirty = false;
+    if (conn->write_blocked || conn->closed.load(std::memory_order_acquire)) {
+      continue; // EPOLLOUT will tell us when it can take more.
+    }
+    if (!flushBuffer(conn) && waitWritable(conn)) {
+      blocked_list.push_back(conn);
+    }
+  }
+  dirty_list.clear();
+}
+
+template <TachyonConfig config>
+auto TcpServer<config>::waitWritable(Connection *conn) -> bool {
+  if (conn->shm_slot != nullptr) {
+    // Nothing to wait on, retryBlocked polls the ring every pass.
+    conn->write_blocked = true;
+    return true;
+  }
+  // One shot, so a socket that stays writable doesn't keep waking us up.
+  struct epoll_event evt;
+  evt.events = EPOLLOUT | EPOLLONESHOT;
+  evt.data.ptr = conn;
+  int op = conn->write_registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl(write_epoll_fd, op, conn->fd, &evt) == -1) {
+    perror("epoll_ctl: blocked socket");
+    return false;
+  }
+  conn->write_registered = true;
+  conn->write_blocked = true;
+  return true;
+}
+
+template <TachyonConfig config> void TcpServer<config>::retryBlocked() {
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  int n_writable = epoll_wait(write_epoll_fd, events, MAX_EPOLL_EVENTS, 0);
+  for (int i = 0; i < n_writable; i++) {
+    static_cast<Connection *>(events[i].data.ptr)->write_blocked = false;
+  }
+  // A closed connection is only dropped here, forgetRetired() unregisters
+  // it once the receive thread hands it over.
+  size_t kept = 0;
+  for (Connection *conn : blocked_list) {
+    if (conn->shm_slot != nullptr) {
+      conn->write_blocked = false;
+    }
+    if (conn->closed.load(std::memory_order_acquire)) {
+      continue;
+    }
+    if (!conn->write_blocked && (flushBuffer(conn) || !waitWritable(conn))) {
+      continue; // drained.
+    }
+    blocked_list[kept++] = conn;
+  }
+  blocked_list.resize(kept);
+}
+
 template <TachyonConfig config> void TcpServer<config>::dispatchData() {
-  ExecutionReport report{};
-  uint8_t serialise_buf[64]; // serialisation buffer.
+  write_epoll_fd = epoll_create1(0);
+  if (write_epoll_fd == -1) {
+    throw std::runtime_error("epoll_create1 failed");
+  }
+  dirty_list.reserve(MAX_DIRTY_CONNECTIONS);
+  blocked_list.reserve(MAX_DIRTY_CONNECTIONS);
+  released.reserve(RETIRE_QUEUE_SIZE);
+  TRACE_THREAD("dispatcher");
+  alloc::name_thread("dispatcher");
+
+  ExecutionReport batch[MAX_DISPATCH_BATCH];
+  // When the gateway received each request picked up in the batch, and
+  // when we picked it up. A request is timed by the pass that picks up
+  // the entry ending it; till then it is carried over in the first slot.
+  // That is either because the batch filled up or because the engine,
+  // with the ring full, published the request before it was done.
+  TimeStamp received_at[MAX_DISPATCH_BATCH];
+  TimeStamp picked_at[MAX_DISPATCH_BATCH];
+  bool carried = false;
   while (keep_running.load(std::memory_order_relaxed)) {
-    // drain the queue via batch processing.
-    int pops = 0;
+    watchdog::beat(watchdog::Thread::DISPATCHER);
     bool work_done = false;
-    while (pops < 100 && execution_reports.try_pop(report)) {
-      work_done = true;
-      pops++;
-      size_t len = serialise_execution_report(report, serialise_buf);
-      {
-        if (client_map.contains(report.client_id)) {
-          ClientConnection<typename config::RxBufferType,
-                           typename config::TxBufferType> *conn =
-              client_map.at(report.client_id);
-
-          conn->tx_buffer.insert(serialise_buf, len);
+    // Sessions looked up in this pass can't be reclaimed until it is over.
+    threadsafe::epoch_guard guard(epochs, DISPATCHER_EPOCH);
+    // Retired connections are let go between passes, see forgetRetired().
+    work_done |= forgetRetired();
+    // Resumed clients that haven't been sent their replay yet, ones that
+    // asked for their session token, and new ones whose login response is
+    // still partly in the tx buffer.
+    ClientId kicked;
+    while (kick_queue.try_pop(kicked)) {
+      Connection *conn = client_map.find(kicked);
+      if (conn != nullptr) {
+        if (Session *session = sessions.find(kicked); session != nullptr) {
+          writeOwed(conn, kicked, session);
         }
+        markDirty(conn);
       }
+      work_done = true;
     }
-    {
-      // flush the buffers.
-      // NOTE: since our clients id's are 1 based, we CAN do this.
-      // However, needs improvement.
-      for (ClientId i = 1; i < next_id.load(); i++) {
-        if (client_map.contains(i)) {
-          ClientConnection<typename config::RxBufferType,
-                           typename config::TxBufferType> *conn =
-              client_map.at(i);
-          if (!conn->tx_buffer.size() == 0) {
-            flushBuffer(conn);
-            work_done = true;
-            // maybe use some epoll feature if fush buffer returns false??
-          }
+    // Pick this batch's reports out of the engine's output, building the
+    // ones for fills here rather than on the engine thread. They are
+    // gathered into one array for the batch encoder, so the slots can be
+    // released straight away.
+    uint64_t from = engine_output.position(dispatch_consumer);
+    uint64_t to = engine_output.available(dispatch_consumer);
+    uint64_t seq = from;
+    size_t pops = 0;
+    size_t requests = carried ? 1 : 0;
+    size_t done = 0; // the requests whose last entry has been picked up.
+    TimeStamp picked = from != to ? tsc::now() : 0;
+    for (; seq < to && pops + 2 <= MAX_DISPATCH_BATCH &&
+           requests < MAX_DISPATCH_BATCH;
+         seq++) {
+      const EngineOutput &out = engine_output[seq];
+      if (out.type == OutputType::EVENT) {
+        // The reports for it follow.
+        received_at[requests] = out.event.time_stamp;
+        picked_at[requests++] = picked;
+        metrics::record(metrics::Stage::HANDOFF,
+                        picked > out.completed ? picked - out.completed
+                                               : 0);
+      } else if (out.type == OutputType::REPORT) {
+        TRACE_INSTANT(DISPATCH_REPORT, out.report.order_id);
+        batch[pops++] = out.report;
+      } else if (out.type == OutputType::FILL) {
+        TRACE_INSTANT(DISPATCH_REPORT, out.fill.taker_order_id);
+        TRACE_INSTANT(DISPATCH_REPORT, out.fill.maker_order_id);
+        batch[pops++] = taker_report(out.fill);
+        batch[pops++] = maker_report(out.fill);
+      }
+      done += out.ends_request ? 1 : 0;
+    }
+    // Requests come one after another, so at most the last is still open.
+    carried = done < requests;
+    engine_output.release(dispatch_consumer, seq);
+    work_done |= seq != from;
+    // Consecutive reports for one client are looked up and encoded as a
+    // single run.
+    for (size_t i = 0; i < pops;) {
+      work_done = true;
+      size_t run = 1;
+      while (i + run < pops && batch[i + run].client_id == batch[i].client_id) {
+        run++;
+      }
+      // Every report is numbered and kept, whether the client is
+      // connected right now or not, as long as its session is. Past that
+      // there is nobody left to send them to.
+      ClientId cid = batch[i].client_id;
+      Session *session = sessions.find(cid);
+      if (session == nullptr) {
+        i += run;
+        continue;
+      }
+      Connection *conn = client_map.find(cid);
+      uint64_t sequence = session->next_sequence();
+      for (size_t k = 0; k < run; k++) {
+        session->record(batch[i + k]);
+      }
+      if (conn != nullptr) {
+        if (!writeOwed(conn, cid, session)) { // a replay covers this run.
+          writeReports(conn, &batch[i], run, sequence);
         }
+        markDirty(conn);
       }
+      i += run;
+    }
+    // flush only the connections that got something in this batch. All
+    // the reports a connection collected go out in a single send.
+    if (!dirty_list.empty()) {
+      TRACE_BEGIN(DISPATCH_FLUSH, dirty_list.size());
+      flushDirty();
+      TRACE_END(DISPATCH_FLUSH, 0);
+      work_done = true;
+    }
+    // Written, or waiting on a full socket buffer from here on; all but a
+    // request carried over to the next pass.
+    if (done > 0) {
+      TimeStamp written = tsc::now();
+      for (size_t k = 0; k < done; k++) {
+        metrics::record(metrics::Stage::WRITE, written - picked_at[k]);
+        metrics::record(metrics::Stage::END_TO_END,
+                        written > received_at[k] ? written - received_at[k]
+                                                 : 0);
+      }
+    }
+    if (carried) {
+      received_at[0] = received_at[requests - 1];
+      picked_at[0] = picked_at[requests - 1];
+    }
+    // retry sockets whose kernel buffers have drained.
+    if (!blocked_list.empty()) {
+      retryBlocked();
+      work_done = true;
     }
     if (!work_done) {
       std::this_thread::yield();
     }
   }
+  close(write_epoll_fd);
 }
 
 template class TcpServer<my_config>;
@@ -0,0 +1,88 @@
+#include "telemetry/alloc_tracker.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Built with TACHYON_TRACK_ALLOCS and src/alloc_tracker.cpp whatever the
+// rest of the build does, see CMakeLists.txt.
+
+// Stops the compiler pairing up and dropping a new and its delete.
+static void *volatile sink;
+
+static void allocate_and_free(size_t bytes) {
+  sink = ::operator new(bytes);
+  ::operator delete(sink);
+}
+
+TEST(AllocTrackerTest, CountsTheCallingThread) {
+  uint64_t before = alloc::this_thread();
+  allocate_and_free(100);
+  allocate_and_free(100);
+  EXPECT_EQ(alloc::this_thread() - before, 2u);
+
+  uint64_t theirs = 0;
+  std::thread other([&theirs] {
+    uint64_t start = alloc::this_thread();
+    allocate_and_free(100);
+    theirs = alloc::this_thread() - start;
+  });
+  uint64_t mine = alloc::this_thread(); // std::thread allocated its state.
+  other.join();
+  EXPECT_EQ(theirs, 1u);
+  EXPECT_EQ(alloc::this_thread(), mine);
+}
+
+TEST(AllocTrackerTest, CountsPerPhaseAndThread) {
+  alloc::Counts before = alloc::total(alloc::Phase::SHUTDOWN);
+  std::thread worker([] {
+    alloc::name_thread("worker");
+    alloc::set_phase(alloc::Phase::SHUTDOWN);
+    allocate_and_free(1000);
+    {
+      std::vector<int> numbers(10);
+      sink = numbers.data();
+    }
+    alloc::set_phase(alloc::Phase::STARTUP);
+  });
+  worker.join();
+
+  alloc::Counts after = alloc::total(alloc::Phase::SHUTDOWN);
+  EXPECT_EQ(after.allocations - before.allocations, 2u);
+  EXPECT_EQ(after.frees - before.frees, 2u);
+  EXPECT_EQ(after.bytes - before.bytes, 1000u + 10 * sizeof(int));
+  EXPECT_NE(alloc::format().find(
+                "worker shutdown allocations=2 frees=2 bytes=" +
+                std::to_string(1000 + 10 * sizeof(int))),
+            std::string::npos);
+}
+
+TEST(AllocTrackerTest, AlignedAndArrayFormsAreCounted) {
+  struct alignas(128) Wide {
+    char bytes[128];
+  };
+  uint64_t before = alloc::this_thread();
+  Wide *wide = new Wide;
+  sink = wide;
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(wide) % 128, 0u);
+  delete wide;
+  int *many = new int[16];
+  sink = many;
+  delete[] many;
+  EXPECT_EQ(alloc::this_thread() - before, 2u);
+}
+
+TEST(AllocTrackerTest, NoAllocationScopeAllowsNone) {
+  {
+    alloc::NoAllocation no_alloc("quiet");
+    int on_stack[16] = {};
+    sink = on_stack;
+  }
+  EXPECT_DEATH(
+      {
+        alloc::NoAllocation no_alloc("noisy");
+        allocate_and_free(8);
+      },
+      "noisy: 1 heap allocations in a no allocation scope");
+}
@@ -77,3 +77,52 @@ TEST_F(FlatBufferTest, ClearResetsPointers) {
   EXPECT_EQ(buffer.size(), 0);
   EXPECT_EQ(buffer.begin(), buffer.end());
 }
+
+// 7. Writing in place
+TEST_F(FlatBufferTest, PrepareCommit) {
+  buffer.insert(const_cast<char *>("ab"), 2);
+  char *dst = buffer.prepare(3);
+  EXPECT_EQ(buffer.size(), 2); // nothing visible before commit.
+  std::memcpy(dst, "cde", 3);
+  buffer.commit(3);
+
+  EXPECT_EQ(buffer.size(), 5);
+  EXPECT_EQ(std::memcmp(buffer.begin(), "abcde", 5), 0);
+}
+
+TEST_F(FlatBufferTest, PrepareGrowsAndCommitsPartially) {
+  char *dst = buffer.prepare(500);
+  std::memset(dst, 'x', 500);
+  buffer.commit(10); // e.g. recv returned fewer bytes than asked for.
+
+  EXPECT_EQ(buffer.size(), 10);
+  EXPECT_EQ(buffer.begin()[9], 'x');
+}
+
+TEST_F(FlatBufferTest, MemoryCountsConsumedSpaceUntilReset) {
+  buffer.insert(const_cast<char *>("abcdef"), 6);
+  buffer.erase(4);
+  MemoryUsage usage = buffer.memory();
+  EXPECT_EQ(usage.capacity, 100u);
+  EXPECT_EQ(usage.live, 2u);
+  EXPECT_EQ(usage.tombstones, 4u);
+  EXPECT_EQ(usage.bytes, 100u);
+
+  buffer.prepare(500); // grows, moving the live bytes to the front.
+  usage = buffer.memory();
+  EXPECT_GE(usage.bytes, 500u);
+  EXPECT_EQ(usage.live, 2u);
+  EXPECT_EQ(usage.tombstones, 0u);
+}
+
+TEST_F(FlatBufferTest, PrepareReusesConsumedSpaceBeforeGrowing) {
+  // Like a receive buffer: read a lot, parse nearly all of it, read again.
+  char chunk[60] = {};
+  for (int i = 0; i < 50; i++) {
+    std::memcpy(buffer.prepare(60), chunk, 60);
+    buffer.commit(60);
+    buffer.erase(buffer.size() - 3); // a partial message left over.
+  }
+  EXPECT_EQ(buffer.size(), 3);
+  EXPECT_EQ(buffer.memory().bytes, 100u);
+}
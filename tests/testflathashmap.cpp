@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <map>
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -125,6 +126,76 @@ TEST(FlatHashMapGrowth, GrowthPreservesAfterRemovals) {
   }
 }
 
+TEST(FlatHashMapTombstone, ChurnPurgesTombstonesAndKeepsEntries) {
+  // A sliding window of live keys: many more erases than the table has
+  // slots, so tombstones are purged over and over.
+  flat_hashmap<uint64_t, uint64_t> map(64);
+  const uint64_t WINDOW = 20;
+  for (uint64_t i = 0; i < 5000; ++i) {
+    map.insert(std::make_pair(i, i * 3));
+    if (i >= WINDOW) {
+      map.erase(i - WINDOW);
+    }
+    if (i % 97 == 0) {
+      for (uint64_t k = i >= WINDOW ? i - WINDOW + 1 : 0; k <= i; ++k) {
+        ASSERT_EQ(map.at(k), k * 3);
+      }
+    }
+  }
+  for (uint64_t k = 0; k < 5000 - WINDOW; ++k) {
+    EXPECT_FALSE(map.contains(k));
+  }
+  for (uint64_t k = 5000 - WINDOW; k < 5000; ++k) {
+    EXPECT_EQ(map.at(k), k * 3);
+  }
+}
+
+TEST(FlatHashMapTombstone, RandomInsertEraseMatchesReference) {
+  // Random keys from a small range land on each other's probe chains, so
+  // purges move entries across tombstones that chains run through.
+  for (uint64_t seed = 0; seed < 1000; ++seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> key_of(0, 200);
+    flat_hashmap<uint64_t, uint64_t> map(64);
+    std::map<uint64_t, uint64_t> reference;
+    for (int op = 0; op < 400; ++op) {
+      uint64_t key = key_of(rng);
+      if (reference.count(key) != 0) {
+        map.erase(key);
+        reference.erase(key);
+      } else if (reference.size() < 40) {
+        map.insert(std::make_pair(key, key + op));
+        reference[key] = key + op;
+      }
+      for (const auto &[k, v] : reference) {
+        ASSERT_TRUE(map.contains(k)) << "seed " << seed << " op " << op;
+        ASSERT_EQ(map.at(k), v) << "seed " << seed << " op " << op;
+      }
+    }
+    for (uint64_t k = 0; k <= 200; ++k) {
+      ASSERT_EQ(map.contains(k), reference.count(k) != 0) << "seed " << seed;
+    }
+  }
+}
+
+TEST(FlatHashMapMemory, CountsLiveEntriesAndTombstones) {
+  flat_hashmap<uint64_t, uint64_t> map(60);
+  MemoryUsage empty = map.memory();
+  EXPECT_EQ(empty.capacity, 64u);
+  EXPECT_EQ(empty.live, 0u);
+  EXPECT_GE(empty.bytes, 64 * 2 * sizeof(uint64_t));
+
+  for (uint64_t i = 0; i < 10; ++i) {
+    map.insert(std::make_pair(i, i));
+  }
+  map.erase(3);
+  map.erase(4);
+  MemoryUsage used = map.memory();
+  EXPECT_EQ(used.live, 8u);
+  EXPECT_EQ(used.tombstones, 2u);
+  EXPECT_EQ(used.bytes, empty.bytes); // no growth, nothing given back.
+}
+
 // ------------------------------------------------------------
 // Realistic payload sizes
 // ------------------------------------------------------------
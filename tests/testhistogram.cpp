@@ -0,0 +1,86 @@
+#include "telemetry/clock.hpp"
+#include "telemetry/histogram.hpp"
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+
+using metrics::Histogram;
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  for (uint64_t v = 0; v < Histogram::SUB_BUCKETS; v++) {
+    EXPECT_EQ(Histogram::bucket(v), v);
+    EXPECT_EQ(Histogram::highest(v), v);
+  }
+}
+
+TEST(HistogramTest, BucketsCoverValuesWithinPrecision) {
+  for (uint64_t v = 1; v < (uint64_t(1) << 30); v = v * 5 / 4 + 1) {
+    size_t b = Histogram::bucket(v);
+    ASSERT_LT(b, Histogram::BUCKETS);
+    uint64_t high = Histogram::highest(b);
+    EXPECT_GE(high, v);
+    EXPECT_LE(high - v, v >> Histogram::SUB_BITS);
+    if (b > 0) {
+      EXPECT_LT(Histogram::highest(b - 1), v); // buckets don't overlap.
+    }
+  }
+}
+
+TEST(HistogramTest, HugeValuesLandInLastBucket) {
+  EXPECT_EQ(Histogram::bucket(Histogram::MAX_VALUE), Histogram::BUCKETS - 1);
+  EXPECT_EQ(Histogram::bucket(UINT64_MAX), Histogram::BUCKETS - 1);
+}
+
+TEST(HistogramTest, Percentiles) {
+  auto h = std::make_unique<Histogram>();
+  EXPECT_EQ(h->percentile(0.5), 0);
+  for (uint64_t v = 1; v <= 1000; v++) {
+    h->record(v);
+  }
+  EXPECT_EQ(h->count(), 1000);
+  EXPECT_EQ(h->max(), 1000);
+  uint64_t p50 = h->percentile(0.5);
+  EXPECT_GE(p50, 500);
+  EXPECT_LE(p50, 500 + 500 / Histogram::SUB_BUCKETS);
+  uint64_t p99 = h->percentile(0.99);
+  EXPECT_GE(p99, 990);
+  EXPECT_LE(p99, 1000);
+  EXPECT_EQ(h->percentile(1.0), 1000); // capped at the largest seen.
+}
+
+TEST(HistogramTest, RecordMany) {
+  auto h = std::make_unique<Histogram>();
+  h->record(10, 99);
+  h->record(5000);
+  EXPECT_EQ(h->count(), 100);
+  EXPECT_EQ(h->percentile(0.99), 10);
+  EXPECT_EQ(h->percentile(0.999), 5000);
+}
+
+TEST(HistogramTest, MergeAddsCounts) {
+  auto a = std::make_unique<Histogram>();
+  auto b = std::make_unique<Histogram>();
+  auto all = std::make_unique<Histogram>();
+  for (uint64_t v = 0; v < 100; v++) {
+    a->record(v);
+    b->record(v + 100);
+  }
+  all->merge(*a);
+  all->merge(*b);
+  EXPECT_EQ(all->count(), 200);
+  EXPECT_EQ(all->max(), 199);
+  EXPECT_LE(all->percentile(0.5), 100);
+  EXPECT_GE(all->percentile(0.5), 99);
+}
+
+TEST(ClockTest, FollowsSteadyClock) {
+  tsc::calibrate();
+  uint64_t before = tsc::steady_ns();
+  uint64_t stamp = tsc::now();
+  uint64_t after = tsc::steady_ns();
+  // Same epoch, give or take the rate error since calibration.
+  EXPECT_GE(stamp + 1000000, before);
+  EXPECT_LE(stamp, after + 1000000);
+  EXPECT_LE(stamp, tsc::now());
+}
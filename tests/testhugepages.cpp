@@ -0,0 +1,129 @@
+#include "containers/huge_page_allocator.hpp"
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "containers/arena.hpp"
+#include "containers/flat_hashmap.hpp"
+#include "containers/lockfree_queue.hpp"
+#include "containers/sequenced_ring.hpp"
+
+static auto total_mapped() -> size_t {
+  size_t bytes = 0;
+  for (auto &backing : huge::mapped) {
+    bytes += backing.load();
+  }
+  return bytes;
+}
+
+TEST(HugePageTest, MappingSizeIsWholePagesOfTheBacking) {
+  using huge::Backing;
+  EXPECT_EQ(huge::mapping_size(1, Backing::HUGETLB_2MB), huge::PAGE_2MB);
+  EXPECT_EQ(huge::mapping_size(huge::PAGE_2MB, Backing::TRANSPARENT),
+            huge::PAGE_2MB);
+  EXPECT_EQ(huge::mapping_size(huge::PAGE_2MB + 1, Backing::HUGETLB_2MB),
+            2 * huge::PAGE_2MB);
+  EXPECT_EQ(huge::mapping_size(huge::PAGE_1GB + 1, Backing::HUGETLB_1GB),
+            2 * huge::PAGE_1GB);
+  // Falling back from 1 GB pages doesn't keep their rounding.
+  EXPECT_EQ(huge::mapping_size(huge::PAGE_1GB + 1, Backing::HUGETLB_2MB),
+            huge::PAGE_1GB + huge::PAGE_2MB);
+  EXPECT_EQ(huge::mapping_size(huge::PAGE_1GB + 1, Backing::TRANSPARENT),
+            huge::PAGE_1GB + huge::PAGE_2MB);
+}
+
+TEST(HugePageTest, GigabyteRequestsAreMappedAndUnmappedExactly) {
+  size_t before[huge::BACKINGS];
+  for (size_t b = 0; b < huge::BACKINGS; b++) {
+    before[b] = huge::mapped[b].load();
+  }
+  const size_t bytes = huge::PAGE_1GB + 1; // never touched, costs no memory.
+  void *addr = huge::map(bytes);
+  size_t grown = 0;
+  for (size_t b = 0; b < huge::BACKINGS; b++) {
+    size_t delta = huge::mapped[b].load() - before[b];
+    if (delta != 0) {
+      EXPECT_EQ(delta,
+                huge::mapping_size(bytes, static_cast<huge::Backing>(b)));
+      grown++;
+    }
+  }
+  EXPECT_EQ(grown, 1u);
+  huge::unmap(addr, bytes);
+  // Neither end of it is left mapped.
+  std::vector<unsigned char> resident(huge::PAGE_2MB / 4096);
+  auto *tail = static_cast<char *>(addr) + huge::PAGE_1GB;
+  for (void *page : {addr, static_cast<void *>(tail)}) {
+    EXPECT_EQ(mincore(page, huge::PAGE_2MB, resident.data()), -1);
+    EXPECT_EQ(errno, ENOMEM);
+  }
+  for (void *slot : huge::mappings_1gb) {
+    EXPECT_NE(slot, addr);
+  }
+}
+
+TEST(HugePageTest, SmallAllocationsComeFromTheHeap) {
+  huge_page_allocator<uint64_t> allocator;
+  size_t before = total_mapped();
+  uint64_t *small = allocator.allocate(16);
+  small[15] = 7;
+  EXPECT_EQ(small[15], 7u);
+  allocator.deallocate(small, 16);
+  EXPECT_EQ(total_mapped(), before);
+}
+
+TEST(HugePageTest, LargeAllocationsAreMappedOnHugePageBoundaries) {
+  huge_page_allocator<uint64_t> allocator;
+  const size_t n = (3 * huge::PAGE_2MB) / sizeof(uint64_t) + 1;
+  size_t before = total_mapped();
+  uint64_t *large = allocator.allocate(n);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % huge::PAGE_2MB, 0u);
+  EXPECT_EQ(total_mapped() - before, 4 * huge::PAGE_2MB);
+  std::memset(large, 0xab, n * sizeof(uint64_t));
+  EXPECT_EQ(large[n - 1], 0xababababababababu);
+  allocator.deallocate(large, n);
+}
+
+TEST(HugePageTest, RebindsAndComparesEqual) {
+  huge_page_allocator<uint64_t> words;
+  huge_page_allocator<char> bytes(words);
+  EXPECT_TRUE(words == bytes);
+  std::vector<int, huge_page_allocator<int>> numbers(huge::PAGE_2MB);
+  numbers.back() = 1;
+  EXPECT_EQ(numbers.back(), 1);
+}
+
+TEST(HugePageTest, ContainersWorkOnHugePages) {
+  size_t before = total_mapped();
+
+  flat_hashmap<uint64_t, uint32_t,
+               huge_page_allocator<Entry<uint64_t, uint32_t>>>
+      map(1 << 18);
+  for (uint64_t k = 1; k <= 1000; k++) {
+    map.insert({k, static_cast<uint32_t>(k * 2)});
+  }
+  map.erase(500);
+  EXPECT_FALSE(map.contains(500));
+  EXPECT_EQ(map.at(1000), 2000u);
+
+  LockFreeSPSCQueue<uint64_t, huge_page_allocator<uint64_t>> queue(1 << 20);
+  EXPECT_TRUE(queue.push(42));
+  uint64_t out = 0;
+  EXPECT_TRUE(queue.try_pop(out));
+  EXPECT_EQ(out, 42u);
+
+  sequenced_ring<uint64_t, huge_page_allocator<uint64_t>> ring(1 << 20);
+  EXPECT_EQ(ring.memory().capacity, size_t{1} << 20);
+
+  basic_arena<huge_page_allocator<char>> arena(1 << 16);
+  ClientRequest req;
+  req.new_order.order_id = 9;
+  uint32_t slot = arena.allocateSlot(req);
+  EXPECT_EQ(arena[slot].clr.new_order.order_id, 9u);
+  arena.freeSlot(slot);
+
+  EXPECT_GT(total_mapped(), before);
+}
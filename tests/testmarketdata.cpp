@@ -0,0 +1,92 @@
+#include "network/market_data.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unistd.h>
+
+class MarketDataTest : public ::testing::Test {
+protected:
+  std::string path = "/tmp/testmarketdata_" + std::to_string(getpid());
+  void TearDown() override { unlink(path.c_str()); }
+
+  static constexpr Price PRICE = md::BASE_PRICE + 10;
+};
+
+TEST_F(MarketDataTest, ReaderStartsFromSnapshotThenFollows) {
+  md::Publisher publisher(path);
+  publisher.add(Side::BID, PRICE, 100, 1);
+
+  md::Reader reader(path);
+  md::MarketUpdate update{};
+  EXPECT_EQ(reader.poll(update), md::Reader::Poll::RECOVERED);
+  // Snapshot predates the first update, which is replayed from the ring.
+  EXPECT_EQ(reader.poll(update), md::Reader::Poll::UPDATE);
+  EXPECT_EQ(update.sequence, 1);
+  EXPECT_EQ(update.type, md::UpdateType::LEVEL);
+  EXPECT_EQ(update.quantity, 100);
+  EXPECT_EQ(reader.poll(update), md::Reader::Poll::NONE);
+
+  publisher.add(Side::BID, PRICE, 50, 2);
+  ASSERT_EQ(reader.poll(update), md::Reader::Poll::UPDATE);
+  EXPECT_EQ(update.quantity, 150); // levels carry the total.
+  EXPECT_EQ(reader.book().level(Side::BID, PRICE), 150);
+}
+
+TEST_F(MarketDataTest, TradePublishesTradeThenMakerLevel) {
+  md::Publisher publisher(path);
+  md::Reader reader(path);
+  md::MarketUpdate update{};
+  reader.poll(update); // snapshot.
+
+  publisher.add(Side::ASK, PRICE, 100, 1);
+  Trade trade{};
+  trade.price = PRICE;
+  trade.quantity = 30;
+  trade.aggressor_side = Side::BID;
+  trade.time_stamp = 2;
+  publisher.trade(trade);
+
+  reader.poll(update);
+  ASSERT_EQ(reader.poll(update), md::Reader::Poll::UPDATE);
+  EXPECT_EQ(update.type, md::UpdateType::TRADE);
+  EXPECT_EQ(update.side, Side::BID);
+  EXPECT_EQ(update.quantity, 30);
+  ASSERT_EQ(reader.poll(update), md::Reader::Poll::UPDATE);
+  EXPECT_EQ(update.type, md::UpdateType::LEVEL);
+  EXPECT_EQ(update.side, Side::ASK);
+  EXPECT_EQ(update.quantity, 70);
+}
+
+TEST_F(MarketDataTest, LappedReaderRecoversFromSnapshot) {
+  md::Publisher publisher(path);
+  md::Reader slow(path);
+  md::Reader fast(path);
+  md::MarketUpdate update{};
+  slow.poll(update);
+  fast.poll(update);
+
+  // More than a whole ring while slow isn't looking.
+  size_t n = md::RING_SLOTS + 3 * md::SNAPSHOT_INTERVAL + 17;
+  for (size_t i = 0; i < n; i++) {
+    publisher.add(i % 2 == 0 ? Side::BID : Side::ASK, PRICE + i % 7, 1, i);
+    while (fast.poll(update) == md::Reader::Poll::UPDATE) {
+    }
+  }
+  EXPECT_EQ(fast.recoveries(), 0);
+
+  EXPECT_EQ(slow.poll(update), md::Reader::Poll::RECOVERED);
+  EXPECT_EQ(slow.recoveries(), 1);
+  // Snapshot is behind the head, the ring covers the rest.
+  EXPECT_LE(slow.next(), publisher.published() + 1);
+  while (slow.poll(update) == md::Reader::Poll::UPDATE) {
+  }
+  EXPECT_EQ(slow.next(), publisher.published() + 1);
+  EXPECT_EQ(slow.book().bids, fast.book().bids);
+  EXPECT_EQ(slow.book().asks, fast.book().asks);
+}
+
+TEST_F(MarketDataTest, RejectsForeignFile) {
+  { md::Publisher publisher(path); }
+  truncate(path.c_str(), 16);
+  EXPECT_THROW(md::Reader reader(path), std::runtime_error);
+}
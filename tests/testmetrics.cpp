@@ -0,0 +1,125 @@
+#include "telemetry/metrics.hpp"
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using metrics::Counter;
+using metrics::Gauge;
+using metrics::Stage;
+
+TEST(MetricsTest, CountersSumAcrossThreads) {
+  metrics::Registry registry;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10000; i++) {
+        registry.add(Counter::FILLS);
+      }
+      registry.add(Counter::BYTES_IN, 100);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  metrics::Snapshot snap = registry.snapshot();
+  EXPECT_EQ(snap.counter(Counter::FILLS), 40000);
+  EXPECT_EQ(snap.counter(Counter::BYTES_IN), 400);
+  EXPECT_EQ(snap.counter(Counter::REJECTS), 0);
+}
+
+TEST(MetricsTest, MoreThreadsThanBlocksStillCount) {
+  metrics::Registry registry;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < metrics::MAX_THREADS + 8; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 1000; i++) {
+        registry.add(Counter::ORDERS_NEW);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(registry.snapshot().counter(Counter::ORDERS_NEW),
+            1000 * (metrics::MAX_THREADS + 8));
+}
+
+TEST(MetricsTest, GaugeKeepsLatestValue) {
+  metrics::Registry registry;
+  registry.set(Gauge::BOOK_ORDERS, 10);
+  registry.set(Gauge::BOOK_ORDERS, 7);
+  EXPECT_EQ(registry.snapshot().gauge(Gauge::BOOK_ORDERS), 7);
+}
+
+TEST(MetricsTest, SampledGaugeIsReadAtSnapshot) {
+  metrics::Registry registry;
+  uint64_t depth = 3;
+  registry.sample(Gauge::EVENT_QUEUE_DEPTH, [&] { return depth; });
+  EXPECT_EQ(registry.snapshot().gauge(Gauge::EVENT_QUEUE_DEPTH), 3);
+  depth = 9;
+  EXPECT_EQ(registry.snapshot().gauge(Gauge::EVENT_QUEUE_DEPTH), 9);
+}
+
+TEST(MetricsTest, FormatHasEveryMetric) {
+  metrics::Registry registry;
+  registry.add(Counter::SESSIONS_OPENED, 3);
+  registry.add(Counter::SESSIONS_CLOSED, 1);
+  std::string text = registry.snapshot().format();
+  EXPECT_NE(text.find("sessions_opened 3\n"), std::string::npos);
+  EXPECT_NE(text.find("sessions_active 2\n"), std::string::npos);
+  EXPECT_NE(text.find("book_orders 0\n"), std::string::npos);
+}
+
+TEST(MetricsTest, ExporterAnswersOnSocket) {
+  metrics::Registry registry;
+  registry.add(Counter::FILLS, 5);
+  std::string path = "/tmp/tachyon_test_metrics.sock";
+  metrics::Exporter exporter(registry, "/tmp/tachyon_test_metrics.txt", path,
+                             10);
+  exporter.start();
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path.c_str());
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+  std::string text;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    text.append(buf, n);
+  }
+  close(fd);
+  exporter.stop();
+  EXPECT_NE(text.find("fills 5\n"), std::string::npos);
+}
+
+TEST(MetricsTest, LatenciesMergeAcrossThreads) {
+  metrics::Registry registry;
+  std::vector<std::thread> threads;
+  for (uint64_t t = 1; t <= 4; t++) {
+    threads.emplace_back([&registry, t] {
+      for (int i = 0; i < 1000; i++) {
+        registry.record(Stage::ENGINE, 100 * t);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  metrics::Snapshot snap = registry.snapshot();
+  const metrics::Latency &engine = snap.latency(Stage::ENGINE);
+  EXPECT_EQ(engine.count, 4000);
+  EXPECT_EQ(engine.max, 400);
+  EXPECT_GE(engine.p50, 200);
+  EXPECT_LT(engine.p50, 300);
+  EXPECT_EQ(snap.latency(Stage::WRITE).count, 0);
+  EXPECT_NE(snap.format().find("latency_engine_max_ns 400\n"),
+            std::string::npos);
+}
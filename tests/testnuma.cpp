@@ -0,0 +1,115 @@
+#include "engine/numa.hpp"
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "containers/flat_hashmap.hpp"
+#include "containers/lockfree_queue.hpp"
+
+// The node the page at addr is on, NO_NODE if the kernel won't say.
+static auto node_of(void *addr) -> int {
+  int node = numa::NO_NODE;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr,
+              MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+    return numa::NO_NODE;
+  }
+  return node;
+}
+
+TEST(NumaTest, ParsesCpuLists) {
+  EXPECT_EQ(numa::parse_list("0"), std::vector<int>{0});
+  EXPECT_EQ(numa::parse_list("0-3,8,10-11"),
+            (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_TRUE(numa::parse_list("").empty());
+}
+
+TEST(NumaTest, ReadsTopologyFromSysfs) {
+  auto root = std::filesystem::temp_directory_path() / "testnuma_nodes";
+  std::filesystem::create_directories(root / "node0");
+  std::filesystem::create_directories(root / "node1");
+  std::ofstream(root / "online") << "0-1\n";
+  std::ofstream(root / "node0" / "cpulist") << "0-3,8-11\n";
+  std::ofstream(root / "node0" / "meminfo")
+      << "Node 0 MemTotal:        2097152 kB\n";
+  std::ofstream(root / "node1" / "cpulist") << "4-7\n";
+
+  numa::Topology topology = numa::Topology::read(root.string());
+  ASSERT_EQ(topology.nodes.size(), 2u);
+  EXPECT_EQ(topology.nodes[0].cpus.size(), 8u);
+  EXPECT_EQ(topology.nodes[0].memory_bytes, size_t{2} << 30);
+  EXPECT_EQ(topology.find(1)->cpus.front(), 4);
+  EXPECT_EQ(topology.find(2), nullptr);
+  EXPECT_EQ(topology.describe(), "node 0: cpus 0-3,8-11 memory 2048 MiB\n"
+                                 "node 1: cpus 4-7 memory 0 MiB\n");
+  std::filesystem::remove_all(root);
+}
+
+TEST(NumaTest, WithoutSysfsThereIsOneNode) {
+  numa::Topology topology = numa::Topology::read("/nonexistent");
+  ASSERT_EQ(topology.nodes.size(), 1u);
+  EXPECT_EQ(topology.nodes[0].id, 0);
+  EXPECT_FALSE(topology.nodes[0].cpus.empty());
+}
+
+TEST(NumaTest, PlacesMemoryOnANode) {
+  numa::Topology topology = numa::Topology::read();
+  int node = topology.nodes.front().id;
+  size_t bytes = 4 * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(addr, MAP_FAILED);
+  std::memset(addr, 1, bytes / 2); // some touched, some not.
+  if (!numa::place(addr, bytes, node)) {
+    munmap(addr, bytes);
+    GTEST_SKIP() << "mbind not allowed here";
+  }
+  std::memset(addr, 2, bytes);
+  EXPECT_EQ(node_of(addr), node);
+  EXPECT_EQ(node_of(static_cast<char *>(addr) + bytes - 1), node);
+  munmap(addr, bytes);
+
+  EXPECT_TRUE(numa::place(addr, bytes, numa::NO_NODE)); // nothing to do.
+  EXPECT_FALSE(numa::place(addr, bytes, -5));
+}
+
+TEST(NumaTest, PlacesContainersByTheirRegions) {
+  int node = numa::Topology::read().nodes.front().id;
+  flat_hashmap<uint64_t, uint64_t> map(1 << 16);
+  LockFreeSPSCQueue<uint64_t> queue(1 << 16);
+  size_t visited = 0;
+  map.regions([&](const void *, size_t bytes) { visited += bytes; });
+  EXPECT_EQ(visited, map.memory().bytes);
+  if (!numa::place(map, node) || !numa::place(queue, node)) {
+    GTEST_SKIP() << "mbind not allowed here";
+  }
+  uint64_t key = 1, value = 2;
+  map.insert({key, value});
+  EXPECT_EQ(map.at(key), value);
+}
+
+TEST(NumaTest, SpawnedThreadsRunOnTheirNode) {
+  numa::Topology topology = numa::Topology::read();
+  const numa::Node &node = topology.nodes.front();
+  int ran_on = numa::NO_NODE;
+  size_t allowed = 0;
+  std::thread worker = numa::spawn(
+      topology, node.id,
+      [&](int extra) {
+        cpu_set_t cpus;
+        sched_getaffinity(0, sizeof(cpus), &cpus);
+        allowed = static_cast<size_t>(CPU_COUNT(&cpus));
+        ran_on = numa::current_node() + extra;
+      },
+      0);
+  worker.join();
+  EXPECT_EQ(ran_on, node.id);
+  EXPECT_EQ(allowed, node.cpus.size());
+}
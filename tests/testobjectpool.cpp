@@ -0,0 +1,55 @@
+#include "containers/object_pool.hpp"
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+struct Pooled {
+  int value = 0;
+  std::vector<int> owned; // stands in for a connection's buffers.
+};
+
+TEST(ObjectPoolTest, AcquireGivesDistinctObjects) {
+  object_pool<Pooled> pool{4};
+  std::set<Pooled *> seen;
+  for (int i = 0; i < 4; i++) {
+    seen.insert(pool.acquire());
+  }
+  EXPECT_EQ(seen.size(), 4);
+  EXPECT_EQ(pool.available(), 0);
+}
+
+TEST(ObjectPoolTest, ReleasedObjectIsReusedWithItsState) {
+  object_pool<Pooled> pool{4};
+  Pooled *obj = pool.acquire();
+  obj->owned.reserve(1024);
+  obj->value = 7;
+  pool.release(obj);
+
+  Pooled *again = pool.acquire();
+  EXPECT_EQ(again, obj); // hottest object comes back first.
+  EXPECT_GE(again->owned.capacity(), 1024);
+}
+
+TEST(ObjectPoolTest, GrowsWithStableAddresses) {
+  object_pool<Pooled> pool{2};
+  Pooled *first = pool.acquire();
+  first->value = 42;
+  std::vector<Pooled *> more;
+  for (int i = 0; i < 10; i++) {
+    more.push_back(pool.acquire());
+  }
+  EXPECT_GE(pool.capacity(), 11);
+  EXPECT_EQ(first->value, 42);
+}
+
+TEST(ObjectPoolTest, MemoryCountsObjectsHandedOut) {
+  object_pool<Pooled> pool{4};
+  Pooled *obj = pool.acquire();
+  pool.acquire();
+  MemoryUsage usage = pool.memory();
+  EXPECT_EQ(usage.capacity, 4u);
+  EXPECT_EQ(usage.live, 2u);
+  EXPECT_GE(usage.bytes, 4 * sizeof(Pooled));
+  pool.release(obj);
+  EXPECT_EQ(pool.memory().live, 1u);
+}
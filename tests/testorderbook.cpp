@@ -97,6 +97,41 @@ TEST_F(OrderBookTest, AggressorPriceImprovement) {
   EXPECT_EQ(trades[0].first.quantity, 10);
 }
 
+TEST_F(OrderBookTest, SinkSeesRestingOrderInPlace) {
+  auto sell = makeReq(1, 101, Side::ASK, 100, 50);
+  book.add(sell);
+
+  auto buy = makeReq(2, 201, Side::BID, 100, 20);
+  std::vector<Quantity> resting_left;
+  std::vector<OrderId> makers;
+  book.match(buy, [&](Trade &trade, const ClientRequest &resting) {
+    makers.push_back(trade.maker_order_id);
+    resting_left.push_back(resting.new_order.quantity);
+  });
+
+  ASSERT_EQ(makers.size(), 1);
+  EXPECT_EQ(makers[0], 101);
+  EXPECT_EQ(resting_left[0], 30); // already reduced by the fill.
+  EXPECT_EQ(buy.new_order.quantity, 0);
+}
+
+TEST_F(OrderBookTest, SizeTracksRestingOrders) {
+  auto s1 = makeReq(1, 101, Side::ASK, 100, 10);
+  book.add(s1);
+  auto s2 = makeReq(1, 102, Side::ASK, 101, 10);
+  book.add(s2);
+  EXPECT_EQ(book.size(), 2);
+
+  auto buy = makeReq(2, 201, Side::BID, 100, 10); // takes all of 101.
+  book.match(buy, trades);
+  EXPECT_EQ(book.size(), 1);
+
+  ClientRequest cancelled;
+  EXPECT_TRUE(book.cancelOrder(102, cancelled));
+  EXPECT_EQ(book.size(), 0);
+  EXPECT_EQ(book.size(), book.size_asks() + book.size_bids());
+}
+
 // ============================================================================
 // 2. Priority Logic (Price & Time)
 // ============================================================================
@@ -353,3 +388,37 @@ TEST_F(OrderBookTest, CancelBidVsAsk) {
   EXPECT_TRUE(book.cancelOrder(501, out));
   EXPECT_EQ(out.new_order.side, Side::ASK);
 }
+
+TEST_F(OrderBookTest, MemoryFollowsRestingOrders) {
+  auto before = book.memory();
+  EXPECT_EQ(before.arena.live, 0u);
+  EXPECT_EQ(before.levels.live, 0u);
+  EXPECT_GT(before.total().bytes, 0u); // reserved up front.
+
+  auto bid = makeReq(1, 600, Side::BID, 100, 10);
+  auto ask = makeReq(1, 601, Side::ASK, 110, 10);
+  auto other_bid = makeReq(2, 602, Side::BID, 100, 5);
+  book.add(bid);
+  book.add(ask);
+  book.add(other_bid);
+  auto after = book.memory();
+  EXPECT_EQ(after.arena.live, 3u);
+  EXPECT_EQ(after.arena_idx.live, 3u);
+  EXPECT_EQ(after.list_idx.live, 3u);
+  EXPECT_EQ(after.levels.live, 2u); // two bids share a level.
+
+  ClientRequest out;
+  ASSERT_TRUE(book.cancelOrder(601, out));
+  auto cancelled = book.memory();
+  EXPECT_EQ(cancelled.arena.live, 2u);
+  EXPECT_EQ(cancelled.arena.tombstones, 1u); // a free slot, kept.
+  EXPECT_EQ(cancelled.arena_idx.tombstones, 1u);
+  EXPECT_EQ(cancelled.levels.live, 1u);
+  EXPECT_EQ(cancelled.total().bytes, after.total().bytes);
+
+  std::vector<std::pair<Trade, ClientRequest>> trades;
+  auto sweep = makeReq(3, 603, Side::ASK, 100, 15);
+  book.match(sweep, trades);
+  EXPECT_EQ(trades.size(), 2u);
+  EXPECT_EQ(book.memory().levels.live, 0u); // emptied by the fills.
+}
@@ -0,0 +1,72 @@
+#include "telemetry/perf_counters.hpp"
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+
+using perf::Event;
+
+static void touchFreshPages(size_t pages) {
+  size_t bytes = pages * 4096;
+  void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(mem, MAP_FAILED);
+  auto *bytes_ptr = static_cast<volatile uint8_t *>(mem);
+  for (size_t i = 0; i < bytes; i += 4096) {
+    bytes_ptr[i] = 1;
+  }
+  munmap(mem, bytes);
+}
+
+TEST(PerfCountersTest, CountsPageFaults) {
+  perf::Counters counters;
+  if (!counters.has(Event::PAGE_FAULTS)) {
+    GTEST_SKIP() << "perf_event_open not permitted here";
+  }
+  counters.start();
+  touchFreshPages(64);
+  counters.stop();
+  perf::Sample sample = counters.read();
+  ASSERT_TRUE(sample.has(Event::PAGE_FAULTS));
+  EXPECT_GE(sample[Event::PAGE_FAULTS], 64);
+}
+
+TEST(PerfCountersTest, StoppedCountersDontMove) {
+  perf::Counters counters;
+  if (!counters.has(Event::PAGE_FAULTS)) {
+    GTEST_SKIP() << "perf_event_open not permitted here";
+  }
+  counters.start();
+  counters.stop();
+  perf::Sample before = counters.read();
+  touchFreshPages(16);
+  perf::Sample diff = counters.read().since(before);
+  EXPECT_EQ(diff[Event::PAGE_FAULTS], 0);
+}
+
+TEST(PerfCountersTest, CountsInstructions) {
+  perf::Counters counters;
+  if (!counters.has(Event::INSTRUCTIONS)) {
+    GTEST_SKIP() << "no hardware counters on this machine";
+  }
+  counters.start();
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < 100000; i++) {
+    sum = sum + i;
+  }
+  counters.stop();
+  perf::Sample sample = counters.read();
+  EXPECT_GE(sample[Event::INSTRUCTIONS], 100000);
+  EXPECT_GT(sample[Event::CYCLES], 0);
+}
+
+TEST(PerfCountersTest, SinceSkipsEventsMissingFromEither) {
+  perf::Sample earlier, later;
+  later.valid[0] = true;
+  later.values[0] = 10;
+  perf::Sample diff = later.since(earlier);
+  EXPECT_FALSE(diff.valid[0]);
+  EXPECT_EQ(diff.values[0], 0);
+}
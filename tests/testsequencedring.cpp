@@ -0,0 +1,177 @@
+#include "containers/sequenced_ring.hpp"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Reads everything available to id, returns what it saw.
+static std::vector<int> drain(sequenced_ring<int> &ring, size_t id) {
+  std::vector<int> seen;
+  uint64_t from = ring.position(id), to = ring.available(id);
+  for (uint64_t seq = from; seq < to; seq++) {
+    seen.push_back(ring[seq]);
+  }
+  ring.release(id, to);
+  return seen;
+}
+
+static void produce(sequenced_ring<int> &ring, int value) {
+  int *slot = ring.claim();
+  ASSERT_NE(slot, nullptr);
+  *slot = value;
+  ring.publish();
+}
+
+TEST(SequencedRingTest, EveryConsumerSeesEveryItem) {
+  sequenced_ring<int> ring{8};
+  size_t a = ring.add_consumer();
+  size_t b = ring.add_consumer();
+  for (int i = 0; i < 5; i++) {
+    produce(ring, i);
+  }
+  EXPECT_EQ(drain(ring, a), (std::vector<int>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(drain(ring, b), (std::vector<int>{0, 1, 2, 3, 4}));
+  EXPECT_TRUE(drain(ring, a).empty());
+}
+
+TEST(SequencedRingTest, NothingVisibleBeforePublish) {
+  sequenced_ring<int> ring{8};
+  size_t a = ring.add_consumer();
+  *ring.claim() = 1;
+  EXPECT_EQ(ring.available(a), 0);
+  ring.publish();
+  EXPECT_EQ(ring.available(a), 1);
+}
+
+TEST(SequencedRingTest, ProducerCanChangeWhatItHoldsBack) {
+  sequenced_ring<int> ring{8};
+  size_t a = ring.add_consumer();
+  produce(ring, 1);
+  for (int i = 2; i <= 3; i++) {
+    *ring.claim() = i;
+    ring.commit();
+  }
+  EXPECT_EQ(ring.flushed(), 1);
+  EXPECT_EQ(ring.committed(), 3);
+  for (uint64_t seq = ring.flushed(); seq < ring.committed(); seq++) {
+    ring[seq] *= 10;
+  }
+  ring.flush();
+  EXPECT_EQ(ring.flushed(), 3);
+  EXPECT_EQ(drain(ring, a), (std::vector<int>{1, 20, 30}));
+}
+
+TEST(SequencedRingTest, DependentNeverPassesItsDependency) {
+  sequenced_ring<int> ring{8};
+  size_t journal = ring.add_consumer();
+  size_t dispatch = ring.add_consumer({journal});
+  produce(ring, 1);
+  produce(ring, 2);
+  EXPECT_TRUE(drain(ring, dispatch).empty());
+  ring.release(journal, 1); // journal done with the first only.
+  EXPECT_EQ(drain(ring, dispatch), std::vector<int>{1});
+  drain(ring, journal);
+  EXPECT_EQ(drain(ring, dispatch), std::vector<int>{2});
+}
+
+TEST(SequencedRingTest, ProducerWaitsForSlowestConsumer) {
+  sequenced_ring<int> ring{4};
+  size_t fast = ring.add_consumer();
+  size_t slow = ring.add_consumer();
+  for (int i = 0; i < 4; i++) {
+    produce(ring, i);
+  }
+  EXPECT_EQ(ring.claim(), nullptr);
+  drain(ring, fast);
+  EXPECT_EQ(ring.claim(), nullptr); // slow still holds every slot.
+  ring.release(slow, 1);
+  EXPECT_NE(ring.claim(), nullptr);
+}
+
+TEST(SequencedRingTest, TrailingConsumerGatesTheProducer) {
+  sequenced_ring<int> ring{4};
+  size_t journal = ring.add_consumer();
+  size_t dispatch = ring.add_consumer({journal});
+  for (int i = 0; i < 4; i++) {
+    produce(ring, i);
+  }
+  drain(ring, journal);
+  EXPECT_EQ(ring.claim(), nullptr); // dispatch hasn't read anything yet.
+  drain(ring, dispatch);
+  EXPECT_NE(ring.claim(), nullptr);
+}
+
+TEST(SequencedRingTest, RejectsForwardDependency) {
+  sequenced_ring<int> ring{4};
+  EXPECT_THROW(ring.add_consumer({0}), std::invalid_argument);
+}
+
+TEST(SequencedRingTest, ConcurrentPipelineKeepsOrder) {
+  constexpr int N = 200000;
+  sequenced_ring<int> ring{1024};
+  size_t journal = ring.add_consumer();
+  size_t dispatch = ring.add_consumer({journal});
+  std::atomic<bool> ordered{true};
+
+  auto consume = [&](size_t id) {
+    int expected = 0;
+    while (expected < N) {
+      uint64_t from = ring.position(id), to = ring.available(id);
+      for (uint64_t seq = from; seq < to; seq++) {
+        if (ring[seq] != expected++) {
+          ordered = false;
+        }
+      }
+      ring.release(id, to);
+      std::this_thread::yield();
+    }
+  };
+  std::thread first(consume, journal);
+  std::thread second(consume, dispatch);
+  for (int i = 0; i < N; i++) {
+    int *slot;
+    while ((slot = ring.claim()) == nullptr) {
+      std::this_thread::yield();
+    }
+    *slot = i;
+    ring.publish();
+  }
+  first.join();
+  second.join();
+  EXPECT_TRUE(ordered);
+}
+
+TEST(SequencedRingTest, HighWaterMarkIsTheLargestBacklogSeen) {
+  sequenced_ring<int> ring{8};
+  size_t a = ring.add_consumer();
+  EXPECT_EQ(ring.high_water_mark(a), 0u);
+  for (int i = 0; i < 5; i++) {
+    produce(ring, i);
+  }
+  EXPECT_EQ(ring.backlog(a), 5u);
+  drain(ring, a);
+  EXPECT_EQ(ring.backlog(a), 0u);
+  EXPECT_EQ(ring.high_water_mark(a), 5u);
+  for (int i = 0; i < 2; i++) {
+    produce(ring, i);
+  }
+  drain(ring, a);
+  EXPECT_EQ(ring.high_water_mark(a), 5u);
+}
+
+TEST(SequencedRingTest, MemoryLiveIsTheSlowestConsumersBacklog) {
+  sequenced_ring<int> ring{8};
+  size_t a = ring.add_consumer();
+  size_t b = ring.add_consumer();
+  for (int i = 0; i < 6; i++) {
+    produce(ring, i);
+  }
+  drain(ring, a);
+  MemoryUsage usage = ring.memory();
+  EXPECT_EQ(usage.capacity, 8u);
+  EXPECT_EQ(usage.live, 6u); // b hasn't read any.
+  EXPECT_EQ(usage.bytes, 8 * sizeof(int));
+  drain(ring, b);
+  EXPECT_EQ(ring.memory().live, 0u);
+}
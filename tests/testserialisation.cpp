@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <bit>
 #include <cstring>
 #include <limits>
 #include <vector>
@@ -7,6 +9,8 @@
 // Include your header
 #include "engine/types.hpp"
 #include "network/serialise.hpp"
+#include "network/serialise_batch.hpp"
+#include "network/serialise_v2.hpp"
 
 // ============================================================================
 // 1. ORDER SERIALIZATION TESTS
@@ -196,3 +200,359 @@ TEST(SerializationTest, Cancel_ByteAlignment) {
   EXPECT_EQ(buffer[1], 0xAA);
   EXPECT_EQ(buffer[8], 0x11);
 }
+
+// ============================================================================
+// 5. PROTOCOL V2 TESTS
+// ============================================================================
+
+TEST(SerializationTest, ProtocolSelect_RoundTrip) {
+  uint8_t buffer[8];
+  ASSERT_EQ(serialise_protocol_select(PROTOCOL_V2, buffer),
+            PROTOCOL_SELECT_LEN);
+  EXPECT_EQ(buffer[0], static_cast<uint8_t>(MessageType::PROTOCOL_SELECT));
+  EXPECT_EQ(deserialise_protocol_select(buffer), PROTOCOL_V2);
+}
+
+TEST(SerializationTest, Login_RoundTrip_BigEndian) {
+  // Clients that never ask for a session token read exactly this, keep it.
+  uint8_t buffer[8];
+  ASSERT_EQ(LOGIN_RESPONSE_LEN, 5);
+  ASSERT_EQ(serialise_new_login(0x01020304, buffer), LOGIN_RESPONSE_LEN);
+  EXPECT_EQ(buffer[0], static_cast<uint8_t>(MessageType::LOGIN_RESPONSE));
+  EXPECT_EQ(buffer[1], 0x01);
+  EXPECT_EQ(buffer[4], 0x04);
+  EXPECT_EQ(deserialise_new_login(buffer), 0x01020304);
+}
+
+TEST(SerializationTest, SessionToken_RoundTrip_BigEndian) {
+  uint8_t buffer[16];
+  SessionToken token{0x01020304, 0xA1A2A3A4A5A6A7A8ULL};
+  ASSERT_EQ(serialise_session_token(token, buffer), SESSION_TOKEN_LEN);
+  EXPECT_EQ(buffer[0], static_cast<uint8_t>(MessageType::SESSION_TOKEN));
+  EXPECT_EQ(buffer[1], 0x01);
+  EXPECT_EQ(buffer[5], 0xA1);
+  EXPECT_EQ(buffer[12], 0xA8);
+
+  SessionToken back = deserialise_session_token(buffer);
+  EXPECT_EQ(back.client_id, token.client_id);
+  EXPECT_EQ(back.token, token.token);
+}
+
+TEST(SerializationTest, LoginResume_RoundTrip_BigEndian) {
+  uint8_t buffer[24];
+  SessionResume resume{0x01020304, 0xA1A2A3A4A5A6A7A8ULL,
+                       0x1122334455667788ULL};
+  ASSERT_EQ(serialise_login_resume(resume, buffer), RESUME_LEN);
+  EXPECT_EQ(buffer[0], static_cast<uint8_t>(MessageType::LOGIN_RESUME));
+  EXPECT_EQ(buffer[1], 0x01);
+  EXPECT_EQ(buffer[5], 0xA1);
+  EXPECT_EQ(buffer[13], 0x11);
+  EXPECT_EQ(buffer[20], 0x88);
+
+  SessionResume back = deserialise_login_resume(buffer);
+  EXPECT_EQ(back.client_id, resume.client_id);
+  EXPECT_EQ(back.token, resume.token);
+  EXPECT_EQ(back.next_sequence, resume.next_sequence);
+
+  ASSERT_EQ(serialise_resume_response(resume, buffer), RESUME_LEN);
+  EXPECT_EQ(buffer[0], static_cast<uint8_t>(MessageType::RESUME_RESPONSE));
+  EXPECT_EQ(deserialise_resume_response(buffer).next_sequence,
+            resume.next_sequence);
+}
+
+TEST(SerializationTest, V2_FrameHeader_RoundTrip) {
+  uint8_t buffer[FRAME_HEADER_LEN];
+  write_frame_header(MessageType::ORDER_NEW, 3, 0x01020304, buffer);
+
+  FrameHeader header = read_frame_header(buffer);
+  EXPECT_EQ(header.length, FRAME_HEADER_LEN + 3 * ORDER_V2_LEN);
+  EXPECT_EQ(header.type, MessageType::ORDER_NEW);
+  EXPECT_EQ(header.count, 3);
+  EXPECT_EQ(header.sequence, 0x01020304u);
+  EXPECT_TRUE(valid_frame_header(header));
+
+  // Little endian on the wire: low byte first.
+  EXPECT_EQ(buffer[4], 0x04);
+}
+
+TEST(SerializationTest, V2_FrameHeader_RejectsInconsistent) {
+  FrameHeader header{};
+  header.type = MessageType::ORDER_CANCEL;
+  header.count = 2;
+  header.length = FRAME_HEADER_LEN + CANCEL_V2_LEN; // one short.
+  EXPECT_FALSE(valid_frame_header(header));
+
+  header.count = 0;
+  header.length = FRAME_HEADER_LEN;
+  EXPECT_FALSE(valid_frame_header(header));
+
+  header.type = MessageType::LOGIN_RESPONSE; // never framed.
+  header.count = 1;
+  EXPECT_FALSE(valid_frame_header(header));
+}
+
+TEST(SerializationTest, V2_Order_RoundTrip_LittleEndian) {
+  Order original{};
+  original.order_id = 0x0102030405060708ULL;
+  original.price = std::numeric_limits<Price>::max();
+  original.quantity = 0x11223344;
+  original.side = Side::ASK;
+  original.order_type = OrderType::MARKET;
+  original.tif = TimeInForce::IOC;
+
+  uint8_t buffer[ORDER_V2_LEN];
+  ASSERT_EQ(serialise_order_v2(original, buffer), ORDER_V2_LEN);
+  EXPECT_EQ(buffer[0], 0x08);
+  EXPECT_EQ(buffer[16], 0x44);
+
+  Order result{};
+  deserialise_order_v2(buffer, result);
+  EXPECT_EQ(result.order_id, original.order_id);
+  EXPECT_EQ(result.price, original.price);
+  EXPECT_EQ(result.quantity, original.quantity);
+  EXPECT_EQ(result.side, original.side);
+  EXPECT_EQ(result.order_type, original.order_type);
+  EXPECT_EQ(result.tif, original.tif);
+}
+
+TEST(SerializationTest, V2_Frame_BatchesOrders) {
+  constexpr uint8_t count = 5;
+  uint8_t buffer[FRAME_HEADER_LEN + count * ORDER_V2_LEN];
+  for (uint8_t i = 0; i < count; i++) {
+    Order order{};
+    order.order_id = 100 + i;
+    order.price = 10000 + i;
+    order.quantity = i + 1;
+    serialise_order_v2(order, &buffer[FRAME_HEADER_LEN + i * ORDER_V2_LEN]);
+  }
+  write_frame_header(MessageType::ORDER_NEW, count, 7, buffer);
+
+  FrameHeader header = read_frame_header(buffer);
+  ASSERT_TRUE(valid_frame_header(header));
+  ASSERT_EQ(header.length, sizeof(buffer));
+  const uint8_t *payload = &buffer[FRAME_HEADER_LEN];
+  for (uint8_t i = 0; i < header.count; i++) {
+    Order order{};
+    deserialise_order_v2(payload, order);
+    EXPECT_EQ(order.order_id, 100u + i);
+    EXPECT_EQ(order.price, 10000u + i);
+    EXPECT_EQ(order.quantity, i + 1u);
+    payload += frame_payload_size(header.type);
+  }
+}
+
+TEST(SerializationTest, V2_Cancel_RoundTrip) {
+  uint8_t buffer[CANCEL_V2_LEN];
+  ASSERT_EQ(serialise_order_cancel_v2(0xAABBCCDDEEFF0011, buffer),
+            CANCEL_V2_LEN);
+  EXPECT_EQ(buffer[0], 0x11);
+  EXPECT_EQ(deserialise_order_cancel_v2(buffer), 0xAABBCCDDEEFF0011);
+}
+
+TEST(SerializationTest, V2_ExecReport_RoundTrip) {
+  ExecutionReport original{};
+  original.client_id = 99;
+  original.order_id = 888;
+  original.price = 12345;
+  original.last_quantity = 10;
+  original.remaining_quantity = 90;
+  original.type = ExecType::REJECTED;
+  original.reason = RejectReason::PRICE_INVALID;
+  original.side = Side::ASK;
+
+  uint8_t buffer[EXEC_REPORT_FRAME_LEN];
+  ASSERT_EQ(serialise_execution_report_v2(original, 42, buffer),
+            EXEC_REPORT_FRAME_LEN);
+  FrameHeader header = read_frame_header(buffer);
+  EXPECT_TRUE(valid_frame_header(header));
+  EXPECT_EQ(header.type, MessageType::EXEC_REPORT);
+  EXPECT_EQ(header.count, 1);
+  EXPECT_EQ(header.sequence, 42u);
+
+  ExecutionReport result{};
+  deserialise_execution_report_v2(&buffer[FRAME_HEADER_LEN], result);
+  EXPECT_EQ(result.client_id, original.client_id);
+  EXPECT_EQ(result.order_id, original.order_id);
+  EXPECT_EQ(result.price, original.price);
+  EXPECT_EQ(result.last_quantity, original.last_quantity);
+  EXPECT_EQ(result.remaining_quantity, original.remaining_quantity);
+  EXPECT_EQ(result.type, original.type);
+  EXPECT_EQ(result.reason, original.reason);
+  EXPECT_EQ(result.side, original.side);
+}
+
+// ============================================================================
+// 6. BATCH CODEC TESTS
+// ============================================================================
+
+// Every path this machine can run must produce the scalar bytes exactly.
+static auto batch_paths() -> std::vector<CodecPath> {
+  std::vector<CodecPath> paths{CodecPath::SCALAR};
+  if (codec_path() >= CodecPath::SSSE3) {
+    paths.push_back(CodecPath::SSSE3);
+  }
+  if (codec_path() >= CodecPath::AVX2) {
+    paths.push_back(CodecPath::AVX2);
+  }
+  return paths;
+}
+
+static auto make_batch_order(uint64_t i) -> Order {
+  Order order{};
+  order.order_id = 0x0102030405060708ULL * (i + 1);
+  order.price = 0xA1B2C3D4E5F60718ULL + i;
+  order.quantity = 0x11223344 + static_cast<Quantity>(i);
+  order.side = static_cast<Side>(i % 2);
+  order.order_type = static_cast<OrderType>((i / 2) % 2);
+  order.tif = static_cast<TimeInForce>((i / 4) % 2);
+  return order;
+}
+
+static auto make_batch_report(uint64_t i) -> ExecutionReport {
+  ExecutionReport report{};
+  report.client_id = 0xC1C2C3C4 + static_cast<ClientId>(i);
+  report.order_id = 0x0102030405060708ULL * (i + 1);
+  report.price = 0xA1B2C3D4E5F60718ULL + i;
+  report.last_quantity = 0x11223344 + static_cast<Quantity>(i);
+  report.remaining_quantity = 0x55667788 - static_cast<Quantity>(i);
+  report.type = static_cast<ExecType>(i % 5);
+  report.reason = static_cast<RejectReason>(i % 7);
+  report.side = static_cast<Side>(i % 2);
+  return report;
+}
+
+TEST(SerializationTest, Batch_Orders_MatchScalar) {
+  constexpr size_t count = 7; // odd, so the AVX2 path hits its tail.
+  std::vector<Order> orders;
+  std::vector<uint8_t> expected(count * (1 + sizeof(Order)));
+  for (size_t i = 0; i < count; i++) {
+    orders.push_back(make_batch_order(i));
+    serialise_order(orders[i], &expected[i * (1 + sizeof(Order))]);
+  }
+
+  for (CodecPath path : batch_paths()) {
+    std::vector<uint8_t> wire(expected.size() + 1, 0xEE); // + guard byte.
+    ASSERT_EQ(serialise_orders(orders.data(), count, wire.data(), path),
+              expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), wire.begin()))
+        << "path " << static_cast<int>(path);
+    EXPECT_EQ(wire.back(), 0xEE);
+
+    std::vector<Order> decoded(count + 1);
+    std::memset(decoded.data(), 0xEE, decoded.size() * sizeof(Order));
+    deserialise_orders(wire.data(), count, decoded.data(), path);
+    EXPECT_EQ(std::memcmp(decoded.data(), orders.data(), count * sizeof(Order)),
+              0)
+        << "path " << static_cast<int>(path);
+    EXPECT_EQ(reinterpret_cast<uint8_t *>(&decoded[count])[0], 0xEE);
+  }
+}
+
+TEST(SerializationTest, Batch_ExecReports_MatchScalar) {
+  constexpr size_t count = 9;
+  std::vector<ExecutionReport> reports;
+  std::vector<uint8_t> expected(count * EXEC_REPORT_LEN);
+  for (size_t i = 0; i < count; i++) {
+    reports.push_back(make_batch_report(i));
+    serialise_execution_report(reports[i], &expected[i * EXEC_REPORT_LEN]);
+  }
+
+  for (CodecPath path : batch_paths()) {
+    std::vector<uint8_t> wire(expected.size() + 1, 0xEE);
+    ASSERT_EQ(
+        serialise_execution_reports(reports.data(), count, wire.data(), path),
+        expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), wire.begin()))
+        << "path " << static_cast<int>(path);
+    EXPECT_EQ(wire.back(), 0xEE);
+
+    std::vector<ExecutionReport> decoded(count);
+    deserialise_execution_reports(wire.data(), count, decoded.data(), path);
+    EXPECT_EQ(std::memcmp(decoded.data(), reports.data(),
+                          count * sizeof(ExecutionReport)),
+              0)
+        << "path " << static_cast<int>(path);
+  }
+}
+
+TEST(SerializationTest, Batch_Empty) {
+  uint8_t buffer[1] = {0xEE};
+  EXPECT_EQ(serialise_orders(nullptr, 0, buffer), 0u);
+  EXPECT_EQ(serialise_execution_reports(nullptr, 0, buffer), 0u);
+  EXPECT_EQ(buffer[0], 0xEE);
+}
+
+// ============================================================================
+// 7. SCHEMA TESTS
+// ============================================================================
+
+namespace {
+struct __attribute__((packed)) Probe {
+  uint8_t flag;
+  uint32_t value;
+  uint16_t small;
+};
+// Wire order differs from the struct, with padding in between.
+using ProbeBody =
+    schema::Layout<Probe, std::endian::big, SCHEMA_FIELD(Probe, value),
+                   schema::Pad<2>, SCHEMA_FIELD(Probe, small),
+                   SCHEMA_FIELD(Probe, flag)>;
+using ProbeMessage = schema::Message<MessageType::TRADE, ProbeBody>;
+} // namespace
+
+TEST(SerializationTest, Schema_OffsetsAndSizes) {
+  EXPECT_EQ(ProbeBody::size, 9u);
+  EXPECT_EQ(ProbeMessage::wire_size, 10u);
+  EXPECT_EQ(ProbeBody::WIRE_OFFSETS[0], 0u); // value
+  EXPECT_EQ(ProbeBody::WIRE_OFFSETS[2], 6u); // small, after the padding.
+  EXPECT_EQ(ProbeBody::WIRE_OFFSETS[3], 8u); // flag
+  EXPECT_FALSE(ProbeBody::memcpy_path);
+}
+
+TEST(SerializationTest, Schema_RoundTripWithPadding) {
+  Probe original{0x7F, 0xA1B2C3D4, 0x0102};
+  uint8_t buffer[ProbeMessage::wire_size];
+  std::memset(buffer, 0xEE, sizeof(buffer));
+  ASSERT_EQ(ProbeMessage::encode(original, buffer), ProbeMessage::wire_size);
+
+  const uint8_t expected[] = {static_cast<uint8_t>(MessageType::TRADE),
+                              0xA1, 0xB2, 0xC3, 0xD4, 0x00, 0x00, 0x01, 0x02,
+                              0x7F};
+  EXPECT_EQ(std::memcmp(buffer, expected, sizeof(expected)), 0);
+
+  Probe result{};
+  ProbeMessage::decode(buffer, result);
+  EXPECT_EQ(result.flag, original.flag);
+  EXPECT_EQ(result.value, original.value);
+  EXPECT_EQ(result.small, original.small);
+}
+
+TEST(SerializationTest, Schema_MemcpyPathWhenLayoutMatchesHost) {
+  // Same offsets on both sides, so only byte order decides.
+  constexpr bool little = std::endian::native == std::endian::little;
+  EXPECT_EQ(OrderV2Message::body::memcpy_path, little);
+  EXPECT_EQ(CancelV2Message::body::memcpy_path, little);
+  EXPECT_EQ(FrameHeaderLayout::memcpy_path, little);
+  EXPECT_EQ(OrderMessage::body::memcpy_path, !little);
+  // v2 reports reorder fields relative to the struct.
+  EXPECT_FALSE(ExecReportV2Message::body::memcpy_path);
+  EXPECT_TRUE(ProtocolSelectMessage::body::memcpy_path);
+}
+
+TEST(SerializationTest, Schema_LengthTables) {
+  auto len = [](const auto &table, MessageType type) {
+    return table[static_cast<uint8_t>(type)];
+  };
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::ORDER_NEW), 24);
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::ORDER_CANCEL), 9);
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::PROTOCOL_SELECT), 2);
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::LOGIN_RESUME), 21);
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::SESSION_TOKEN), 13);
+  EXPECT_EQ(len(GATEWAY_INBOUND_LENGTHS, MessageType::EXEC_REPORT), 0);
+  EXPECT_EQ(len(CLIENT_INBOUND_LENGTHS, MessageType::RESUME_RESPONSE), 21);
+  EXPECT_EQ(len(CLIENT_INBOUND_LENGTHS, MessageType::EXEC_REPORT), 32);
+  EXPECT_EQ(len(CLIENT_INBOUND_LENGTHS, MessageType::LOGIN_RESPONSE), 5);
+  EXPECT_EQ(len(CLIENT_INBOUND_LENGTHS, MessageType::SESSION_TOKEN), 13);
+  EXPECT_EQ(len(CLIENT_INBOUND_LENGTHS, MessageType::ORDER_NEW), 0);
+  EXPECT_EQ(GATEWAY_INBOUND_LENGTHS[0xFF], 0);
+}
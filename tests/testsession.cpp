@@ -0,0 +1,70 @@
+#include "network/session.hpp"
+#include <gtest/gtest.h>
+
+static ExecutionReport report_for(OrderId id) {
+  ExecutionReport report{};
+  report.client_id = 7;
+  report.order_id = id;
+  return report;
+}
+
+TEST(SessionTest, NumbersReportsFromZero) {
+  Session session{4};
+  EXPECT_EQ(session.next_sequence(), 0);
+  EXPECT_EQ(session.record(report_for(100)), 0);
+  EXPECT_EQ(session.record(report_for(101)), 1);
+  EXPECT_EQ(session.next_sequence(), 2);
+  EXPECT_EQ(session.oldest_sequence(), 0);
+  EXPECT_EQ(session.at(1).order_id, 101);
+}
+
+TEST(SessionTest, KeepsOnlyTheLastDepthReports) {
+  Session session{4};
+  for (OrderId id = 0; id < 10; id++) {
+    session.record(report_for(id));
+  }
+  EXPECT_EQ(session.next_sequence(), 10);
+  EXPECT_EQ(session.oldest_sequence(), 6);
+  for (uint64_t seq = 6; seq < 10; seq++) {
+    EXPECT_EQ(session.at(seq).order_id, seq); // ids match sequence here.
+  }
+}
+
+TEST(SessionTest, ResumeReplaysOnlyTheGap) {
+  Session session{4};
+  for (OrderId id = 0; id < 3; id++) {
+    session.record(report_for(id));
+  }
+  // Client saw 0 and 1.
+  EXPECT_EQ(session.resume_point(2), 2);
+  // Client saw everything, nothing to replay.
+  EXPECT_EQ(session.resume_point(3), 3);
+  // Client claims more than was ever sent.
+  EXPECT_EQ(session.resume_point(50), 3);
+}
+
+TEST(SessionTest, ResumePastTheRingReportsTheLoss) {
+  Session session{4};
+  for (OrderId id = 0; id < 10; id++) {
+    session.record(report_for(id));
+  }
+  // 0..5 have been dropped, the replay starts at the oldest kept.
+  EXPECT_EQ(session.resume_point(0), 6);
+  EXPECT_EQ(session.resume_point(8), 8);
+}
+
+TEST(SessionTest, ResetStartsOver) {
+  Session session{4};
+  for (OrderId id = 0; id < 10; id++) {
+    session.record(report_for(id));
+  }
+  session.token = 9;
+  session.idle_since = 5;
+  session.reset();
+  EXPECT_EQ(session.next_sequence(), 0);
+  EXPECT_EQ(session.oldest_sequence(), 0);
+  EXPECT_EQ(session.token, 0u);
+  EXPECT_EQ(session.idle_since, 0u);
+  EXPECT_EQ(session.record(report_for(20)), 0);
+  EXPECT_EQ(session.at(0).order_id, 20);
+}
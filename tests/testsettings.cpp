@@ -0,0 +1,134 @@
+#include "engine/settings.hpp"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "engine/orderbook.hpp"
+#include "my_config.hpp"
+#include "network/tcpserver.hpp"
+
+static auto parsed(const std::string &text) -> settings::Settings {
+  std::istringstream in(text);
+  return settings::parse(in, "test.conf");
+}
+
+// The error parse() throws for text, "" if none.
+static auto error(const std::string &text) -> std::string {
+  try {
+    parsed(text);
+  } catch (const std::runtime_error &e) {
+    return e.what();
+  }
+  return "";
+}
+
+TEST(SettingsTest, EmptyFileKeepsTheDefaults) {
+  settings::Settings s = parsed("# nothing here\n\n");
+  settings::Settings defaults;
+  EXPECT_EQ(s.port, defaults.port);
+  EXPECT_EQ(s.event_queue_capacity, defaults.event_queue_capacity);
+  EXPECT_EQ(s.min_price, settings::LOWEST_PRICE);
+  EXPECT_EQ(s.max_price, settings::HIGHEST_PRICE);
+  EXPECT_EQ(s.memory_budget, 0u);
+}
+
+TEST(SettingsTest, ReadsValuesWithSuffixesAndComments) {
+  settings::Settings s = parsed("port = 4000\n"
+                                "  event_queue_capacity=64K  # requests\n"
+                                "arena_capacity = 1000\n"
+                                "memory_budget = 2G\n"
+                                "min_price = 9800\n"
+                                "max_price = 10200\n");
+  EXPECT_EQ(s.port, "4000");
+  EXPECT_EQ(s.event_queue_capacity, 64u << 10);
+  EXPECT_EQ(s.arena_capacity, 1000u);
+  EXPECT_EQ(s.memory_budget, 2ull << 30);
+  EXPECT_EQ(s.min_price, 9800u);
+  EXPECT_EQ(s.max_price, 10200u);
+}
+
+TEST(SettingsTest, ErrorsNameTheLine) {
+  EXPECT_EQ(error("port = 1\nqueue = 5\n"),
+            "test.conf:2: unknown setting 'queue'");
+  EXPECT_EQ(error("arena_capacity = lots\n"),
+            "test.conf:1: 'lots' is not a number for arena_capacity");
+  EXPECT_EQ(error("arena_capacity = -1\n"),
+            "test.conf:1: '-1' is not a number for arena_capacity");
+  EXPECT_EQ(error("arena_capacity\n"), "test.conf:1: expected key = value");
+}
+
+TEST(SettingsTest, RejectsSettingsThatDontWork) {
+  EXPECT_NE(error("port = 70000\n"), "");
+  EXPECT_NE(error("event_queue_capacity = 0\n"), "");
+  EXPECT_NE(error("min_price = 10200\nmax_price = 10100\n"), "");
+  EXPECT_NE(error("max_price = 100000\n"), ""); // no market data level.
+  EXPECT_EQ(error("min_price = 10000\nmax_price = 10000\n"), "");
+  EXPECT_NE(error("connection_table_size = 1K\nmax_sessions = 2K\n"), "");
+}
+
+TEST(SettingsTest, ReadsSessionLimits) {
+  settings::Settings defaults = parsed("");
+  EXPECT_EQ(defaults.max_sessions, 0u);
+  settings::Settings s = parsed("session_grace_ms = 500\n"
+                                "max_sessions = 1K\n");
+  EXPECT_EQ(s.session_grace_ms, 500u);
+  EXPECT_EQ(s.max_sessions, 1024u);
+}
+
+TEST(SettingsTest, ReadsNumaPlacement) {
+  settings::Settings defaults = parsed("");
+  EXPECT_EQ(defaults.engine_node, settings::NO_NODE);
+  EXPECT_EQ(defaults.gateway_node, settings::NO_NODE);
+  EXPECT_EQ(defaults.queue_placement, settings::QueuePlacement::CONSUMER);
+
+  settings::Settings s = parsed("engine_node = 1\n"
+                                "gateway_node = 0\n"
+                                "queue_placement = producer\n");
+  EXPECT_EQ(s.engine_node, 1);
+  EXPECT_EQ(s.gateway_node, 0);
+  EXPECT_EQ(s.queue_placement, settings::QueuePlacement::PRODUCER);
+
+  EXPECT_EQ(error("queue_placement = both\n"),
+            "test.conf:1: queue_placement is consumer or producer, not "
+            "'both'");
+  EXPECT_NE(error("engine_node = 5000000000\n"), "");
+}
+
+TEST(SettingsTest, FootprintIsWhatGetsAllocated) {
+  settings::Settings s = parsed("arena_capacity = 1000\n"
+                                "order_index_capacity = 2000\n"
+                                "min_price = 9900\n"
+                                "max_price = 10099\n");
+  OrderBook<my_config> book(s);
+  EXPECT_EQ(book.memory().total().bytes, OrderBook<my_config>::footprint(s));
+  EXPECT_EQ(book.memory().levels.capacity, 2 * 200u);
+
+  my_config::EventQueue event_queue(s.event_queue_capacity);
+  EXPECT_EQ(event_queue.memory().bytes,
+            my_config::EventQueue::bytes_for(s.event_queue_capacity));
+}
+
+TEST(SettingsTest, BookTakesPricesInItsBandOnly) {
+  settings::Settings s = parsed("min_price = 9900\nmax_price = 10099\n");
+  OrderBook<my_config> book(s);
+  EXPECT_EQ(book.minPrice(), 9900u);
+  EXPECT_EQ(book.maxPrice(), 10099u);
+  EXPECT_TRUE(book.inBand(9900));
+  EXPECT_TRUE(book.inBand(10099));
+  EXPECT_FALSE(book.inBand(9899));
+  EXPECT_FALSE(book.inBand(10100));
+
+  ClientRequest order;
+  order.type = RequestType::New;
+  order.client_id = 1;
+  order.new_order.order_id = 1;
+  order.new_order.side = Side::BID;
+  order.new_order.price = 10099;
+  order.new_order.quantity = 10;
+  order.new_order.order_type = OrderType::LIMIT;
+  order.new_order.tif = TimeInForce::GTC;
+  book.add(order);
+  EXPECT_EQ(book.size(), 1u);
+}
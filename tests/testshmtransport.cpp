@@ -0,0 +1,144 @@
+#include "network/shm_transport.hpp"
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+TEST(ShmByteRingTest, WritesWhatFitsAndReadsItBack) {
+  auto ring = std::make_unique<shm::ByteRing<16>>();
+  std::vector<uint8_t> in(20);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+  EXPECT_EQ(ring->write(in.data(), in.size()), 16); // full, no slot wasted.
+  EXPECT_EQ(ring->write(in.data(), 1), 0);
+
+  uint8_t out[32];
+  EXPECT_EQ(ring->read(out, 10), 10);
+  EXPECT_EQ(out[9], 9);
+  EXPECT_EQ(ring->size(), 6);
+}
+
+TEST(ShmByteRingTest, WrapsAround) {
+  auto ring = std::make_unique<shm::ByteRing<16>>();
+  uint8_t scratch[16];
+  ring->write(scratch, 12);
+  ring->read(scratch, 12);
+  // Next write straddles the end of the buffer.
+  uint8_t in[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  ASSERT_EQ(ring->write(in, 10), 10);
+  uint8_t out[10] = {};
+  ASSERT_EQ(ring->read(out, 10), 10);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(out[i], in[i]);
+  }
+}
+
+TEST(ShmByteRingTest, StreamsAcrossThreadsInOrder) {
+  auto ring = std::make_unique<shm::ByteRing<64>>();
+  constexpr size_t TOTAL = 100000;
+  std::thread producer([&] {
+    uint8_t chunk[7];
+    size_t sent = 0;
+    while (sent < TOTAL) {
+      size_t n = std::min<size_t>(sizeof(chunk), TOTAL - sent);
+      for (size_t i = 0; i < n; i++) {
+        chunk[i] = static_cast<uint8_t>(sent + i);
+      }
+      size_t done = 0;
+      while (done < n) {
+        done += ring->write(chunk + done, n - done);
+      }
+      sent += n;
+    }
+  });
+  size_t received = 0;
+  bool in_order = true;
+  uint8_t buf[13];
+  while (received < TOTAL) {
+    size_t n = ring->read(buf, sizeof(buf));
+    for (size_t i = 0; i < n; i++) {
+      in_order &= buf[i] == static_cast<uint8_t>(received + i);
+    }
+    received += n;
+  }
+  producer.join();
+  EXPECT_TRUE(in_order);
+}
+
+TEST(ShmRegionTest, ClientsClaimDistinctSlots) {
+  std::string path = "/tmp/testshmtransport_" + std::to_string(getpid());
+  shm::Region *gateway = shm::create_region(path);
+  shm::Region *client = shm::open_region(path);
+
+  shm::Slot *first = shm::claim_slot(client);
+  shm::Slot *second = shm::claim_slot(client);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  EXPECT_NE(first, second);
+  // Both mappings see the same slots.
+  size_t index = first - client->slots;
+  EXPECT_EQ(gateway->slots[index].state.load(), shm::SlotState::REQUESTED);
+  EXPECT_EQ(gateway->slots[index].client_pid.load(), getpid());
+  EXPECT_TRUE(shm::client_alive(gateway->slots[index]));
+
+  for (size_t i = 2; i < shm::MAX_SESSIONS; i++) {
+    ASSERT_NE(shm::claim_slot(client), nullptr);
+  }
+  EXPECT_EQ(shm::claim_slot(client), nullptr); // all taken.
+
+  shm::close_region(client);
+  shm::close_region(gateway);
+  unlink(path.c_str());
+}
+
+TEST(ShmRegionTest, SlotIsOnlyFreedAfterTheClientReleasesIt) {
+  std::string path = "/tmp/testshmtransport_life_" + std::to_string(getpid());
+  shm::Region *gateway = shm::create_region(path);
+  shm::Region *client = shm::open_region(path);
+
+  // The gateway hangs up, the client is still writing.
+  shm::Slot *mine = shm::claim_slot(client);
+  ASSERT_NE(mine, nullptr);
+  shm::Slot &slot = gateway->slots[mine - client->slots];
+  slot.state.store(shm::SlotState::ACTIVE);
+  slot.state.store(shm::SlotState::CLOSING);
+  uint8_t late[4] = {1, 2, 3, 4};
+  mine->inbound.write(late, sizeof(late));
+  EXPECT_EQ(slot.state.load(), shm::SlotState::CLOSING);
+
+  shm::release_slot(mine);
+  EXPECT_EQ(slot.state.load(), shm::SlotState::CLOSED);
+  shm::free_slot(slot);
+  EXPECT_EQ(slot.state.load(), shm::SlotState::FREE);
+  EXPECT_EQ(slot.inbound.size(), 0);
+  EXPECT_EQ(slot.client_pid.load(), 0);
+
+  // Reused: the next client starts on empty rings.
+  shm::Slot *next = shm::claim_slot(client);
+  EXPECT_EQ(next, mine);
+  EXPECT_EQ(next->inbound.size(), 0);
+
+  // A client hanging up itself goes straight to CLOSED.
+  slot.state.store(shm::SlotState::ACTIVE);
+  shm::release_slot(next);
+  EXPECT_EQ(slot.state.load(), shm::SlotState::CLOSED);
+
+  shm::close_region(client);
+  shm::close_region(gateway);
+  unlink(path.c_str());
+}
+
+TEST(ShmRegionTest, RejectsForeignFile) {
+  std::string path = "/tmp/testshmtransport_bad_" + std::to_string(getpid());
+  shm::close_region(shm::create_region(path));
+  shm::Region *region = shm::open_region(path);
+  region->magic = 0;
+  shm::close_region(region);
+  EXPECT_THROW(shm::open_region(path), std::runtime_error);
+  unlink(path.c_str());
+}
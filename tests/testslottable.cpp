@@ -0,0 +1,102 @@
+#include "containers/slot_table.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class SlotTableTest : public ::testing::Test {
+protected:
+  threadsafe::slot_table<uint32_t, int *> table{16};
+};
+
+// 1. Basic Functional Tests
+TEST_F(SlotTableTest, InsertAndFind) {
+  int val = 42;
+  EXPECT_TRUE(table.insert({1, &val}));
+
+  EXPECT_TRUE(table.contains(1));
+  EXPECT_EQ(*table.find(1), 42);
+}
+
+TEST_F(SlotTableTest, FindMissingIsNull) {
+  EXPECT_EQ(table.find(7), nullptr);
+  EXPECT_FALSE(table.contains(0));
+}
+
+TEST_F(SlotTableTest, EraseExistingKey) {
+  int val = 100;
+  table.insert({10, &val});
+  table.erase(10);
+  EXPECT_FALSE(table.contains(10));
+  table.erase(10); // erasing again is harmless.
+}
+
+TEST_F(SlotTableTest, CapacityRoundsToPowerOfTwo) {
+  threadsafe::slot_table<uint32_t, int *> odd{100};
+  EXPECT_EQ(odd.capacity(), 128);
+}
+
+// 2. Generation tags
+TEST_F(SlotTableTest, StaleKeyDoesNotSeeNewOwner) {
+  int a = 1;
+  int b = 2;
+  table.insert({3, &a});
+  table.erase(3);
+  // 19 lands in the same slot as 3 with a capacity of 16.
+  ASSERT_TRUE(table.can_insert(19));
+  table.insert({19, &b});
+
+  EXPECT_EQ(table.find(3), nullptr);
+  EXPECT_EQ(*table.find(19), 2);
+}
+
+TEST_F(SlotTableTest, OccupiedSlotRejectsOtherKey) {
+  int a = 1;
+  int b = 2;
+  table.insert({5, &a});
+
+  EXPECT_FALSE(table.can_insert(21));
+  EXPECT_FALSE(table.insert({21, &b}));
+  EXPECT_EQ(*table.find(5), 1);
+  EXPECT_EQ(table.find(21), nullptr);
+
+  // Same key just overwrites.
+  EXPECT_TRUE(table.insert({5, &b}));
+  EXPECT_EQ(*table.find(5), 2);
+}
+
+// 3. Concurrency: readers never see a torn or foreign value.
+TEST_F(SlotTableTest, ConcurrentReadSingleWrite) {
+  std::vector<int> values(1000);
+  for (int i = 0; i < 1000; ++i) {
+    values[i] = i;
+  }
+  std::atomic<bool> running{true};
+
+  auto reader = [&]() {
+    while (running) {
+      for (uint32_t key = 0; key < 1000; ++key) {
+        int *ptr = table.find(key);
+        if (ptr != nullptr) {
+          ASSERT_EQ(*ptr, static_cast<int>(key));
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i)
+    threads.emplace_back(reader);
+
+  // Single writer cycling sequential ids through the 16 slots.
+  for (uint32_t key = 0; key < 1000; ++key) {
+    table.insert({key, &values[key]});
+    if (key >= 8) {
+      table.erase(key - 8);
+    }
+  }
+
+  running = false;
+  for (auto &t : threads)
+    t.join();
+}
@@ -0,0 +1,389 @@
+#include "network/tcpserver.hpp"
+#include <gtest/gtest.h>
+
+#include <endian.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/settings.hpp"
+#include "engine/types.hpp"
+#include "my_config.hpp"
+#include "network/protocol.hpp"
+#include "telemetry/clock.hpp"
+#include "telemetry/metrics.hpp"
+
+std::atomic<bool> keep_running(true);
+
+// The gateway end to end over loopback, with a stand in for the engine. The
+// client end is written byte by byte, as any other client would: the codecs
+// can't be linked in next to the server's copy of them.
+namespace {
+constexpr const char *PORT = "12399";
+const std::string SHM_PATH = "/tmp/testtcpserver_" + std::to_string(getpid());
+constexpr uint8_t ORDER_NEW = static_cast<uint8_t>(MessageType::ORDER_NEW);
+constexpr uint8_t EXEC_REPORT = static_cast<uint8_t>(MessageType::EXEC_REPORT);
+constexpr uint8_t LOGIN_RESPONSE =
+    static_cast<uint8_t>(MessageType::LOGIN_RESPONSE);
+constexpr uint8_t LOGIN_RESUME = static_cast<uint8_t>(MessageType::LOGIN_RESUME);
+constexpr uint8_t RESUME_RESPONSE =
+    static_cast<uint8_t>(MessageType::RESUME_RESPONSE);
+constexpr uint8_t SESSION_TOKEN =
+    static_cast<uint8_t>(MessageType::SESSION_TOKEN);
+
+void put32(std::vector<uint8_t> &out, uint32_t v) {
+  v = htobe32(v);
+  out.insert(out.end(), reinterpret_cast<uint8_t *>(&v),
+             reinterpret_cast<uint8_t *>(&v) + sizeof(v));
+}
+void put64(std::vector<uint8_t> &out, uint64_t v) {
+  v = htobe64(v);
+  out.insert(out.end(), reinterpret_cast<uint8_t *>(&v),
+             reinterpret_cast<uint8_t *>(&v) + sizeof(v));
+}
+auto get32(const uint8_t *in) -> uint32_t {
+  uint32_t v;
+  std::memcpy(&v, in, sizeof(v));
+  return be32toh(v);
+}
+auto get64(const uint8_t *in) -> uint64_t {
+  uint64_t v;
+  std::memcpy(&v, in, sizeof(v));
+  return be64toh(v);
+}
+
+struct Report {
+  ClientId client_id;
+  OrderId order_id;
+  ExecType type;
+};
+
+// One connection, blocking with a timeout so a missing message fails the
+// test instead of hanging it.
+class Conn {
+  int fd = -1;
+
+public:
+  Conn() {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *info = nullptr;
+    EXPECT_EQ(getaddrinfo("127.0.0.1", PORT, &hints, &info), 0);
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    EXPECT_EQ(connect(fd, info->ai_addr, info->ai_addrlen), 0);
+    freeaddrinfo(info);
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  }
+  ~Conn() { close(fd); }
+  Conn(const Conn &) = delete;
+  auto operator=(const Conn &) -> Conn & = delete;
+
+  void send(const std::vector<uint8_t> &bytes) {
+    ASSERT_EQ(::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL),
+              static_cast<ssize_t>(bytes.size()));
+  }
+  // Exactly n bytes, empty if the server closed or went quiet first.
+  auto recv(size_t n) -> std::vector<uint8_t> {
+    std::vector<uint8_t> in(n);
+    for (size_t got = 0; got < n;) {
+      ssize_t r = ::recv(fd, in.data() + got, n - got, 0);
+      if (r <= 0) {
+        return {};
+      }
+      got += r;
+    }
+    return in;
+  }
+  auto closedByServer() -> bool {
+    uint8_t byte;
+    return ::recv(fd, &byte, 1, 0) == 0;
+  }
+
+  auto login() -> ClientId {
+    std::vector<uint8_t> in = recv(5); // the v1 login, as it always was.
+    EXPECT_EQ(in.size(), 5);
+    EXPECT_EQ(in.empty() ? 0 : in[0], LOGIN_RESPONSE);
+    return in.empty() ? 0 : get32(&in[1]);
+  }
+  auto askToken() -> uint64_t {
+    std::vector<uint8_t> out{SESSION_TOKEN};
+    put32(out, 0);
+    put64(out, 0);
+    send(out);
+    std::vector<uint8_t> in = recv(13);
+    EXPECT_EQ(in.size(), 13);
+    EXPECT_EQ(in.empty() ? 0 : in[0], SESSION_TOKEN);
+    return in.empty() ? 0 : get64(&in[5]);
+  }
+  void order(OrderId id, Side side) {
+    std::vector<uint8_t> out{ORDER_NEW};
+    put64(out, id);
+    put64(out, 10000); // price
+    put32(out, 10);    // quantity
+    out.push_back(static_cast<uint8_t>(side));
+    out.push_back(static_cast<uint8_t>(OrderType::LIMIT));
+    out.push_back(static_cast<uint8_t>(TimeInForce::GTC));
+    send(out);
+  }
+  void resume(ClientId id, uint64_t token, uint64_t next_sequence) {
+    std::vector<uint8_t> out{LOGIN_RESUME};
+    put32(out, id);
+    put64(out, token);
+    put64(out, next_sequence);
+    send(out);
+  }
+  // client id and where the replay starts, from RESUME_RESPONSE.
+  auto resumed() -> std::pair<ClientId, uint64_t> {
+    std::vector<uint8_t> in = recv(21);
+    EXPECT_EQ(in.size(), 21);
+    if (in.empty()) {
+      return {0, 0};
+    }
+    EXPECT_EQ(in[0], RESUME_RESPONSE);
+    return {get32(&in[1]), get64(&in[13])};
+  }
+  auto report() -> Report {
+    std::vector<uint8_t> in = recv(32);
+    EXPECT_EQ(in.size(), 32);
+    if (in.empty()) {
+      return {};
+    }
+    EXPECT_EQ(in[0], EXEC_REPORT);
+    return {get32(&in[1]), get64(&in[5]), static_cast<ExecType>(in[29])};
+  }
+};
+
+// Orders from here on are published unfinished, as the engine does with
+// its ring full: the event goes out, then the report a while later.
+constexpr OrderId SPLIT_ORDERS = 1000;
+constexpr auto SPLIT_DELAY = std::chrono::milliseconds(200);
+
+// The stand in engine: each order is acknowledged, unless one from the
+// other side is resting, and then the two trade.
+void engine(my_config::EventQueue &events, my_config::OutputRing &output) {
+  ClientRequest request;
+  ClientRequest resting{};
+  bool has_resting = false;
+  auto claim = [&] {
+    EngineOutput *out;
+    while ((out = output.claim()) == nullptr) {
+      std::this_thread::yield();
+    }
+    return out;
+  };
+  while (keep_running.load()) {
+    if (!events.try_pop(request)) {
+      std::this_thread::yield();
+      continue;
+    }
+    EngineOutput *out = claim();
+    out->type = OutputType::EVENT;
+    out->event = record_of(request);
+    out->ends_request = false;
+    out->completed = tsc::now();
+    output.commit();
+    const Order &order = request.new_order;
+    if (order.order_id >= SPLIT_ORDERS) {
+      output.publish();
+      std::this_thread::sleep_for(SPLIT_DELAY);
+    }
+    out = claim();
+    if (has_resting && resting.new_order.side != order.side) {
+      out->type = OutputType::FILL;
+      out->fill = {resting.new_order.order_id,
+                   order.order_id,
+                   resting.client_id,
+                   request.client_id,
+                   tsc::now(),
+                   resting.new_order.price,
+                   order.quantity,
+                   0,
+                   0,
+                   order.side};
+      has_resting = false;
+    } else {
+      out->type = OutputType::REPORT;
+      out->report = {request.client_id,  order.order_id,
+                     order.price,        0,
+                     order.quantity,     ExecType::NEW,
+                     RejectReason::NONE, order.side};
+      resting = request;
+      has_resting = true;
+    }
+    out->ends_request = true;
+    output.publish();
+  }
+}
+
+class TcpServerTest : public ::testing::Test {
+protected:
+  static inline settings::Settings config;
+  static inline std::unique_ptr<my_config::EventQueue> events;
+  static inline std::unique_ptr<my_config::OutputRing> output;
+  static inline std::unique_ptr<TcpServer<my_config>> server;
+  static inline std::vector<std::thread> threads;
+
+  static void SetUpTestSuite() {
+    tsc::calibrate();
+    events = std::make_unique<my_config::EventQueue>(1024);
+    output = std::make_unique<my_config::OutputRing>(1024);
+    auto dispatch = output->add_consumer();
+    server = std::make_unique<TcpServer<my_config>>(*events, *output,
+                                                    dispatch, config);
+    server->init(PORT);
+    server->initShm(SHM_PATH);
+    threads.emplace_back(&TcpServer<my_config>::receiveData, server.get());
+    threads.emplace_back(&TcpServer<my_config>::dispatchData, server.get());
+    threads.emplace_back(engine, std::ref(*events), std::ref(*output));
+  }
+  static void TearDownTestSuite() {
+    keep_running.store(false);
+    Conn wake; // the receive thread may be waiting on its sockets.
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    unlink(SHM_PATH.c_str());
+  }
+};
+
+// Polls until the slot is in state, false if it never gets there.
+auto reaches(const shm::Slot *slot, shm::SlotState state) -> bool {
+  for (int i = 0; i < 2000; i++) {
+    if (slot->state.load() == state) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+} // namespace
+
+TEST_F(TcpServerTest, ResumeReplaysTheReportsMissed) {
+  auto first = std::make_unique<Conn>();
+  ClientId id = first->login();
+  uint64_t token = first->askToken();
+  first->order(1, Side::BID);
+  Report ack = first->report(); // report 0
+  EXPECT_EQ(ack.client_id, id);
+  EXPECT_EQ(ack.type, ExecType::NEW);
+  first.reset(); // gone, the session is kept.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Its resting order trades while it is away: report 1 is kept for it.
+  Conn other;
+  other.login();
+  other.order(2, Side::ASK);
+  EXPECT_EQ(other.report().type, ExecType::TRADE);
+
+  Conn back;
+  ClientId provisional = back.login();
+  EXPECT_NE(provisional, id);
+  back.resume(id, token, 1);
+  auto [resumed_id, from] = back.resumed();
+  EXPECT_EQ(resumed_id, id);
+  EXPECT_EQ(from, 1);
+  Report missed = back.report();
+  EXPECT_EQ(missed.client_id, id);
+  EXPECT_EQ(missed.order_id, 1);
+  EXPECT_EQ(missed.type, ExecType::TRADE);
+
+  // And it carries on under its old id.
+  back.order(3, Side::BID);
+  Report next = back.report();
+  EXPECT_EQ(next.client_id, id);
+  EXPECT_EQ(next.order_id, 3);
+}
+
+TEST_F(TcpServerTest, ResumeNeedsTheSessionToken) {
+  ClientId id;
+  uint64_t token;
+  {
+    Conn first;
+    id = first.login();
+    token = first.askToken();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  Conn guess;
+  guess.login();
+  guess.resume(id, token ^ 1, 0);
+  EXPECT_TRUE(guess.closedByServer());
+
+  Conn back;
+  back.login();
+  back.resume(id, token, 0);
+  EXPECT_EQ(back.resumed().first, id);
+}
+
+TEST_F(TcpServerTest, TokenIsOnlyGivenAsTheFirstMessage) {
+  Conn conn;
+  conn.login();
+  conn.order(4, Side::BID);
+  conn.report();
+  std::vector<uint8_t> ask{SESSION_TOKEN};
+  ask.resize(13);
+  conn.send(ask);
+  EXPECT_TRUE(conn.closedByServer());
+}
+
+TEST_F(TcpServerTest, RequestIsTimedOnceItsLastReportIsWritten) {
+  Conn conn;
+  conn.login();
+  uint64_t before =
+      metrics::registry().snapshot().latency(metrics::Stage::END_TO_END).count;
+  conn.order(SPLIT_ORDERS, Side::BID);
+  EXPECT_EQ(conn.report().order_id, SPLIT_ORDERS);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  metrics::Latency end_to_end =
+      metrics::registry().snapshot().latency(metrics::Stage::END_TO_END);
+  EXPECT_EQ(end_to_end.count, before + 1);
+  EXPECT_GE(end_to_end.max,
+            std::chrono::nanoseconds(SPLIT_DELAY).count()); // not the event.
+}
+
+TEST_F(TcpServerTest, ShmSlotIsOnlyReusedOnceTheClientLetGo) {
+  shm::Region *region = shm::open_region(SHM_PATH);
+  shm::Slot *slot = shm::claim_slot(region);
+  ASSERT_NE(slot, nullptr);
+  ASSERT_TRUE(reaches(slot, shm::SlotState::ACTIVE));
+
+  // Garbage gets us hung up on, but we may still be writing: the slot
+  // can't be emptied or given away under us.
+  uint8_t garbage = 0xFF;
+  slot->inbound.write(&garbage, 1);
+  ASSERT_TRUE(reaches(slot, shm::SlotState::CLOSING));
+  uint8_t late[8] = {};
+  slot->inbound.write(late, sizeof(late));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(slot->state.load(), shm::SlotState::CLOSING);
+  EXPECT_EQ(slot->inbound.size(), sizeof(late)); // not emptied under us.
+
+  shm::release_slot(slot);
+  ASSERT_TRUE(reaches(slot, shm::SlotState::FREE));
+  EXPECT_EQ(slot->inbound.size(), 0);
+
+  // The next client gets it, clean, and a working session on it.
+  shm::Slot *next = shm::claim_slot(region);
+  EXPECT_EQ(next, slot);
+  ASSERT_TRUE(reaches(next, shm::SlotState::ACTIVE));
+  uint8_t login[5];
+  for (int i = 0; i < 2000 && next->outbound.size() < sizeof(login); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(next->outbound.read(login, sizeof(login)), sizeof(login));
+  EXPECT_EQ(login[0], LOGIN_RESPONSE);
+  shm::release_slot(next);
+  ASSERT_TRUE(reaches(next, shm::SlotState::FREE));
+  shm::close_region(region);
+}
@@ -0,0 +1,102 @@
+#define TACHYON_TRACE
+#include "telemetry/trace.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Rings are per thread and live for the whole process, so every test
+// records on a fresh thread and finds its ring by name.
+
+static auto traced(const std::vector<trace::ThreadTrace> &threads,
+                   const std::string &name) -> const trace::ThreadTrace * {
+  for (const trace::ThreadTrace &thread : threads) {
+    if (thread.name == name) {
+      return &thread;
+    }
+  }
+  return nullptr;
+}
+
+static auto dumped() -> std::vector<trace::ThreadTrace> {
+  std::string path = "/tmp/tachyon_test_trace.bin";
+  EXPECT_TRUE(trace::dump(path));
+  std::vector<trace::ThreadTrace> threads;
+  EXPECT_TRUE(trace::load(path, threads));
+  return threads;
+}
+
+TEST(TraceTest, RecordsRoundTripThroughDump) {
+  std::thread([] {
+    TRACE_THREAD("roundtrip");
+    TRACE_BEGIN(ENGINE_EVENT, 42);
+    TRACE_INSTANT(BOOK_ADD, 42);
+    TRACE_END(ENGINE_EVENT, 42);
+  }).join();
+
+  auto threads = dumped();
+  const trace::ThreadTrace *thread = traced(threads, "roundtrip");
+  ASSERT_NE(thread, nullptr);
+  ASSERT_EQ(thread->records.size(), 3);
+  EXPECT_EQ(thread->records[0].point, trace::Point::ENGINE_EVENT);
+  EXPECT_EQ(thread->records[0].phase, trace::Phase::BEGIN);
+  EXPECT_EQ(thread->records[1].point, trace::Point::BOOK_ADD);
+  EXPECT_EQ(thread->records[2].phase, trace::Phase::END);
+  EXPECT_EQ(thread->records[1].id, 42);
+  EXPECT_EQ(thread->records[1].thread, thread->thread);
+  EXPECT_LE(thread->records[0].time, thread->records[2].time);
+}
+
+TEST(TraceTest, RingKeepsNewestRecords) {
+  std::thread([] {
+    TRACE_THREAD("wrapped");
+    for (uint64_t i = 0; i < trace::RING_RECORDS + 10; i++) {
+      TRACE_INSTANT(GATEWAY_NEW, i);
+    }
+  }).join();
+
+  auto threads = dumped();
+  const trace::ThreadTrace *thread = traced(threads, "wrapped");
+  ASSERT_NE(thread, nullptr);
+  ASSERT_EQ(thread->records.size(), trace::RING_RECORDS);
+  EXPECT_EQ(thread->records.front().id, 10);
+  EXPECT_EQ(thread->records.back().id, trace::RING_RECORDS + 9);
+}
+
+TEST(TraceTest, ChromeJsonFollowsOneOrder) {
+  std::thread([] {
+    TRACE_THREAD("gw");
+    TRACE_INSTANT(GATEWAY_NEW, 7);
+    TRACE_INSTANT(GATEWAY_NEW, 8);
+  }).join();
+  std::thread([] {
+    TRACE_THREAD("eng");
+    TRACE_BEGIN(ENGINE_EVENT, 7);
+    TRACE_END(ENGINE_EVENT, 7);
+  }).join();
+
+  std::vector<trace::ThreadTrace> threads;
+  for (const trace::ThreadTrace &thread : dumped()) {
+    if (thread.name == "gw" || thread.name == "eng") {
+      threads.push_back(thread);
+    }
+  }
+  std::string json = trace::to_chrome_json(threads, 7);
+  EXPECT_NE(json.find("\"name\":\"gateway_new\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"B\",\"name\":\"engine_event\""),
+            std::string::npos);
+  EXPECT_EQ(json.find("\"id\":8"), std::string::npos); // other order left out.
+  EXPECT_NE(json.find("\"ph\":\"s\""), std::string::npos); // flow start..
+  EXPECT_NE(json.find("\"ph\":\"f\""), std::string::npos); // ..and finish.
+  EXPECT_NE(json.find("\"args\":{\"name\":\"eng\"}"), std::string::npos);
+}
+
+TEST(TraceTest, LoadRejectsOtherFiles) {
+  std::vector<trace::ThreadTrace> threads;
+  EXPECT_FALSE(trace::load("/tmp/tachyon_no_such_trace.bin", threads));
+  std::FILE *file = std::fopen("/tmp/tachyon_not_a_trace.bin", "wb");
+  std::fputs("hello", file);
+  std::fclose(file);
+  EXPECT_FALSE(trace::load("/tmp/tachyon_not_a_trace.bin", threads));
+}
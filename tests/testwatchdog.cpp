@@ -0,0 +1,115 @@
+#include "telemetry/watchdog.hpp"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Checks are driven by hand with made up times, no watchdog thread.
+
+static const std::string LOG = "/tmp/tachyon_test_watchdog.txt";
+
+static auto logged() -> std::string {
+  std::ifstream in(LOG);
+  std::stringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+static auto count(const std::string &text, const std::string &what) -> size_t {
+  size_t n = 0;
+  for (size_t at = text.find(what); at != std::string::npos;
+       at = text.find(what, at + 1)) {
+    n++;
+  }
+  return n;
+}
+
+class WatchdogTest : public ::testing::Test {
+protected:
+  void SetUp() override { std::remove(LOG.c_str()); }
+};
+
+TEST_F(WatchdogTest, StallIsLoggedOnceAndThenItsEnd) {
+  watchdog::Heartbeat heartbeat;
+  {
+    watchdog::Watchdog dog(LOG, 5, 50);
+    dog.watch("worker", heartbeat);
+    dog.open();
+    dog.check(1000); // never beaten, not judged.
+    dog.check(2000);
+    heartbeat.beat();
+    dog.check(2000);
+    dog.check(2049);
+    EXPECT_EQ(count(logged(), "STALL"), 0u);
+    dog.check(2050);
+    dog.check(2100);
+    dog.check(2500);
+    heartbeat.beat();
+    dog.check(2600);
+  }
+  std::string text = logged();
+  EXPECT_EQ(count(text, "STALL worker no progress for 50 ms"), 1u);
+  EXPECT_EQ(count(text, "RESUMED worker after 600 ms"), 1u);
+}
+
+TEST_F(WatchdogTest, WaitingIsNotAStall) {
+  watchdog::Heartbeat heartbeat;
+  {
+    watchdog::Watchdog dog(LOG, 5, 50);
+    dog.watch("gateway", heartbeat);
+    dog.open();
+    heartbeat.beat();
+    heartbeat.wait();
+    dog.check(0);
+    dog.check(1000);
+    heartbeat.beat(); // woke up, busy from here.
+    dog.check(1000);
+    dog.check(1100);
+  }
+  std::string text = logged();
+  EXPECT_EQ(count(text, "STALL"), 1u);
+  EXPECT_EQ(count(text, "no progress for 100 ms"), 1u);
+}
+
+TEST_F(WatchdogTest, SaturationAndHighWaterMarks) {
+  uint64_t depth = 0, high = 0;
+  {
+    watchdog::Watchdog dog(LOG, 5, 50);
+    dog.watch(
+        "events", 100, [&] { return depth; }, [&] { return high; });
+    dog.open();
+    depth = high = 50;
+    dog.check(10); // half full is below both lines.
+    depth = high = 80;
+    dog.check(20);
+    depth = 90, high = 95;
+    dog.check(30); // still saturated, high water past another tenth.
+    depth = 10;
+    dog.check(45);
+    dog.check(50);
+  }
+  std::string text = logged();
+  EXPECT_EQ(count(text, "SATURATED events 80/100 (80%)"), 1u);
+  EXPECT_EQ(count(text, "DRAINED events 10/100 (10%) after 25 ms"), 1u);
+  EXPECT_EQ(count(text, "HIGH WATER events"), 2u);
+  EXPECT_EQ(count(text, "HIGH WATER events 80/100 (80%)"), 1u);
+  EXPECT_EQ(count(text, "HIGH WATER events 95/100 (95%)"), 1u);
+}
+
+TEST_F(WatchdogTest, ThreadStartsAndStops) {
+  watchdog::Heartbeat heartbeat;
+  {
+    watchdog::Watchdog dog(LOG, 1, 1000);
+    dog.watch("worker", heartbeat);
+    dog.start();
+    heartbeat.beat();
+    dog.stop();
+    dog.stop();
+  }
+  std::string text = logged();
+  EXPECT_EQ(count(text, "watchdog started"), 1u);
+  EXPECT_EQ(count(text, "watchdog stopped"), 1u);
+  EXPECT_EQ(count(text, "STALL"), 0u);
+}